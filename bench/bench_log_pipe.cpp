@@ -0,0 +1,209 @@
+// A micro-benchmark for decoding test events in the mettle driver. This
+// compares decoding each event into a full bencode::data tree and then pulling
+// the test names, output, and durations out of it (as log::pipe used to do)
+// with log::pipe's streaming decoder for both bencode and the binary protocol.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <bencode.hpp>
+
+#include <mettle/driver/log/binary_child.hpp>
+#include <mettle/driver/log/child.hpp>
+#include "../src/mettle/log_pipe.hpp"
+
+using namespace mettle;
+
+struct null_logger : log::file_logger {
+  void started_run() override {}
+  void ended_run() override {}
+
+  void started_file(const test_file &) override {}
+  void ended_file(const test_file &) override {}
+  void failed_file(const test_file &, const std::string &) override {}
+
+  void started_suite(const std::vector<suite_name> &) override {}
+  void ended_suite(const std::vector<suite_name> &) override {}
+
+  void started_test(const test_name &) override {}
+  void passed_test(const test_name &, const log::test_output &,
+                   log::test_duration) override {}
+  void failed_test(const test_name &, const test_failure &,
+                   const log::test_output &, log::test_duration) override {}
+  void skipped_test(const test_name &, const std::string &) override {}
+};
+
+// The way log::pipe used to read bencoded events: decode the whole event into
+// a tree, and then copy each of its values out to pass to the logger.
+class tree_pipe {
+public:
+  tree_pipe(log::file_logger &logger, test_uid file_uid)
+    : logger_(logger), file_uid_(file_uid) {}
+
+  void operator ()(std::istream &s) {
+    auto tmp = bencode::decode(s, bencode::no_check_eof);
+    auto &data = std::get<bencode::dict>(tmp);
+    auto &&event = std::get<bencode::string>(data.at("event"));
+
+    if(event == "started_suite") {
+      logger_.started_suite(read_suites( std::move(data.at("suites")) ));
+    } else if(event == "ended_suite") {
+      logger_.ended_suite(read_suites( std::move(data.at("suites")) ));
+    } else if(event == "started_test") {
+      logger_.started_test(read_test_name( std::move(data.at("test")) ));
+    } else if(event == "passed_test") {
+      logger_.passed_test(
+        read_test_name( std::move(data.at("test")) ),
+        read_test_output( std::move(data.at("output")) ),
+        read_test_duration( std::move(data.at("duration")) )
+      );
+    } else if(event == "failed_test") {
+      logger_.failed_test(
+        read_test_name( std::move(data.at("test")) ),
+        test_failure::from_bencode( std::move(data.at("failure")) ),
+        read_test_output( std::move(data.at("output")) ),
+        read_test_duration( std::move(data.at("duration")) )
+      );
+    } else if(event == "skipped_test") {
+      logger_.skipped_test(read_test_name( std::move(data.at("test")) ),
+                           read_string( std::move(data.at("message"))) );
+    }
+  }
+private:
+  std::vector<suite_name> read_suites(bencode::data &&suites) {
+    std::vector<suite_name> result;
+    for(auto &&i : std::get<bencode::list>(suites)) {
+      auto &data = std::get<bencode::dict>(i);
+      result.emplace_back(
+        read_string( std::move(data.at("suite")) ),
+        read_string( std::move(data.at("file_name")) ),
+        read_line( std::move(data.at("line")) )
+      );
+    }
+    return result;
+  }
+
+  test_name read_test_name(bencode::data &&test) {
+    auto &data = std::get<bencode::dict>(test);
+    test_uid id = file_uid_ + static_cast<test_uid>(
+      std::get<bencode::integer>(data.at("id"))
+    );
+    return {
+      id,
+      read_suites( std::move(data.at("suites")) ),
+      read_string( std::move(data.at("test")) ),
+      read_string( std::move(data.at("file_name")) ),
+      read_line( std::move(data.at("line")) )
+    };
+  }
+
+  log::test_output read_test_output(bencode::data &&output) {
+    auto &data = std::get<bencode::dict>(output);
+    return log::test_output{
+      read_string( std::move(data.at("stdout_log")) ),
+      read_string( std::move(data.at("stderr_log")) ),
+      read_size( std::move(data.at("stdout_dropped")) ),
+      read_size( std::move(data.at("stderr_dropped")) )
+    };
+  }
+
+  log::test_duration read_test_duration(bencode::data &&duration) {
+    return log::test_duration(std::chrono::milliseconds(
+      std::get<bencode::integer>(duration)
+    ));
+  }
+
+  std::string read_string(bencode::data &&message) {
+    return std::move(std::get<bencode::string>(message));
+  }
+
+  std::size_t read_size(bencode::data &&size) {
+    return static_cast<std::size_t>(std::get<bencode::integer>(size));
+  }
+
+  std::uint_least32_t read_line(bencode::data &&line) {
+    return static_cast<std::uint_least32_t>(std::get<bencode::integer>(line));
+  }
+
+  log::file_logger &logger_;
+  test_uid file_uid_;
+};
+
+// Log a plausible mix of events: each test in a suite starts and then passes,
+// with the occasional failure.
+template<typename Child>
+std::string make_events(std::size_t tests, std::size_t *count) {
+  std::ostringstream ss;
+  Child child(ss);
+  std::vector<suite_name> suites = {
+    {"suite", "test_file.cpp", 10}, {"subsuite", "test_file.cpp", 20}
+  };
+  log::test_output output = {"some output\n", ""};
+  test_failure failure = {"desc", "expected: 1\nactual:   2", "test_file.cpp",
+                          42};
+  log::test_duration duration(std::chrono::microseconds(1234));
+
+  *count = 0;
+  child.started_suite(suites);
+  ++*count;
+  for(std::size_t i = 0; i != tests; i++) {
+    test_name test = {i, suites, "test " + std::to_string(i), "test_file.cpp",
+                      static_cast<std::uint_least32_t>(30 + i)};
+    child.started_test(test);
+    if(i % 10 == 9)
+      child.failed_test(test, failure, output, duration);
+    else
+      child.passed_test(test, output, duration);
+    *count += 2;
+  }
+  child.ended_suite(suites);
+  ++*count;
+  return ss.str();
+}
+
+template<typename Func>
+void run(const char *name, const std::string &events, std::size_t count,
+         std::size_t iterations, Func &&func) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  for(std::size_t i = 0; i != iterations; i++) {
+    std::istringstream ss(events);
+    func(ss);
+  }
+  std::chrono::duration<double> elapsed = clock::now() - start;
+
+  double total = static_cast<double>(count * iterations);
+  std::cout << name << ": " << static_cast<long long>(total / elapsed.count())
+            << " events/s (" << elapsed.count() * 1e9 / total
+            << " ns/event)\n";
+}
+
+int main(int argc, const char *argv[]) {
+  std::size_t tests = 1000, iterations = argc > 1 ? std::atoi(argv[1]) : 100;
+  std::size_t count;
+  auto bencode_events = make_events<log::child>(tests, &count);
+  auto binary_events = make_events<log::binary_child>(tests, &count);
+
+  null_logger logger;
+  run("bencode tree", bencode_events, count, iterations,
+      [&logger](std::istream &s) {
+        tree_pipe pipe(logger, 0);
+        while(s.peek() != EOF)
+          pipe(s);
+      });
+  run("bencode streaming", bencode_events, count, iterations,
+      [&logger](std::istream &s) {
+        log::pipe pipe(logger, 0);
+        while(s.peek() != EOF)
+          pipe(s);
+      });
+  run("binary streaming", binary_events, count, iterations,
+      [&logger](std::istream &s) {
+        log::pipe pipe(logger, 0);
+        while(s.peek() != EOF)
+          pipe(s);
+      });
+}
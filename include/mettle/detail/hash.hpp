@@ -0,0 +1,24 @@
+#ifndef INC_METTLE_DETAIL_HASH_HPP
+#define INC_METTLE_DETAIL_HASH_HPP
+
+#include <cstdint>
+#include <string_view>
+
+namespace mettle::detail {
+  inline constexpr std::uint64_t fnv1a_basis = 0xcbf29ce484222325;
+
+  // A 64-bit FNV-1a hash. Unlike `std::hash`, this gives the same result on
+  // every platform and in every build, so it's suitable for anything that
+  // needs to agree across machines (e.g. sharding tests). Pass the result of
+  // a previous call as `hash` to hash several strings in sequence.
+  constexpr std::uint64_t
+  fnv1a(std::string_view s, std::uint64_t hash = fnv1a_basis) {
+    for(auto c : s) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+} // namespace mettle::detail
+
+#endif
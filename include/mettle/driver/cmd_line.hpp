@@ -15,9 +15,12 @@
 
 #include "filters.hpp"
 #include "object_factory.hpp"
+#include "resource_limits.hpp"
 #include "detail/export.hpp"
 #include "log/core.hpp"
 #include "log/indent.hpp"
+#include "log/test_list.hpp"
+#include "../test_uid.hpp"
 
 #ifdef _WIN32
 #  include <wtypes.h>
@@ -33,8 +36,22 @@ namespace mettle {
   METTLE_PUBLIC boost::program_options::options_description
   make_generic_options(generic_options &opts);
 
+  // A size in bytes, written on the command line like "512", "64K", or "1M".
+  struct data_size {
+    std::size_t bytes;
+
+    bool operator ==(const data_size &) const = default;
+  };
+
   struct driver_options {
     std::optional<std::chrono::milliseconds> timeout;
+    std::optional<data_size> max_output;
+    resource_limits limits;
+    std::size_t jobs = 1;
+    bool fork_server = false;
+    bool list = false;
+    list_format listing_format = list_format::text;
+    test_uid_scheme test_uids = test_uid_scheme::sequential;
     filter_set filters;
   };
 
@@ -56,6 +73,7 @@ namespace mettle {
     std::size_t runs = 1;
     bool show_terminal = false;
     bool show_time = false;
+    std::size_t top_usage = 0;
     std::string file_name = "mettle.xml";
   };
 
@@ -87,11 +105,24 @@ namespace mettle {
   }
 
   METTLE_PUBLIC attr_filter parse_attr(const std::string &value);
+  METTLE_PUBLIC data_size parse_data_size(const std::string &value);
 
   METTLE_PUBLIC void
   validate(boost::any &v, const std::vector<std::string> &values,
            color_option*, int);
 
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           data_size*, int);
+
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           list_format*, int);
+
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           test_uid_scheme*, int);
+
   METTLE_PUBLIC void
   validate(boost::any &v, const std::vector<std::string> &values,
            attr_filter_set*, int);
@@ -100,6 +131,10 @@ namespace mettle {
   validate(boost::any &v, const std::vector<std::string> &values,
            name_filter_set*, int);
 
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           shard_filter*, int);
+
 } // namespace mettle
 
 // Put these in the boost namespace so that ADL picks them up (via the
@@ -110,6 +145,10 @@ namespace boost {
   validate(boost::any &v, const std::vector<std::string> &values,
            std::chrono::milliseconds*, int);
 
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           std::chrono::seconds*, int);
+
 #ifdef _WIN32
   METTLE_PUBLIC void
   validate(boost::any &v, const std::vector<std::string> &values, HANDLE*, int);
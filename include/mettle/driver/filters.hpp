@@ -159,12 +159,34 @@ namespace mettle {
     container_type filters_;
   };
 
+  // Select a stable subset of tests by hashing their full names, so that each
+  // test lands in the same shard no matter what order the tests were defined
+  // in. `index` is 1-based, just like on the command line.
+  struct shard_filter {
+    std::size_t index = 0, count = 0;
+
+    METTLE_PUBLIC filter_result
+    operator ()(const test_name &name, const attributes &) const;
+
+    bool empty() const {
+      return count == 0;
+    }
+
+    bool operator ==(const shard_filter &) const = default;
+  };
+
   struct filter_set {
     name_filter_set by_name;
     attr_filter_set by_attr;
+    shard_filter shard = {};
 
     filter_result
     operator ()(const test_name &name, const attributes &attrs) const {
+      // Tests in other shards are always hidden, so that every shard sees the
+      // same partition of the tests regardless of the other filters.
+      if(auto result = shard(name, attrs); result.action == test_action::hide)
+        return result;
+
       auto first = by_name(name, attrs);
       if(first.action == test_action::hide)
         return first;
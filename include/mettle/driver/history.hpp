@@ -0,0 +1,58 @@
+#ifndef INC_METTLE_DRIVER_HISTORY_HPP
+#define INC_METTLE_DRIVER_HISTORY_HPP
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "detail/export.hpp"
+
+// Ignore warnings from MSVC about DLL interfaces.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4251)
+#endif
+
+namespace mettle {
+
+  // Remembers how long each test (or test file) took in earlier runs, so that
+  // parallel runs can start the slowest work first. The history is stored as
+  // a text file with one entry per line: the duration in microseconds, a
+  // space, and the entry's key (e.g. the full name of a test).
+  class METTLE_PUBLIC duration_history {
+  public:
+    using duration = std::chrono::microseconds;
+
+    duration_history() = default;
+
+    // Load the history from `file`. If `file` doesn't exist, the history
+    // starts out empty; malformed lines are ignored.
+    explicit duration_history(const std::string &file);
+
+    std::optional<duration> find(std::string_view key) const;
+
+    // Record a new duration for `key`. To smooth out noise, this is averaged
+    // with the previous duration, if there is one.
+    void record(const std::string &key, duration d);
+
+    // Save the history to `file`, replacing any existing file atomically.
+    // Throws `std::runtime_error` on failure.
+    void save(const std::string &file) const;
+
+    std::size_t size() const {
+      return durations_.size();
+    }
+  private:
+    std::map<std::string, duration, std::less<>> durations_;
+  };
+
+} // namespace mettle
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
+#endif
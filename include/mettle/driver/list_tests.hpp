@@ -0,0 +1,67 @@
+#ifndef INC_METTLE_DRIVER_LIST_TESTS_HPP
+#define INC_METTLE_DRIVER_LIST_TESTS_HPP
+
+#include <vector>
+
+#include "filters_core.hpp"
+#include "test_name.hpp"
+#include "log/core.hpp"
+#include "../suite/attributes.hpp"
+
+namespace mettle {
+
+  namespace detail {
+    inline log::test_attrs attr_values(const attributes &attrs) {
+      log::test_attrs result;
+      for(const auto &attr : attrs)
+        result.emplace(attr.attribute.name(), attr.value);
+      return result;
+    }
+
+    template<typename Suites, typename Filter>
+    void list_tests_impl(
+      const Suites &suites, log::test_logger &logger, const Filter &filter,
+      std::vector<suite_name> &parents
+    ) {
+      for(const auto &suite : suites) {
+        parents.push_back({suite.name(), suite.location().file_name(),
+                           suite.location().line()});
+
+        for(const auto &test : suite.tests()) {
+          const test_name name = {
+            test.id, parents, test.name, test.location.file_name(),
+            test.location.line()
+          };
+          auto action = filter(name, test.attrs);
+          if(action.action == test_action::indeterminate)
+            action = filter_by_attr(test.attrs);
+
+          if(action.action != test_action::hide)
+            logger.listed_test(name, attr_values(test.attrs));
+        }
+
+        list_tests_impl(suite.subsuites(), logger, filter, parents);
+        parents.pop_back();
+      }
+    }
+  }
+
+  // Log every test that `filter` would show (whether it would be run or
+  // skipped), without running any of them.
+  template<typename Suites, typename Filter>
+  void list_tests(const Suites &suites, log::test_logger &logger,
+                  const Filter &filter) {
+    std::vector<suite_name> parents;
+    logger.started_run();
+    detail::list_tests_impl(suites, logger, filter, parents);
+    logger.ended_run();
+  }
+
+  template<typename Suites>
+  inline void list_tests(const Suites &suites, log::test_logger &logger) {
+    list_tests(suites, logger, default_filter());
+  }
+
+} // namespace mettle
+
+#endif
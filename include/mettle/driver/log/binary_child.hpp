@@ -0,0 +1,261 @@
+#ifndef INC_METTLE_DRIVER_LOG_BINARY_CHILD_HPP
+#define INC_METTLE_DRIVER_LOG_BINARY_CHILD_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "core.hpp"
+#include "flush_policy.hpp"
+
+namespace mettle::log {
+
+  namespace binary {
+    // A binary event stream starts with these bytes, followed by a one-byte
+    // version number. Since a bencoded event can't start with them, readers
+    // can use this to tell which protocol a stream uses.
+    inline constexpr char magic[] = {'\x89', 'M', 'T', 'L'};
+    inline constexpr unsigned char version = 1;
+
+    // `mettle` sets this in a test binary's environment to the newest version
+    // of the protocol it can read. Test binaries that don't see it (or don't
+    // know about it) use bencode instead.
+    inline constexpr char version_env[] = "METTLE_PROTOCOL";
+
+    // Each event is a tag byte, the length of its payload (as a varint), and
+    // then the payload itself. Integers in the payload are varints, and
+    // strings are a varint length followed by their bytes. Suites and file
+    // names are sent once with a `define_*` event, and then referred to by
+    // their index. Test durations are the wall-clock, user, and system times
+    // in nanoseconds, followed by the fields of the test's `resource_usage`.
+    enum class tag : unsigned char {
+      define_file = 1,
+      define_suite,
+      started_run,
+      ended_run,
+      started_suite,
+      ended_suite,
+      started_test,
+      passed_test,
+      failed_test,
+      skipped_test,
+      listed_test
+    };
+  }
+
+  class binary_child : public test_logger {
+  public:
+    // If `passing_output` is false, the output of passing tests isn't sent,
+    // since most loggers never show it. `policy` determines how events are
+    // batched before being written to `out`.
+    binary_child(std::ostream &out, bool passing_output = true,
+                 flush_policy policy = {})
+      : out(out), passing_output(passing_output), policy(policy) {}
+
+    void started_run() override {
+      send(binary::tag::started_run);
+    }
+    void ended_run() override {
+      send(binary::tag::ended_run);
+      flush();
+    }
+
+    void started_suite(const std::vector<suite_name> &suites) override {
+      define_suites(suites);
+      put_suites(suites);
+      send(binary::tag::started_suite);
+    }
+    void ended_suite(const std::vector<suite_name> &suites) override {
+      define_suites(suites);
+      put_suites(suites);
+      send(binary::tag::ended_suite);
+      flush();
+    }
+
+    void started_test(const test_name &test) override {
+      define_test(test);
+      put_test(test);
+      send(binary::tag::started_test);
+      flush();
+    }
+
+    void passed_test(const test_name &test, const test_output &output,
+                     test_duration duration) override {
+      define_test(test);
+      put_test(test);
+      put_duration(duration);
+      put_output(passing_output ? output : test_output{});
+      send(binary::tag::passed_test);
+    }
+
+    void failed_test(const test_name &test, const test_failure &failure,
+                     const test_output &output,
+                     test_duration duration) override {
+      define_test(test);
+      put_test(test);
+      put_duration(duration);
+      put_string(failure.desc);
+      put_string(failure.message);
+      put_string(failure.file_name);
+      put_uint(failure.line);
+      put_output(output);
+      send(binary::tag::failed_test);
+    }
+
+    void skipped_test(const test_name &test,
+                      const std::string &message) override {
+      define_test(test);
+      put_test(test);
+      put_string(message);
+      send(binary::tag::skipped_test);
+    }
+
+    void listed_test(const test_name &test,
+                     const test_attrs &attrs) override {
+      define_test(test);
+      put_test(test);
+      put_uint(attrs.size());
+      for(const auto &[name, values] : attrs) {
+        put_string(name);
+        put_uint(values.size());
+        for(const auto &i : values)
+          put_string(i);
+      }
+      send(binary::tag::listed_test);
+    }
+
+    // Write out any pending events.
+    void flush() {
+      if(pending.empty())
+        return;
+      out.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+      out.flush();
+      pending.clear();
+      policy.reset();
+    }
+  private:
+    using suite_key = std::tuple<std::string, std::string, std::uint_least32_t>;
+    using suite_ref = std::tuple<std::string_view, std::string_view,
+                                 std::uint_least32_t>;
+
+    std::uint64_t file_id(const std::string &file_name) {
+      auto [i, added] = files.try_emplace(file_name, files.size());
+      if(added) {
+        put_uint(i->second);
+        put_string(file_name);
+        send(binary::tag::define_file);
+      }
+      return i->second;
+    }
+
+    void define_suites(const std::vector<suite_name> &suites) {
+      for(const auto &i : suites) {
+        if(suite_ids.contains(suite_ref(i.name, i.file_name, i.line)))
+          continue;
+
+        std::uint64_t file = file_id(i.file_name);
+        std::uint64_t id = suite_ids.size();
+        suite_ids.emplace(suite_key(i.name, i.file_name, i.line), id);
+        put_uint(id);
+        put_string(i.name);
+        put_uint(file);
+        put_uint(i.line);
+        send(binary::tag::define_suite);
+      }
+    }
+
+    void define_test(const test_name &test) {
+      define_suites(test.suites);
+      file_id(test.file_name);
+    }
+
+    static void encode_uint(std::string &dest, std::uint64_t value) {
+      while(value >= 0x80) {
+        dest.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+      }
+      dest.push_back(static_cast<char>(value));
+    }
+
+    void put_uint(std::uint64_t value) {
+      encode_uint(payload, value);
+    }
+
+    void put_string(std::string_view value) {
+      put_uint(value.size());
+      payload.append(value);
+    }
+
+    void put_suites(const std::vector<suite_name> &suites) {
+      put_uint(suites.size());
+      for(const auto &i : suites) {
+        auto id = suite_ids.find(suite_ref(i.name, i.file_name, i.line));
+        put_uint(id->second);
+      }
+    }
+
+    void put_test(const test_name &test) {
+      put_uint(test.id);
+      put_suites(test.suites);
+      put_string(test.name);
+      put_uint(files.at(test.file_name));
+      put_uint(test.line);
+    }
+
+    void put_duration(const test_duration &duration) {
+      put_uint(static_cast<std::uint64_t>(duration.wall.count()));
+      put_uint(static_cast<std::uint64_t>(duration.user.count()));
+      put_uint(static_cast<std::uint64_t>(duration.system.count()));
+
+      const auto &u = duration.usage;
+      put_uint(u.max_rss);
+      put_uint(u.minor_faults);
+      put_uint(u.major_faults);
+      put_uint(u.voluntary_switches);
+      put_uint(u.involuntary_switches);
+      put_uint(u.block_inputs);
+      put_uint(u.block_outputs);
+    }
+
+    void put_output(const test_output &output) {
+      put_string(output.stdout_log);
+      put_string(output.stderr_log);
+      put_uint(output.stdout_dropped);
+      put_uint(output.stderr_dropped);
+    }
+
+    // Add the current payload to the pending events with the given tag.
+    // Define events are only sent along with the event that needed them.
+    void send(binary::tag t) {
+      if(!started) {
+        pending.append(binary::magic, sizeof(binary::magic));
+        pending.push_back(static_cast<char>(binary::version));
+        started = true;
+      }
+
+      pending.push_back(static_cast<char>(t));
+      encode_uint(pending, payload.size());
+      pending.append(payload);
+      payload.clear();
+
+      if(t != binary::tag::define_file && t != binary::tag::define_suite &&
+         policy.ready(pending.size()))
+        flush();
+    }
+
+    std::ostream &out;
+    bool passing_output;
+    flush_policy policy;
+    bool started = false;
+    std::string payload, pending;
+    std::map<std::string, std::uint64_t> files;
+    std::map<suite_key, std::uint64_t, std::less<>> suite_ids;
+  };
+
+} // namespace mettle::log
+
+#endif
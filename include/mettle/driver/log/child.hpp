@@ -3,87 +3,130 @@
 
 #include <cassert>
 #include <ostream>
+#include <sstream>
 
 #include <bencode.hpp>
 
 #include "core.hpp"
+#include "flush_policy.hpp"
 
 namespace mettle::log {
 
+  // `mettle` sets this to "0" in a test binary's environment when it doesn't
+  // need the output of passing tests. This goes in the environment rather than
+  // on the command line since test binaries built with an older mettle would
+  // reject an option they don't recognize.
+  inline constexpr char passing_output_env[] = "METTLE_PASSING_OUTPUT";
+
   class child : public test_logger {
   public:
-    child(std::ostream &out) : out(out) {}
+    // If `passing_output` is false, the output of passing tests isn't sent,
+    // since most loggers never show it. `policy` determines how events are
+    // batched before being written to `out`.
+    child(std::ostream &out, bool passing_output = true,
+          flush_policy policy = {})
+      : out(out), passing_output(passing_output), policy(policy) {}
 
     void started_run() override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "started_run"}
       });
-      out.flush();
+      sent();
     }
     void ended_run() override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "ended_run"}
       });
-      out.flush();
+      flush();
     }
 
     void started_suite(const std::vector<suite_name> &suites) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "started_suite"},
         {"suites", wrap_suites(suites)}
       });
-      out.flush();
+      sent();
     }
     void ended_suite(const std::vector<suite_name> &suites) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "ended_suite"},
         {"suites", wrap_suites(suites)}
       });
-      out.flush();
+      flush();
     }
 
     void started_test(const test_name &test) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "started_test"},
         {"test", wrap_test(test)}
       });
-      out.flush();
+      flush();
     }
 
     void passed_test(const test_name &test, const test_output &output,
                      test_duration duration) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "passed_test"},
         {"test", wrap_test(test)},
-        {"duration", duration.count()},
-        {"output", wrap_output(output)}
+        {"duration", wrap_duration_ms(duration)},
+        {"times", wrap_duration(duration)},
+        {"usage", wrap_usage(duration.usage)},
+        {"output", wrap_output(passing_output ? output : test_output{})}
       });
-      out.flush();
+      sent();
     }
 
     void failed_test(const test_name &test, const test_failure &failure,
                      const test_output &output,
                      test_duration duration) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "failed_test"},
         {"test", wrap_test(test)},
-        {"duration", duration.count()},
+        {"duration", wrap_duration_ms(duration)},
+        {"times", wrap_duration(duration)},
+        {"usage", wrap_usage(duration.usage)},
         {"failure", failure.to_bencode<bencode::data_view>()},
         {"output", wrap_output(output)}
       });
-      out.flush();
+      sent();
     }
 
     void skipped_test(const test_name &test,
                       const std::string &message) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(buffer, bencode::dict_view{
         {"event", "skipped_test"},
         {"test", wrap_test(test)},
         {"message", message}
       });
+      sent();
+    }
+
+    void listed_test(const test_name &test,
+                     const test_attrs &attrs) override {
+      bencode::encode(buffer, bencode::dict_view{
+        {"event", "listed_test"},
+        {"test", wrap_test(test)},
+        {"attributes", wrap_attrs(attrs)}
+      });
+      sent();
+    }
+
+    // Write out any pending events.
+    void flush() {
+      auto events = buffer.view();
+      if(events.empty())
+        return;
+      out.write(events.data(), static_cast<std::streamsize>(events.size()));
       out.flush();
+      buffer.str(std::string());
+      policy.reset();
     }
   private:
+    void sent() {
+      if(policy.ready(static_cast<std::size_t>(buffer.tellp())))
+        flush();
+    }
+
     bencode::dict_view wrap_test(const test_name &test) {
       return bencode::dict_view{
         {"id", bencode::integer(test.id)},
@@ -94,13 +137,56 @@ namespace mettle::log {
       };
     }
 
+    // Older readers expect the wall-clock time in milliseconds as
+    // "duration"; the full-resolution times (in nanoseconds) go in "times".
+    static bencode::integer wrap_duration_ms(const test_duration &duration) {
+      using namespace std::chrono;
+      return duration_cast<milliseconds>(duration.wall).count();
+    }
+
+    static bencode::dict_view wrap_duration(const test_duration &duration) {
+      return bencode::dict_view{
+        {"wall", bencode::integer(duration.wall.count())},
+        {"user", bencode::integer(duration.user.count())},
+        {"system", bencode::integer(duration.system.count())}
+      };
+    }
+
+    static bencode::dict_view wrap_usage(const resource_usage &usage) {
+      auto integer = [](std::uint64_t i) {
+        return static_cast<bencode::integer>(i);
+      };
+      return bencode::dict_view{
+        {"max_rss", integer(usage.max_rss)},
+        {"minor_faults", integer(usage.minor_faults)},
+        {"major_faults", integer(usage.major_faults)},
+        {"voluntary_switches", integer(usage.voluntary_switches)},
+        {"involuntary_switches", integer(usage.involuntary_switches)},
+        {"block_inputs", integer(usage.block_inputs)},
+        {"block_outputs", integer(usage.block_outputs)}
+      };
+    }
+
     bencode::dict_view wrap_output(const test_output &output) {
       return bencode::dict_view{
         {"stdout_log", output.stdout_log},
-        {"stderr_log", output.stderr_log}
+        {"stderr_log", output.stderr_log},
+        {"stdout_dropped", bencode::integer(output.stdout_dropped)},
+        {"stderr_dropped", bencode::integer(output.stderr_dropped)}
       };
     }
 
+    bencode::dict_view wrap_attrs(const test_attrs &attrs) {
+      bencode::dict_view result;
+      for(auto &&[name, values] : attrs) {
+        bencode::list_view list;
+        for(auto &&i : values)
+          list.push_back(i);
+        result.emplace(name, std::move(list));
+      }
+      return result;
+    }
+
     bencode::list_view wrap_suites(const std::vector<suite_name> &suites) {
       bencode::list_view result;
       for(auto &&i : suites)
@@ -113,6 +199,9 @@ namespace mettle::log {
     }
 
     std::ostream &out;
+    bool passing_output;
+    flush_policy policy;
+    std::ostringstream buffer;
   };
 
 } // namespace mettle::log
@@ -1,7 +1,11 @@
 #ifndef INC_METTLE_DRIVER_LOG_CORE_HPP
 #define INC_METTLE_DRIVER_LOG_CORE_HPP
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -13,13 +17,79 @@ namespace mettle::log {
 
   struct test_output {
     std::string stdout_log, stderr_log;
+    std::size_t stdout_dropped = 0, stderr_dropped = 0;
 
     bool empty() const {
       return stdout_log.empty() && stderr_log.empty();
     }
   };
 
-  using test_duration = std::chrono::milliseconds;
+  // The other resources a test used, as reported by the operating system
+  // (see `getrusage(2)`). These are all zero if they couldn't be measured.
+  struct resource_usage {
+    std::uint64_t max_rss = 0; // Peak resident set size, in bytes.
+    std::uint64_t minor_faults = 0, major_faults = 0;
+    std::uint64_t voluntary_switches = 0, involuntary_switches = 0;
+    std::uint64_t block_inputs = 0, block_outputs = 0;
+
+    bool empty() const {
+      return *this == resource_usage{};
+    }
+
+    resource_usage & operator +=(const resource_usage &rhs) {
+      max_rss = std::max(max_rss, rhs.max_rss);
+      minor_faults += rhs.minor_faults;
+      major_faults += rhs.major_faults;
+      voluntary_switches += rhs.voluntary_switches;
+      involuntary_switches += rhs.involuntary_switches;
+      block_inputs += rhs.block_inputs;
+      block_outputs += rhs.block_outputs;
+      return *this;
+    }
+
+    bool operator ==(const resource_usage &) const = default;
+  };
+
+  // How long a test took: the wall-clock time, plus the CPU time the test
+  // spent in user and system mode. The CPU times are zero if they couldn't
+  // be measured. This also holds the other resources the test used.
+  struct test_duration {
+    using duration = std::chrono::nanoseconds;
+
+    test_duration() = default;
+
+    template<typename Rep, typename Period>
+    test_duration(std::chrono::duration<Rep, Period> wall,
+                  duration user = duration::zero(),
+                  duration system = duration::zero(),
+                  resource_usage usage = {})
+      : wall(std::chrono::duration_cast<duration>(wall)), user(user),
+        system(system), usage(usage) {}
+
+    duration wall = duration::zero();
+    duration user = duration::zero();
+    duration system = duration::zero();
+    resource_usage usage;
+
+    duration cpu() const {
+      return user + system;
+    }
+
+    test_duration & operator +=(const test_duration &rhs) {
+      wall += rhs.wall;
+      user += rhs.user;
+      system += rhs.system;
+      usage += rhs.usage;
+      return *this;
+    }
+
+    bool operator ==(const test_duration &) const = default;
+  };
+
+  // The values of each of a test's attributes, by name. Unlike `attributes`,
+  // this doesn't refer to the attribute objects, which only exist inside the
+  // test file.
+  using test_attrs = std::map<std::string, std::set<std::string>>;
 
   class METTLE_PUBLIC test_logger {
   public:
@@ -45,6 +115,18 @@ namespace mettle::log {
                 const test_output &output, test_duration duration) = 0;
     virtual void
     skipped_test(const test_name &test, const std::string &message) = 0;
+
+    // Only called when listing tests instead of running them (e.g. with
+    // `--list`), so most loggers can ignore this.
+    virtual void
+    listed_test(const test_name &, const test_attrs &) {}
+
+    // Whether this logger does anything with the output of passing tests. If
+    // not, test files can leave it out of the events they send.
+    virtual bool
+    uses_passing_output() const {
+      return true;
+    }
   };
 
   class METTLE_PUBLIC file_logger : public test_logger {
@@ -39,6 +39,8 @@ namespace mettle::log {
 
     void failed_file(const test_file &file,
                      const std::string &message) override;
+
+    bool uses_passing_output() const override;
   private:
     void print_counter();
 
@@ -0,0 +1,54 @@
+#ifndef INC_METTLE_DRIVER_LOG_FLUSH_POLICY_HPP
+#define INC_METTLE_DRIVER_LOG_FLUSH_POLICY_HPP
+
+#include <chrono>
+#include <cstddef>
+
+namespace mettle::log {
+
+  // Decides when a child logger should send its pending events to the driver.
+  // Events are sent once `max_bytes` of them are pending, or once the oldest
+  // pending event is older than `max_delay` (checked whenever a new event is
+  // logged). By default, every event is sent immediately.
+  //
+  // Regardless of this policy, child loggers always send their events when a
+  // test starts and when a suite or run ends, so a test that crashes its
+  // process can't take any earlier events with it.
+  class flush_policy {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    flush_policy(std::size_t max_bytes = 0,
+                 clock::duration max_delay = clock::duration::zero())
+      : max_bytes_(max_bytes), max_delay_(max_delay) {}
+
+    // Return true if `pending` bytes of events should be sent now.
+    bool ready(std::size_t pending) {
+      if(pending >= max_bytes_)
+        return true;
+      if(max_delay_ == clock::duration::zero())
+        return false;
+
+      auto now = clock::now();
+      if(!waiting_) {
+        waiting_ = true;
+        oldest_ = now;
+        return false;
+      }
+      return now - oldest_ >= max_delay_;
+    }
+
+    // Note that all pending events have been sent.
+    void reset() {
+      waiting_ = false;
+    }
+  private:
+    std::size_t max_bytes_;
+    clock::duration max_delay_;
+    bool waiting_ = false;
+    clock::time_point oldest_;
+  };
+
+} // namespace mettle::log
+
+#endif
@@ -1,16 +1,31 @@
 #ifndef INC_METTLE_DRIVER_LOG_FORMAT_HPP
 #define INC_METTLE_DRIVER_LOG_FORMAT_HPP
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <string>
 
 #include "../../test_result.hpp"
 #include "../test_name.hpp"
+#include "core.hpp"
 
 namespace mettle {
 
   std::ostream & operator <<(std::ostream &os, const test_failure &failure);
   std::ostream & operator <<(std::ostream &os, const test_name &name);
 
+  namespace log {
+    std::ostream & operator <<(std::ostream &os, const resource_usage &usage);
+
+    // Show a time in milliseconds, to the nearest microsecond.
+    std::string format_milliseconds(std::chrono::nanoseconds time);
+
+    // Show a number of bytes in the largest sensible binary unit, e.g.
+    // "1.5 MiB".
+    std::string format_size(std::uint64_t bytes);
+  }
+
 } // namespace mettle
 
 #endif
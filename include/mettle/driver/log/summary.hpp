@@ -22,8 +22,10 @@ namespace mettle::log {
 
   class METTLE_PUBLIC summary : public file_logger {
   public:
+    // If `top_usage` is nonzero, the summary also lists that many of the
+    // tests with the highest peak memory use.
     summary(indenting_ostream &out, std::unique_ptr<file_logger> &&log,
-            bool show_time, bool show_terminal);
+            bool show_time, bool show_terminal, std::size_t top_usage = 0);
 
     void started_run() override;
     void ended_run() override;
@@ -45,6 +47,10 @@ namespace mettle::log {
     void failed_file(const test_file &file,
                      const std::string &message) override;
 
+    // The summary itself only shows the output of failing tests, so this
+    // depends on the logger it wraps.
+    bool uses_passing_output() const override;
+
     void summarize() const;
     bool good() const;
   private:
@@ -66,22 +72,31 @@ namespace mettle::log {
       std::vector<failure> failures;
     };
 
+    struct usage {
+      std::string name;
+      test_duration duration;
+    };
+
     unpass & add_unpass(test_uid id, std::string name, unpass_type type);
+    void add_usage(const test_name &test, const test_duration &duration);
 
     void summarize_skip(const std::string &test,
                         const std::string &message) const;
     void summarize_failure(const std::string &where,
                            const std::vector<failure> &failures) const;
+    void summarize_usage() const;
     void log_output(const test_output &output, bool extra_newline) const;
 
     indenting_ostream &out_;
     std::unique_ptr<file_logger> log_;
     bool show_time_, show_terminal_;
+    std::size_t top_usage_;
     std::chrono::steady_clock::time_point start_time_;
 
     std::size_t total_ = 0, runs_ = 0;
     std::size_t unpass_counts_[3] = {0};
     std::map<test_uid, unpass> unpasses_;
+    std::map<test_uid, usage> usages_;
   };
 
 } // namespace mettle::log
@@ -0,0 +1,82 @@
+#ifndef INC_METTLE_DRIVER_LOG_TEST_LIST_HPP
+#define INC_METTLE_DRIVER_LOG_TEST_LIST_HPP
+
+#include <optional>
+#include <ostream>
+#include <utility>
+
+#include "core.hpp"
+#include "../detail/export.hpp"
+
+// Ignore warnings from MSVC about DLL interfaces.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4251)
+#endif
+
+namespace mettle {
+
+  enum class list_format {
+    text,
+    json
+  };
+
+  namespace log {
+
+    // Print an inventory of the tests passed to `listed_test`, either as
+    // tab-separated lines of text or as a JSON array.
+    class METTLE_PUBLIC test_list : public file_logger {
+    public:
+      test_list(std::ostream &out, list_format format);
+
+      void started_run() override;
+      void ended_run() override;
+
+      void started_suite(const std::vector<suite_name> &suites) override;
+      void ended_suite(const std::vector<suite_name> &suites) override;
+
+      void started_test(const test_name &test) override;
+      void passed_test(const test_name &test, const test_output &output,
+                       test_duration duration) override;
+      void failed_test(const test_name &test, const test_failure &failure,
+                       const test_output &output,
+                       test_duration duration) override;
+      void skipped_test(const test_name &test,
+                        const std::string &message) override;
+      void listed_test(const test_name &test,
+                       const test_attrs &attrs) override;
+
+      void started_file(const test_file &file) override;
+      void ended_file(const test_file &file) override;
+
+      void failed_file(const test_file &file,
+                       const std::string &message) override;
+
+      bool good() const {
+        return failures_.empty();
+      }
+
+      const std::vector<std::pair<test_file, std::string>> &
+      failures() const {
+        return failures_;
+      }
+    private:
+      void print_text(const test_name &test, const test_attrs &attrs);
+      void print_json(const test_name &test, const test_attrs &attrs);
+
+      std::ostream &out_;
+      list_format format_;
+      std::optional<test_file> file_;
+      std::size_t count_ = 0;
+      std::vector<std::pair<test_file, std::string>> failures_;
+    };
+
+  } // namespace log
+
+} // namespace mettle
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
+#endif
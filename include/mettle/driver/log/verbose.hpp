@@ -42,6 +42,7 @@ namespace mettle::log {
                      const std::string &message) override;
   private:
     void log_time(test_duration duration) const;
+    void log_usage(const resource_usage &usage) const;
     void summarize_output(const test_output &output) const;
     void log_output(const test_output &output, bool extra_newline) const;
 
@@ -57,7 +57,7 @@ namespace mettle::log {
 
       xml::element_ptr elt;
       std::size_t failures{0}, skips{0};
-      test_duration duration{0};
+      test_duration duration;
     };
 
     suite_stack_item & current_suite();
@@ -66,7 +66,7 @@ namespace mettle::log {
     xml::document doc_;
     std::stack<suite_stack_item> suite_stack_;
     std::size_t tests_{0}, failures_{0}, skips_{0};
-    test_duration duration_{0};
+    test_duration duration_;
   };
 
 } // namespace mettle::log
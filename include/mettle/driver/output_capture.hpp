@@ -0,0 +1,82 @@
+#ifndef INC_METTLE_DRIVER_OUTPUT_CAPTURE_HPP
+#define INC_METTLE_DRIVER_OUTPUT_CAPTURE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace mettle {
+
+  // Collects output from a stream (e.g. a test's stdout). If a limit is set,
+  // this keeps the first half of that many bytes, plus the most recent half
+  // in a ring buffer, and counts how many bytes in between were dropped.
+  class output_capture {
+  public:
+    using limit_t = std::optional<std::size_t>;
+
+    output_capture(limit_t limit = std::nullopt) : limit_(limit) {}
+
+    void append(const char *data, std::size_t size) {
+      if(!limit_) {
+        head_.append(data, size);
+        return;
+      }
+
+      std::size_t head_limit = *limit_ - *limit_ / 2;
+      if(head_.size() < head_limit) {
+        std::size_t n = std::min(size, head_limit - head_.size());
+        head_.append(data, n);
+        data += n;
+        size -= n;
+      }
+
+      std::size_t tail_limit = *limit_ / 2;
+      if(size >= tail_limit) {
+        dropped_ += tail_.size() + size - tail_limit;
+        tail_.assign(data + size - tail_limit, tail_limit);
+        tail_start_ = 0;
+        return;
+      }
+
+      // Fill up the ring buffer, then start overwriting its oldest data.
+      if(tail_.size() < tail_limit) {
+        std::size_t n = std::min(size, tail_limit - tail_.size());
+        tail_.append(data, n);
+        data += n;
+        size -= n;
+      }
+      dropped_ += size;
+      while(size) {
+        std::size_t n = std::min(size, tail_limit - tail_start_);
+        tail_.replace(tail_start_, n, data, n);
+        tail_start_ = (tail_start_ + n) % tail_limit;
+        data += n;
+        size -= n;
+      }
+    }
+
+    std::size_t dropped() const {
+      return dropped_;
+    }
+
+    // Get the captured output, noting where any output was dropped.
+    std::string str() const {
+      std::string result = head_;
+      if(dropped_) {
+        result += "\n[... " + std::to_string(dropped_) +
+                  " bytes dropped ...]\n";
+      }
+      result.append(tail_, tail_start_);
+      result.append(tail_, 0, tail_start_);
+      return result;
+    }
+  private:
+    limit_t limit_;
+    std::string head_, tail_;
+    std::size_t tail_start_ = 0, dropped_ = 0;
+  };
+
+} // namespace mettle
+
+#endif
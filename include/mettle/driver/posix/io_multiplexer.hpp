@@ -0,0 +1,82 @@
+#ifndef INC_METTLE_DRIVER_POSIX_IO_MULTIPLEXER_HPP
+#define INC_METTLE_DRIVER_POSIX_IO_MULTIPLEXER_HPP
+
+#include <signal.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mettle::posix {
+
+  // Waits on a set of file descriptors (e.g. the stdout, stderr, and log pipes
+  // of running tests) and passes whatever is read from each one to its sink.
+  // Descriptors can also be watched for a single event, like a child exiting.
+  // Descriptors are removed automatically when they hit EOF. On Linux, this
+  // uses epoll(7), so descriptors are only registered once and there's no
+  // limit on their values; elsewhere, it uses pselect(2).
+  class io_multiplexer {
+  public:
+    io_multiplexer();
+    io_multiplexer(const io_multiplexer &) = delete;
+    io_multiplexer & operator =(const io_multiplexer &) = delete;
+    ~io_multiplexer();
+
+    using sink_type = std::function<void(const char *, std::size_t)>;
+
+    int add(int fd, sink_type sink);
+    int add(int fd, std::string *dest) {
+      return add(fd, [dest](const char *data, std::size_t size) {
+        dest->append(data, size);
+      });
+    }
+
+    // Call `on_ready` once `fd` becomes readable, and then stop watching it.
+    // Nothing is read from `fd`, so this suits descriptors that signal an
+    // event rather than carry data, like pidfds.
+    using event_type = std::function<void()>;
+    int watch(int fd, event_type on_ready);
+
+    int remove(int fd);
+
+    // Forget every descriptor and close our handle to the epoll instance,
+    // without unregistering anything from it. This is for use in forked
+    // children, which share that instance with their parent; the parent's
+    // registrations are unaffected, since it still holds its own handle.
+    int close();
+
+    // Wait for any descriptor to become readable (or for the timeout to
+    // expire, or for a signal to arrive), and read from every ready one.
+    // Returns the number of descriptors read, 0 on timeout, or -1 on error.
+    // If no descriptors are registered, this just waits.
+    int wait(const timespec *timeout, const sigset_t *sigmask);
+
+    // Read everything currently available from `fd` without blocking.
+    int drain(int fd);
+
+    bool empty() const {
+      return fds_.empty();
+    }
+
+    bool contains(int fd) const {
+      return fds_.contains(fd);
+    }
+  private:
+    struct entry {
+      int fd;
+      sink_type sink;
+      event_type on_ready;
+    };
+
+    int add_entry(entry e);
+    int read_ready(entry &e);
+
+    int epoll_fd_ = -1;
+    std::unordered_map<int, entry> fds_;
+    std::vector<char> buffer_;
+  };
+
+} // namespace mettle::posix
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef INC_METTLE_DRIVER_POSIX_PIDFD_HPP
+#define INC_METTLE_DRIVER_POSIX_PIDFD_HPP
+
+#include <sys/types.h>
+
+namespace mettle::posix {
+
+  // Open a descriptor for the process `pid` that becomes readable once the
+  // process exits (see pidfd_open(2)), so that waiting for children can be
+  // done with poll/epoll instead of SIGCHLD. The descriptor is close-on-exec.
+  // Returns -1 on error; where pidfds aren't available, errno is ENOSYS.
+  int open_pidfd(pid_t pid);
+
+  // Check whether `open_pidfd()` works on this system.
+  bool has_pidfd();
+
+} // namespace mettle::posix
+
+#endif
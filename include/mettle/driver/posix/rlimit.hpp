@@ -0,0 +1,34 @@
+#ifndef INC_METTLE_DRIVER_POSIX_RLIMIT_HPP
+#define INC_METTLE_DRIVER_POSIX_RLIMIT_HPP
+
+#include <sys/resource.h>
+
+#include <optional>
+#include <string>
+
+#include "../resource_limits.hpp"
+#include "../../test_result.hpp"
+
+namespace mettle::posix {
+
+  // Apply `limits` to this process. This is meant to be called in a test's
+  // child process just before running the test.
+  int set_limits(const resource_limits &limits);
+
+  // If the test that just ran in this process failed because it hit one of
+  // `limits`, say so in its failure message. This is only a guess: we blame
+  // the memory limit if `operator new` has failed since the limit was set,
+  // and the open files limit if there are no descriptors to spare now.
+  void check_limits(const resource_limits &limits, test_result &result);
+
+  // Get the message for a test that was killed by exceeding one of `limits`,
+  // given its exit `status` and resource `usage` (e.g. from `wait4`). Like
+  // `check_limits`, this is a guess: a test killed by SIGKILL is blamed on the
+  // CPU limit if it used at least that much CPU time.
+  std::optional<std::string>
+  exceeded_limit(const resource_limits &limits, int status,
+                 const rusage &usage);
+
+} // namespace mettle::posix
+
+#endif
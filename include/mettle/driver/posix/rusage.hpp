@@ -0,0 +1,44 @@
+#ifndef INC_METTLE_DRIVER_POSIX_RUSAGE_HPP
+#define INC_METTLE_DRIVER_POSIX_RUSAGE_HPP
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "../log/core.hpp"
+
+namespace mettle::posix {
+
+  inline std::chrono::nanoseconds to_duration(const timeval &tv) {
+    return std::chrono::seconds(tv.tv_sec) +
+           std::chrono::microseconds(tv.tv_usec);
+  }
+
+  // Add the CPU times and other resources recorded in `usage` (e.g. as
+  // reported by `wait4`) to `duration`.
+  inline void add_rusage(log::test_duration &duration, const rusage &usage) {
+    duration.user += to_duration(usage.ru_utime);
+    duration.system += to_duration(usage.ru_stime);
+
+    log::resource_usage &u = duration.usage;
+#ifdef __APPLE__
+    // macOS reports the max RSS in bytes; everyone else uses kilobytes.
+    auto max_rss = static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+    auto max_rss = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    u.max_rss = std::max(u.max_rss, max_rss);
+    u.minor_faults += static_cast<std::uint64_t>(usage.ru_minflt);
+    u.major_faults += static_cast<std::uint64_t>(usage.ru_majflt);
+    u.voluntary_switches += static_cast<std::uint64_t>(usage.ru_nvcsw);
+    u.involuntary_switches += static_cast<std::uint64_t>(usage.ru_nivcsw);
+    u.block_inputs += static_cast<std::uint64_t>(usage.ru_inblock);
+    u.block_outputs += static_cast<std::uint64_t>(usage.ru_oublock);
+  }
+
+} // namespace mettle::posix
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef INC_METTLE_DRIVER_POSIX_SCOPED_PIPE_HPP
 #define INC_METTLE_DRIVER_POSIX_SCOPED_PIPE_HPP
 
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 
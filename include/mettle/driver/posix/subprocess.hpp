@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "io_multiplexer.hpp"
+
 namespace mettle::posix {
 
   struct readfd {
@@ -16,8 +18,13 @@ namespace mettle::posix {
 
   void make_timeout_monitor(std::chrono::milliseconds timeout);
 
-  int read_into(std::vector<readfd> &dests, const timespec *timeout,
-                const sigset_t *sigmask);
+  timespec to_timespec(std::chrono::nanoseconds duration);
+
+  // Read from each of `dests` until they've all closed (negating the fd of
+  // each closed one), or until the timeout expires or a signal arrives. `io`
+  // should be empty, and is left empty afterward so that it can be reused.
+  int read_into(io_multiplexer &io, std::vector<readfd> &dests,
+                const timespec *timeout, const sigset_t *sigmask);
 
   int send_pgid(int fd, int pgid);
   int recv_pgid(int fd, int *pgid);
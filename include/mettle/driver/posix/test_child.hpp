@@ -0,0 +1,23 @@
+#ifndef INC_METTLE_DRIVER_POSIX_TEST_CHILD_HPP
+#define INC_METTLE_DRIVER_POSIX_TEST_CHILD_HPP
+
+#include "scoped_pipe.hpp"
+#include "../resource_limits.hpp"
+#include "../../suite/compiled_suite.hpp"
+
+namespace mettle::posix {
+
+  // Send this process's stdout and stderr to the write ends of `stdout_pipe`
+  // and `stderr_pipe`, and make a new process group so that the test (and any
+  // children it spawns) can be killed as a group.
+  int enter_test_process(scoped_pipe &stdout_pipe, scoped_pipe &stderr_pipe);
+
+  // Run `test` in this (forked) process under `limits`, write its failure, if
+  // any, to `log_fd` as bencode, and exit with the test's status.
+  [[noreturn]] void
+  run_test_in_child(const test_info &test, const resource_limits &limits,
+                    int log_fd);
+
+} // namespace mettle::posix
+
+#endif
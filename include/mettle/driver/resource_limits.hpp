@@ -0,0 +1,35 @@
+#ifndef INC_METTLE_DRIVER_RESOURCE_LIMITS_HPP
+#define INC_METTLE_DRIVER_RESOURCE_LIMITS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#include "detail/export.hpp"
+#include "../suite/attributes.hpp"
+
+namespace mettle {
+
+  // Caps on the resources a test run in a subprocess may use (see
+  // `setrlimit(2)`). A limit of zero means that resource isn't limited.
+  struct resource_limits {
+    std::uint64_t memory = 0; // Address space, in bytes.
+    std::chrono::seconds cpu_time = std::chrono::seconds::zero();
+    std::uint64_t open_files = 0;
+
+    bool empty() const {
+      return *this == resource_limits{};
+    }
+
+    bool operator ==(const resource_limits &) const = default;
+  };
+
+  // Get the limits for a test, using the values of its `memory_limit`,
+  // `cpu_limit`, and `open_files_limit` attributes in place of the
+  // corresponding `defaults`. Throws `std::invalid_argument` if any of those
+  // attributes is malformed.
+  METTLE_PUBLIC resource_limits
+  test_limits(const resource_limits &defaults, const attributes &attrs);
+
+} // namespace mettle
+
+#endif
@@ -1,6 +1,18 @@
 #ifndef INC_METTLE_DRIVER_RUN_TESTS_HPP
 #define INC_METTLE_DRIVER_RUN_TESTS_HPP
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#ifndef _WIN32
+#  include "posix/rusage.hpp"
+#endif
+
 #include "../suite/compiled_suite.hpp"
 #include "filters_core.hpp"
 #include "log/core.hpp"
@@ -11,6 +23,29 @@ namespace mettle {
     test_result(const test_info &, log::test_output &)
   >;
 
+  class concurrent_test_runner {
+  public:
+    using callback_type = std::function<void(
+      const test_result &, const log::test_output &, log::test_duration
+    )>;
+
+    virtual ~concurrent_test_runner() {}
+
+    // Start running a test, waiting for an earlier test to finish first if
+    // there are no free job slots. `done` is called once the test finishes,
+    // from within a later call to `start()` or `wait()`.
+    virtual void start(const test_info &test, callback_type done) = 0;
+
+    // Wait for all running tests to finish.
+    virtual void wait() = 0;
+  };
+
+  // Estimate how long a test will take, returning nothing if there's no
+  // estimate for it.
+  using test_estimator = std::function<
+    std::optional<std::chrono::microseconds>(const test_name &)
+  >;
+
   namespace detail {
 
     class suite_stack {
@@ -57,9 +92,186 @@ namespace mettle {
       value_type committed_, queued_;
     };
 
-    template<typename Suites, typename Filter>
+    // Forward events to a logger in the order they were produced, holding
+    // back any events that come after a test whose result isn't in yet.
+    class ordered_logger : public log::test_logger {
+    public:
+      ordered_logger(log::test_logger &logger) : logger_(logger) {}
+
+      void started_run() override {
+        push([](log::test_logger &l) { l.started_run(); });
+      }
+      void ended_run() override {
+        push([](log::test_logger &l) { l.ended_run(); });
+      }
+
+      void started_suite(const std::vector<suite_name> &suites) override {
+        push([suites](log::test_logger &l) { l.started_suite(suites); });
+      }
+      void ended_suite(const std::vector<suite_name> &suites) override {
+        push([suites](log::test_logger &l) { l.ended_suite(suites); });
+      }
+
+      void started_test(const test_name &test) override {
+        push([test](log::test_logger &l) { l.started_test(test); });
+      }
+      void passed_test(const test_name &test, const log::test_output &output,
+                       log::test_duration duration) override {
+        push([test, output, duration](log::test_logger &l) {
+          l.passed_test(test, output, duration);
+        });
+      }
+      void failed_test(const test_name &test, const test_failure &failure,
+                       const log::test_output &output,
+                       log::test_duration duration) override {
+        push([test, failure, output, duration](log::test_logger &l) {
+          l.failed_test(test, failure, output, duration);
+        });
+      }
+      void skipped_test(const test_name &test,
+                        const std::string &message) override {
+        push([test, message](log::test_logger &l) {
+          l.skipped_test(test, message);
+        });
+      }
+
+      // Reserve a place in line for an event we don't know yet.
+      std::size_t reserve() {
+        events_.emplace_back();
+        return first_ + events_.size() - 1;
+      }
+
+      template<typename F>
+      void fulfill(std::size_t slot, F &&f) {
+        assert(slot >= first_ && slot - first_ < events_.size());
+        events_[slot - first_] = std::forward<F>(f);
+        flush();
+      }
+    private:
+      using event = std::function<void(log::test_logger &)>;
+
+      template<typename F>
+      void push(F &&f) {
+        if(events_.empty())
+          f(logger_);
+        else
+          events_.emplace_back(std::forward<F>(f));
+      }
+
+      void flush() {
+        for(; !events_.empty() && events_.front(); first_++) {
+          events_.front()(logger_);
+          events_.pop_front();
+        }
+      }
+
+      log::test_logger &logger_;
+      std::deque<event> events_;
+      std::size_t first_ = 0;
+    };
+
+    // Get the current wall-clock time, along with the CPU time and other
+    // resources used so far by this process and any children it's waited
+    // for. CPU times and resource usage aren't currently measured on Windows.
+    inline log::test_duration current_usage() {
+      log::test_duration now;
+      now.wall = std::chrono::steady_clock::now().time_since_epoch();
+#ifndef _WIN32
+      for(int who : {RUSAGE_SELF, RUSAGE_CHILDREN}) {
+        rusage usage;
+        if(getrusage(who, &usage) == 0)
+          posix::add_rusage(now, usage);
+      }
+#endif
+      return now;
+    }
+
+    // Get the resources used between two calls to `current_usage()`. The
+    // peak RSS can't be broken down like this, so just use the latest value.
+    inline log::test_duration
+    usage_since(const log::test_duration &then,
+                const log::test_duration &now) {
+      log::test_duration result(now.wall - then.wall, now.user - then.user,
+                                now.system - then.system, now.usage);
+      auto &u = result.usage;
+      u.minor_faults -= then.usage.minor_faults;
+      u.major_faults -= then.usage.major_faults;
+      u.voluntary_switches -= then.usage.voluntary_switches;
+      u.involuntary_switches -= then.usage.involuntary_switches;
+      u.block_inputs -= then.usage.block_inputs;
+      u.block_outputs -= then.usage.block_outputs;
+      return result;
+    }
+
+    inline auto run_serially(const test_runner &runner) {
+      return [&runner](log::test_logger &logger, const test_name &name,
+                       const test_info &test) {
+        log::test_output output;
+
+        auto then = current_usage();
+        auto failed = runner(test, output);
+        auto duration = usage_since(then, current_usage());
+
+        if(failed)
+          logger.failed_test(name, *failed, output, duration);
+        else
+          logger.passed_test(name, output, duration);
+      };
+    }
+
+    inline concurrent_test_runner::callback_type
+    fulfill_result(ordered_logger &ordered, std::size_t slot, test_name name) {
+      return [&ordered, slot, name = std::move(name)](
+        const test_result &failed, const log::test_output &output,
+        log::test_duration duration
+      ) {
+        if(failed) {
+          ordered.fulfill(slot, [name, failure = *failed, output, duration](
+            log::test_logger &l
+          ) {
+            l.failed_test(name, failure, output, duration);
+          });
+        } else {
+          ordered.fulfill(slot, [name, output, duration](
+            log::test_logger &l
+          ) {
+            l.passed_test(name, output, duration);
+          });
+        }
+      };
+    }
+
+    inline auto run_concurrently(concurrent_test_runner &runner,
+                                 ordered_logger &ordered) {
+      return [&runner, &ordered](log::test_logger &, const test_name &name,
+                                 const test_info &test) {
+        auto slot = ordered.reserve();
+        runner.start(test, fulfill_result(ordered, slot, name));
+      };
+    }
+
+    // A test that's been logged as started, but hasn't been sent to the
+    // runner yet.
+    struct queued_test {
+      const test_info *test;
+      test_name name;
+      std::size_t slot;
+      std::optional<std::chrono::microseconds> estimate;
+    };
+
+    inline auto queue_tests(ordered_logger &ordered,
+                            const test_estimator &estimate,
+                            std::vector<queued_test> &queue) {
+      return [&ordered, &estimate, &queue](
+        log::test_logger &, const test_name &name, const test_info &test
+      ) {
+        queue.push_back({&test, name, ordered.reserve(), estimate(name)});
+      };
+    }
+
+    template<typename Suites, typename Filter, typename RunTest>
     void run_tests_impl(
-      const Suites &suites, log::test_logger &logger, const test_runner &runner,
+      const Suites &suites, log::test_logger &logger, RunTest &&run_test,
       const Filter &filter, suite_stack &parents
     ) {
       for(const auto &suite : suites) {
@@ -88,21 +300,10 @@ namespace mettle {
             continue;
           }
 
-          log::test_output output;
-
-          using namespace std::chrono;
-          auto then = steady_clock::now();
-          auto failed = runner(test, output);
-          auto now = steady_clock::now();
-          auto duration = duration_cast<log::test_duration>(now - then);
-
-          if(failed)
-            logger.failed_test(name, *failed, output, duration);
-          else
-            logger.passed_test(name, output, duration);
+          run_test(logger, name, test);
         }
 
-        run_tests_impl(suite.subsuites(), logger, runner, filter, parents);
+        run_tests_impl(suite.subsuites(), logger, run_test, filter, parents);
 
         if(!parents.has_queued())
           logger.ended_suite(parents.committed());
@@ -122,22 +323,85 @@ namespace mettle {
                  const test_runner &runner, const Filter &filter) {
     detail::suite_stack parents;
     logger.started_run();
-    detail::run_tests_impl(suites, logger, runner, filter, parents);
+    detail::run_tests_impl(suites, logger, detail::run_serially(runner), filter,
+                           parents);
     logger.ended_run();
   }
 
+  template<typename Suites, typename Filter>
+  void run_tests(const Suites &suites, log::test_logger &logger,
+                 concurrent_test_runner &runner, const Filter &filter) {
+    detail::suite_stack parents;
+    detail::ordered_logger ordered(logger);
+    ordered.started_run();
+    detail::run_tests_impl(suites, ordered,
+                           detail::run_concurrently(runner, ordered), filter,
+                           parents);
+    runner.wait();
+    ordered.ended_run();
+  }
+
+  // Like the above, but start the tests that `estimate` expects to take the
+  // longest first, so that one slow test doesn't hold up the end of the run.
+  // Tests without an estimate go first of all, since they could take any
+  // amount of time. Results are still logged in the usual order.
+  template<typename Suites, typename Filter>
+  void run_tests(const Suites &suites, log::test_logger &logger,
+                 concurrent_test_runner &runner, const Filter &filter,
+                 const test_estimator &estimate) {
+    detail::suite_stack parents;
+    detail::ordered_logger ordered(logger);
+    std::vector<detail::queued_test> queue;
+    ordered.started_run();
+    detail::run_tests_impl(suites, ordered,
+                           detail::queue_tests(ordered, estimate, queue),
+                           filter, parents);
+
+    std::stable_sort(queue.begin(), queue.end(), [](const auto &lhs,
+                                                    const auto &rhs) {
+      if(!lhs.estimate || !rhs.estimate)
+        return !lhs.estimate && rhs.estimate;
+      return *lhs.estimate > *rhs.estimate;
+    });
+    for(auto &i : queue) {
+      runner.start(*i.test, detail::fulfill_result(ordered, i.slot,
+                                                   std::move(i.name)));
+    }
+
+    runner.wait();
+    ordered.ended_run();
+  }
+
   template<typename Suites, typename Filter>
   inline void run_tests(const Suites &suites, log::test_logger &&logger,
                         const test_runner &runner, const Filter &filter) {
     run_tests(suites, logger, runner, filter);
   }
 
+  template<typename Suites, typename Filter>
+  inline void run_tests(const Suites &suites, log::test_logger &&logger,
+                        concurrent_test_runner &runner, const Filter &filter) {
+    run_tests(suites, logger, runner, filter);
+  }
+
   template<typename Suites>
   inline void run_tests(const Suites &suites, log::test_logger &logger,
                         const test_runner &runner) {
     run_tests(suites, logger, runner, default_filter());
   }
 
+  template<typename Suites>
+  inline void run_tests(const Suites &suites, log::test_logger &logger,
+                        concurrent_test_runner &runner) {
+    run_tests(suites, logger, runner, default_filter());
+  }
+
+  template<typename Suites>
+  inline void run_tests(const Suites &suites, log::test_logger &&logger,
+                        concurrent_test_runner &runner) {
+    run_tests(suites, logger, runner, default_filter());
+  }
+
   template<typename Suites>
   inline void run_tests(const Suites &suites, log::test_logger &&logger,
                         const test_runner &runner) {
@@ -2,16 +2,27 @@
 #define INC_METTLE_DRIVER_SUBPROCESS_TEST_RUNNER_HPP
 
 #include <chrono>
+#include <memory>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 #ifdef _WIN32
 #  include <wtypes.h>
 #endif
 
 #include <mettle/suite/compiled_suite.hpp>
+#include <mettle/driver/output_capture.hpp>
+#include <mettle/driver/resource_limits.hpp>
+#include <mettle/driver/run_tests.hpp>
 #include <mettle/driver/log/core.hpp>
 #include <mettle/driver/detail/export.hpp>
 
+#ifndef _WIN32
+#  include <mettle/driver/posix/io_multiplexer.hpp>
+#  include <mettle/driver/posix/scoped_signal.hpp>
+#endif
+
 // Ignore warnings from MSVC about DLL interfaces.
 #if defined(_MSC_VER) && !defined(__clang__)
 #  pragma warning(push)
@@ -20,24 +31,125 @@
 
 namespace mettle {
 
+#ifndef _WIN32
+  class parallel_subprocess_runner;
+#endif
+
   class METTLE_PUBLIC subprocess_test_runner {
   public:
     using timeout_t = std::optional<std::chrono::milliseconds>;
+    using max_output_t = output_capture::limit_t;
 
-    subprocess_test_runner(timeout_t timeout = {}) : timeout_(timeout) {}
+    // Resource limits aren't currently supported on Windows, so `limits` is
+    // ignored there.
+    subprocess_test_runner(timeout_t timeout = {},
+                           max_output_t max_output = {},
+                           resource_limits limits = {})
+      : timeout_(timeout), max_output_(max_output), limits_(limits) {}
 
     template<class Rep, class Period>
-    subprocess_test_runner(std::chrono::duration<Rep, Period> timeout)
-      : timeout_(timeout) {}
+    subprocess_test_runner(std::chrono::duration<Rep, Period> timeout,
+                           max_output_t max_output = {},
+                           resource_limits limits = {})
+      : timeout_(timeout), max_output_(max_output), limits_(limits) {}
 
     test_result
     operator ()(const test_info &test, log::test_output &output) const;
   private:
     timeout_t timeout_;
+    max_output_t max_output_;
+    resource_limits limits_;
+#ifndef _WIN32
+    // Created on first use and then reused for every test, so that we only set
+    // up its I/O multiplexer and buffers once. Copies of this runner share it.
+    mutable std::shared_ptr<parallel_subprocess_runner> runner_;
+#endif
   };
 
 #ifndef _WIN32
 
+  class METTLE_PUBLIC parallel_subprocess_runner
+    : public concurrent_test_runner {
+  public:
+    using timeout_t = subprocess_test_runner::timeout_t;
+    using max_output_t = subprocess_test_runner::max_output_t;
+
+    parallel_subprocess_runner(std::size_t jobs, timeout_t timeout = {},
+                               max_output_t max_output = {},
+                               resource_limits limits = {});
+    parallel_subprocess_runner(const parallel_subprocess_runner &) = delete;
+    ~parallel_subprocess_runner();
+
+    void start(const test_info &test, callback_type done) override;
+    void wait() override;
+  private:
+    struct job;
+
+    void wait_any();
+    bool reap_finished();
+    std::optional<std::chrono::steady_clock::time_point> next_deadline() const;
+    void finish(std::unique_ptr<job> j, const test_result &result);
+    int open_signals();
+    void close_signals();
+
+    std::size_t jobs_;
+    timeout_t timeout_;
+    max_output_t max_output_;
+    resource_limits limits_;
+    posix::io_multiplexer io_;
+    std::vector<std::unique_ptr<job>> running_;
+    posix::scoped_sigprocmask mask_;
+    posix::scoped_sigaction sigint_, sigquit_, sigchld_;
+  };
+
+  // Runs tests from a pool of long-lived worker processes forked from this
+  // one. Each worker is sent the IDs of the tests to run, and runs each of
+  // them in a fresh fork of itself, so the cost of starting up the test
+  // binary is only paid once per worker. Workers that die are replaced.
+  // Workers also build the fixtures of `fork_after_setup` suites before
+  // forking their tests, so those tests share a copy-on-write fixture.
+  class METTLE_PUBLIC forkserver_test_runner : public concurrent_test_runner {
+  public:
+    using timeout_t = subprocess_test_runner::timeout_t;
+    using max_output_t = subprocess_test_runner::max_output_t;
+
+    forkserver_test_runner(const suites_list &suites, std::size_t jobs = 1,
+                           timeout_t timeout = {},
+                           max_output_t max_output = {},
+                           resource_limits limits = {});
+    forkserver_test_runner(const forkserver_test_runner &) = delete;
+    ~forkserver_test_runner();
+
+    test_result operator ()(const test_info &test, log::test_output &output);
+
+    void start(const test_info &test, callback_type done) override;
+    void wait() override;
+
+    // A test, along with the shared fixtures of each suite enclosing it.
+    struct indexed_test {
+      const test_info *test;
+      std::vector<detail::shared_fixture_base *> fixtures;
+    };
+    using test_index = std::unordered_map<test_uid, indexed_test>;
+  private:
+    struct worker;
+
+    int spawn_worker();
+    void wait_any();
+    void finish(worker &w, const test_result &result,
+                const log::test_output &output,
+                log::test_duration duration = {});
+    void remove_worker(worker &w);
+
+    test_index tests_;
+    std::size_t jobs_;
+    timeout_t timeout_;
+    max_output_t max_output_;
+    resource_limits limits_;
+    std::vector<std::unique_ptr<worker>> workers_;
+    posix::scoped_sigaction sigint_, sigquit_;
+  };
+
   using fd_type = int;
   int make_fd_private(int fd);
 
@@ -46,13 +158,19 @@ namespace mettle {
   using fd_type = HANDLE;
   METTLE_PUBLIC int make_fd_private(HANDLE handle);
 
-  METTLE_PUBLIC const test_info *
-  find_test(const suites_list &suites, test_uid id);
-
   METTLE_PUBLIC int run_single_test(const test_info &test, HANDLE log_pipe);
 
 #endif
 
+  METTLE_PUBLIC const test_info *
+  find_test(const suites_list &suites, test_uid id);
+
+  // Get the timeout for a test: the value of its `timeout` attribute, if it
+  // has one, or `timeout` otherwise.
+  METTLE_PUBLIC subprocess_test_runner::timeout_t
+  test_timeout(subprocess_test_runner::timeout_t timeout,
+               const attributes &attrs);
+
 } // namespace mettle
 
 #if defined(_MSC_VER) && !defined(__clang__)
@@ -0,0 +1,20 @@
+#ifndef INC_METTLE_DRIVER_TEST_UIDS_HPP
+#define INC_METTLE_DRIVER_TEST_UIDS_HPP
+
+#include "detail/export.hpp"
+#include "../test_uid.hpp"
+#include "../suite/compiled_suite.hpp"
+
+namespace mettle {
+
+  // Reassign the IDs of every test in `suites` using `scheme`. Hashed IDs
+  // only use the low 32 bits, since `mettle` puts the index of each test file
+  // in the high bits. If two different tests hash to the same ID, the one
+  // declared later gets the next free ID instead. Throws `std::runtime_error`
+  // if two tests have the same name (and location, if applicable).
+  METTLE_PUBLIC void
+  assign_test_uids(suites_list &suites, test_uid_scheme scheme);
+
+} // namespace mettle
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef INC_METTLE_DRIVER_THREADED_TEST_RUNNER_HPP
+#define INC_METTLE_DRIVER_THREADED_TEST_RUNNER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "run_tests.hpp"
+#include "detail/export.hpp"
+
+// Ignore warnings from MSVC about DLL interfaces.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4251)
+#endif
+
+namespace mettle {
+
+  // Runs tests in this process on a pool of threads. Only tests with the
+  // `thread_safe` attribute (or every test, if `all_thread_safe` is set) run
+  // in parallel; any other test waits for the pool to go idle and then runs by
+  // itself. Like the inline runner, this doesn't capture the tests' output.
+  // Tests are handed out from a single shared queue; each test is coarse
+  // enough that contention on it doesn't matter.
+  //
+  // Tests run on the pool even when they run by themselves, so that the
+  // calling thread can enforce their timeouts (from their `timeout` attribute,
+  // or else the one passed to the constructor). A test that times out is
+  // reported as failed, but its thread can't be stopped, so it's detached and
+  // left to run in the background. Since any other test could then run
+  // alongside it, every test that hasn't started yet (and any test started
+  // afterwards) is failed without being run; once the run is over, the caller
+  // should check `timed_out()` and end the process without destroying the
+  // tests that the stuck thread might still be using.
+  class METTLE_PUBLIC threaded_test_runner : public concurrent_test_runner {
+  public:
+    using timeout_t = std::optional<std::chrono::milliseconds>;
+
+    threaded_test_runner(std::size_t jobs, bool all_thread_safe = false,
+                         timeout_t timeout = std::nullopt);
+    threaded_test_runner(const threaded_test_runner &) = delete;
+    ~threaded_test_runner();
+
+    void start(const test_info &test, callback_type done) override;
+    void wait() override;
+
+    // Whether any test has timed out.
+    bool timed_out();
+  private:
+    using clock = std::chrono::steady_clock;
+
+    enum class job_state {
+      running,
+      finished,
+      abandoned
+    };
+
+    struct job {
+      const test_info *test;
+      callback_type done;
+      timeout_t timeout;
+      test_result result = std::nullopt;
+      log::test_duration duration = {};
+
+      // Set by the worker thread once it picks up the job.
+      std::thread::id worker;
+      clock::time_point started;
+      // Whoever changes this first decides the job's fate: either the worker
+      // finishes it, or the calling thread gives up on it.
+      std::atomic<job_state> state = job_state::running;
+    };
+    using job_ptr = std::shared_ptr<job>;
+
+    static void run_job(job &j);
+    void run_worker();
+    static void not_run(job_ptr j, std::unique_lock<std::mutex> &lock);
+
+    // Wait until every queued test has finished (or timed out), calling their
+    // callbacks along the way.
+    void wait_idle(std::unique_lock<std::mutex> &lock);
+    std::optional<clock::time_point> next_deadline() const;
+    void expire_overdue();
+
+    bool all_thread_safe_;
+    timeout_t timeout_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable work_ready_, work_done_;
+    std::deque<job_ptr> pending_, finished_;
+    std::vector<job_ptr> running_;
+    bool stopping_ = false;
+    bool timed_out_ = false;
+  };
+
+} // namespace mettle
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef INC_METTLE_DRIVER_WATCHDOG_HPP
+#define INC_METTLE_DRIVER_WATCHDOG_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "run_tests.hpp"
+#include "detail/export.hpp"
+#include "log/core.hpp"
+
+// Ignore warnings from MSVC about DLL interfaces.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4251)
+#endif
+
+namespace mettle {
+
+  // Enforce timeouts on tests run in this process (e.g. with --no-subproc),
+  // where there's no subprocess to kill. This forwards events to another
+  // logger while a background thread keeps an eye on each test passed to
+  // `run()`. If a test goes over its timeout, the watchdog reports it as
+  // failed, ends its suites and the run so that the logger can write out its
+  // results, and then calls `on_timeout`.
+  //
+  // Since the timeout is reported from the background thread, every event
+  // passed to the underlying logger is serialized by a lock, which is also held
+  // while `on_timeout` runs; the handler may use the underlying logger, but
+  // not the watchdog itself. (Anything the test writes to stdout on its own
+  // can still interleave with the logger's output.) The test itself can't be
+  // stopped, so `on_timeout` should end the process and never return. If it
+  // does return anyway, the watchdog goes on watching any later tests.
+  class METTLE_PUBLIC watchdog : public log::test_logger {
+  public:
+    using timeout_t = std::optional<std::chrono::milliseconds>;
+    using handler_type = std::function<void()>;
+
+    watchdog(log::test_logger &logger, timeout_t timeout,
+             handler_type on_timeout);
+    watchdog(const watchdog &) = delete;
+    ~watchdog();
+
+    void started_run() override;
+    void ended_run() override;
+
+    void started_suite(const std::vector<suite_name> &suites) override;
+    void ended_suite(const std::vector<suite_name> &suites) override;
+
+    void started_test(const test_name &test) override;
+    void passed_test(const test_name &test, const log::test_output &output,
+                     log::test_duration duration) override;
+    void failed_test(const test_name &test, const test_failure &failure,
+                     const log::test_output &output,
+                     log::test_duration duration) override;
+    void skipped_test(const test_name &test,
+                      const std::string &message) override;
+
+    // Run `test` in this thread, watching it for the duration of its timeout
+    // (from its `timeout` attribute, or else the one passed to the
+    // constructor). This should be called just after `started_test()`.
+    test_result run(const test_info &test);
+  private:
+    using clock = std::chrono::steady_clock;
+
+    void watch();
+    void expire();
+
+    log::test_logger &logger_;
+    timeout_t timeout_;
+    handler_type on_timeout_;
+
+    // Guards the underlying logger; when both are needed, take `mutex_` first.
+    std::mutex log_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::optional<test_name> current_;
+    clock::time_point started_;
+    std::optional<clock::time_point> deadline_;
+    std::chrono::milliseconds limit_;
+    bool stopping_ = false;
+    std::thread thread_;
+  };
+
+} // namespace mettle
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iterator>
 #include <set>
 #include <sstream>
@@ -102,6 +103,25 @@ namespace mettle {
     }
   };
 
+  // Like a `string_attr`, but the value is a duration, stored as a number of
+  // milliseconds.
+  class duration_attr : public attr_base {
+  public:
+    duration_attr(std::string name)
+      : attr_base(std::move(name)) {}
+
+    template<typename Rep, typename Period>
+    attr_instance operator ()(std::chrono::duration<Rep, Period> value) const {
+      using std::chrono::milliseconds;
+      auto ms = std::chrono::duration_cast<milliseconds>(value).count();
+      return attr_instance{*this, {std::to_string(ms)}};
+    }
+
+    attr_instance operator ()(std::size_t ms) const {
+      return (*this)(std::chrono::milliseconds(ms));
+    }
+  };
+
   class list_attr : public attr_base {
   public:
     list_attr(std::string name)
@@ -168,6 +188,27 @@ namespace mettle {
   }
 
   inline bool_attr skip("skip", test_action::skip);
+  inline bool_attr fork_after_setup("fork_after_setup");
+  inline bool_attr thread_safe("thread_safe");
+  inline duration_attr timeout("timeout");
+  inline string_attr memory_limit("memory_limit");
+  inline string_attr cpu_limit("cpu_limit");
+  inline string_attr open_files_limit("open_files_limit");
+
+  // Find `attr` in `attrs`. Attributes are looked up by name, so make sure
+  // that what we found is really `attr`, and not just something with the same
+  // name.
+  inline const attr_instance *
+  find_attr(const attributes &attrs, const attr_base &attr) {
+    auto i = attrs.find(attr.name());
+    if(i == attrs.end() || &i->attribute != &attr)
+      return nullptr;
+    return &*i;
+  }
+
+  inline bool has_attr(const attributes &attrs, const attr_base &attr) {
+    return find_attr(attrs, attr) != nullptr;
+  }
 
 } // namespace mettle
 
@@ -2,10 +2,12 @@
 #define INC_METTLE_SUITE_COMPILED_SUITE_HPP
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "attributes.hpp"
+#include "detail/shared_fixture.hpp"
 #include "../test_result.hpp"
 #include "../test_uid.hpp"
 #include "../detail/forward_like.hpp"
@@ -42,8 +44,10 @@ namespace mettle {
     template<typename Tests, typename Subsuites, typename Compile>
     compiled_suite(
       std::string name, Tests &&tests, Subsuites &&subsuites,
-      const attributes &attrs, detail::source_location loc, Compile &&compile
-    ) : name_(std::move(name)), location_(loc) {
+      const attributes &attrs, detail::source_location loc, Compile &&compile,
+      std::shared_ptr<detail::shared_fixture_base> shared_fixture = {}
+    ) : name_(std::move(name)), location_(loc),
+        shared_fixture_(std::move(shared_fixture)) {
       for(auto &&test : tests) {
         tests_.emplace_back(
           detail::forward_like<Tests>(test.name),
@@ -63,14 +67,16 @@ namespace mettle {
     compiled_suite(const compiled_suite<Function2> &suite,
                    const attributes &attrs, Compile &&compile)
       : compiled_suite(suite.name_, suite.tests_, suite.subsuites_, attrs,
-                       suite.location_, std::forward<Compile>(compile)) {}
+                       suite.location_, std::forward<Compile>(compile),
+                       suite.shared_fixture_) {}
 
     template<typename Function2, typename Compile>
     compiled_suite(compiled_suite<Function2> &&suite,
                    const attributes &attrs, Compile &&compile)
       : compiled_suite(std::move(suite.name_), std::move(suite.tests_),
                        std::move(suite.subsuites_), attrs, suite.location_,
-                       std::forward<Compile>(compile)) {}
+                       std::forward<Compile>(compile),
+                       std::move(suite.shared_fixture_)) {}
 
     const std::string & name() const {
       return name_;
@@ -84,14 +90,27 @@ namespace mettle {
       return tests_;
     }
 
+    std::vector<test_info> & tests() {
+      return tests_;
+    }
+
     const std::vector<compiled_suite> & subsuites() const {
       return subsuites_;
     }
+
+    std::vector<compiled_suite> & subsuites() {
+      return subsuites_;
+    }
+
+    detail::shared_fixture_base * shared_fixture() const {
+      return shared_fixture_.get();
+    }
   private:
     std::string name_;
     std::vector<test_info> tests_;
     std::vector<compiled_suite> subsuites_;
     detail::source_location location_;
+    std::shared_ptr<detail::shared_fixture_base> shared_fixture_;
   };
 
   using runnable_suite = compiled_suite<test_result()>;
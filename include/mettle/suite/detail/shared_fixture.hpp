@@ -0,0 +1,57 @@
+#ifndef INC_METTLE_SUITE_DETAIL_SHARED_FIXTURE_HPP
+#define INC_METTLE_SUITE_DETAIL_SHARED_FIXTURE_HPP
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "../factory.hpp"
+
+namespace mettle::detail {
+
+  // A suite's fixture that can be built once ahead of time (e.g. in a process
+  // that each of the suite's tests are then forked from) and shared by all of
+  // its tests. If it hasn't been prepared, tests build their own as usual.
+  class shared_fixture_base {
+  public:
+    virtual ~shared_fixture_base() = default;
+
+    virtual void prepare() = 0;
+    virtual void reset() = 0;
+    virtual bool prepared() const = 0;
+  };
+
+  template<typename Factory, typename Child>
+  requires factory_for<Factory, Child>
+  class shared_fixture : public shared_fixture_base {
+    struct holder {
+      factory_result_t<Factory, Child> value;
+    };
+  public:
+    using value_type = std::remove_reference_t<factory_result_t<Factory, Child>>;
+
+    shared_fixture(Factory factory) : factory_(std::move(factory)) {}
+
+    void prepare() override {
+      value_.reset(new holder{factory_.template make<Child>()});
+    }
+
+    void reset() override {
+      value_.reset();
+    }
+
+    bool prepared() const override {
+      return bool(value_);
+    }
+
+    value_type & get() const {
+      return value_->value;
+    }
+  private:
+    Factory factory_;
+    std::unique_ptr<holder> value_;
+  };
+
+} // namespace mettle::detail
+
+#endif
@@ -2,9 +2,11 @@
 #define INC_METTLE_SUITE_DETAIL_TEST_CALLER_HPP
 
 #include <functional>
+#include <memory>
 #include <tuple>
 #include <utility>
 
+#include "shared_fixture.hpp"
 #include "../factory.hpp"
 
 namespace mettle::detail {
@@ -40,11 +42,16 @@ namespace mettle::detail {
   > {
     inline void operator ()(Parent &...args) {
       using base = test_caller<Parent..., factory_result_t<Factory, Child>>;
-      auto &&child = factory.template make<Child>();
-      base::operator ()(args..., child);
+      if(shared && shared->prepared()) {
+        base::operator ()(args..., shared->get());
+      } else {
+        auto &&child = factory.template make<Child>();
+        base::operator ()(args..., child);
+      }
     }
 
     Factory factory;
+    std::shared_ptr<shared_fixture<Factory, Child>> shared = {};
   };
 
 } // namespace mettle::detail
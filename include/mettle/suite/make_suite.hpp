@@ -5,6 +5,7 @@
 #include <array>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <tuple>
@@ -84,7 +85,8 @@ namespace mettle {
         std::move(b.attrs_), std::move(b.location_),
         [&b, &wrap](auto &&test) {
           return wrap(b.make_test_caller(std::move(test)));
-        }
+        },
+        b.shared_fixture()
       };
     }
 
@@ -325,6 +327,10 @@ namespace mettle {
       return {base::setup_, base::teardown_, std::move(test)};
     }
 
+    std::shared_ptr<detail::shared_fixture_base> shared_fixture() const {
+      return nullptr;
+    }
+
     template<typename Builder, typename Wrap>
     friend typename detail::wrapped_suite<Wrap, Builder>::type
     detail::finalize(Builder &, const Wrap &);
@@ -346,11 +352,21 @@ namespace mettle {
 
     suite_builder(with_source_location<std::string_view> name,
                   const attributes &attrs, Factory factory)
-      : base(name, attrs), factory_(factory) {}
+      : base(name, attrs), factory_(factory) {
+      if(has_attr(attrs, fork_after_setup))
+        shared_ = std::make_shared<shared_type>(factory_);
+    }
   private:
+    using shared_type = detail::shared_fixture<Factory, Fixture>;
+
     detail::fixture_test_caller<Factory, Fixture, ParentFixture...>
     make_test_caller(typename base::function_type &&test) {
-      return {{base::setup_, base::teardown_, std::move(test)}, factory_};
+      return {{base::setup_, base::teardown_, std::move(test)}, factory_,
+              shared_};
+    }
+
+    std::shared_ptr<detail::shared_fixture_base> shared_fixture() const {
+      return shared_;
     }
 
     template<typename Builder, typename Wrap>
@@ -358,6 +374,7 @@ namespace mettle {
     detail::finalize(Builder &, const Wrap &);
 
     factory_type factory_;
+    std::shared_ptr<shared_type> shared_;
   };
 
 
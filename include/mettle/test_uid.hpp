@@ -8,6 +8,17 @@ namespace mettle {
 
   using test_uid = std::uint64_t;
 
+  // How tests get their IDs. By default, tests are numbered in the order
+  // they're registered, so IDs change whenever a test is added or files are
+  // linked in a different order. The other schemes derive each ID from a hash
+  // of the test's full name (and its file name and line, for `location`),
+  // making them the same from build to build.
+  enum class test_uid_scheme {
+    sequential,
+    name,
+    location
+  };
+
   namespace detail {
     inline std::atomic<test_uid> next_test_uid(1);
     inline test_uid make_test_uid() { return next_test_uid++; }
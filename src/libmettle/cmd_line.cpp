@@ -3,6 +3,7 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
@@ -43,7 +44,33 @@ namespace mettle {
        "attributes of tests to run")
       ("test,T", value(&opts.filters.by_name)->value_name("REGEX"),
        "regex matching names of tests to run")
+      ("shard", value(&opts.filters.shard)->value_name("INDEX/COUNT"),
+       "split the tests into COUNT shards and run only the INDEX-th one")
       ("timeout,t", value(&opts.timeout)->value_name("MS"), "timeout in ms")
+      ("max-output", value(&opts.max_output)->value_name("SIZE"),
+       "maximum bytes of stdout/stderr to keep for each test")
+      ("max-memory", value<data_size>()->value_name("SIZE")
+                       ->notifier([&opts](data_size size) {
+                         opts.limits.memory = size.bytes;
+                       }),
+       "maximum address space for each test")
+      ("max-cpu-time", value(&opts.limits.cpu_time)->value_name("SECONDS"),
+       "maximum CPU time for each test")
+      ("max-open-files", value(&opts.limits.open_files)->value_name("N"),
+       "maximum number of open files for each test")
+      ("jobs,j", value(&opts.jobs)->value_name("N"),
+       "number of tests to run in parallel")
+      ("fork-server", value(&opts.fork_server)->zero_tokens(),
+       "run tests from a pool of pre-forked worker processes")
+      ("list", value(&opts.list)->zero_tokens(),
+       "list the tests to run instead of running them")
+      ("list-format", value(&opts.listing_format)->value_name("FORMAT")
+                        ->notifier([&opts](list_format) { opts.list = true; }),
+       "list the tests to run in this format (one of: text, json; default: "
+       "text); implies `--list`")
+      ("test-ids", value(&opts.test_uids)->value_name("SCHEME"),
+       "how to assign IDs to tests (one of: sequential, name, location; "
+       "default: sequential)")
     ;
     return desc;
   }
@@ -91,6 +118,8 @@ namespace mettle {
        "show terminal output for each test")
       ("show-time", value(&opts.show_time)->zero_tokens(),
        "show the duration for each test")
+      ("top-usage", value(&opts.top_usage)->value_name("N"),
+       "list the N tests with the highest peak memory use")
     ;
     return desc;
   }
@@ -196,6 +225,29 @@ namespace mettle {
     return result;
   }
 
+  data_size parse_data_size(const std::string &value) {
+    std::smatch m;
+    if(!std::regex_match(value, m, std::regex("(\\d+)([KMG]?)")))
+      throw std::invalid_argument("invalid size");
+
+    std::size_t bytes;
+    try {
+      bytes = boost::lexical_cast<std::size_t>(m.str(1));
+    } catch(...) {
+      throw std::invalid_argument("invalid size");
+    }
+
+    int shift = 0;
+    switch(m.str(2)[0]) {
+    case 'G': shift += 10; [[fallthrough]];
+    case 'M': shift += 10; [[fallthrough]];
+    case 'K': shift += 10;
+    }
+    if(bytes > (std::numeric_limits<std::size_t>::max() >> shift))
+      throw std::invalid_argument("size too large");
+    return {bytes << shift};
+  }
+
   void validate(boost::any &v, const std::vector<std::string> &values,
                 color_option*, int) {
     using namespace boost::program_options;
@@ -212,6 +264,49 @@ namespace mettle {
       boost::throw_exception(invalid_option_value(val));
   }
 
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                data_size*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    try {
+      v = parse_data_size(val);
+    } catch(...) {
+      boost::throw_exception(invalid_option_value(val));
+    }
+  }
+
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                list_format*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    if(val == "text")
+      v = list_format::text;
+    else if(val == "json")
+      v = list_format::json;
+    else
+      boost::throw_exception(invalid_option_value(val));
+  }
+
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                test_uid_scheme*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    if(val == "sequential")
+      v = test_uid_scheme::sequential;
+    else if(val == "name")
+      v = test_uid_scheme::name;
+    else if(val == "location")
+      v = test_uid_scheme::location;
+    else
+      boost::throw_exception(invalid_option_value(val));
+  }
+
   void validate(boost::any &v, const std::vector<std::string> &values,
                 attr_filter_set*, int) {
     using namespace boost::program_options;
@@ -244,6 +339,29 @@ namespace mettle {
     }
   }
 
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                shard_filter*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    std::smatch m;
+    if(!std::regex_match(val, m, std::regex("(\\d+)/(\\d+)")))
+      boost::throw_exception(invalid_option_value(val));
+
+    shard_filter shard;
+    try {
+      shard.index = boost::lexical_cast<std::size_t>(m.str(1));
+      shard.count = boost::lexical_cast<std::size_t>(m.str(2));
+    } catch(...) {
+      boost::throw_exception(invalid_option_value(val));
+    }
+
+    if(shard.index == 0 || shard.index > shard.count)
+      boost::throw_exception(invalid_option_value(val));
+    v = shard;
+  }
+
 } // namespace mettle
 
 namespace boost {
@@ -261,6 +379,19 @@ namespace boost {
     }
   }
 
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                std::chrono::seconds*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    try {
+      v = std::chrono::seconds(boost::lexical_cast<std::size_t>(val));
+    } catch(...) {
+      boost::throw_exception(invalid_option_value(val));
+    }
+  }
+
 #ifdef _WIN32
   void validate(boost::any &v, const std::vector<std::string> &values,
                 HANDLE*, int) {
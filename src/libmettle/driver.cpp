@@ -1,10 +1,21 @@
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
 #include <vector>
 
 #define NOMINMAX
 
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
 // Ignore warnings about deprecated implicit copy constructor.
 #if defined(__clang__)
 #  pragma clang diagnostic push
@@ -22,11 +33,18 @@
 
 #include <mettle/driver/cmd_line.hpp>
 #include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/history.hpp>
+#include <mettle/driver/list_tests.hpp>
 #include <mettle/driver/run_tests.hpp>
 #include <mettle/driver/subprocess_test_runner.hpp>
+#include <mettle/driver/test_uids.hpp>
+#include <mettle/driver/threaded_test_runner.hpp>
+#include <mettle/driver/watchdog.hpp>
+#include <mettle/driver/log/binary_child.hpp>
 #include <mettle/driver/log/child.hpp>
 #include <mettle/driver/log/summary.hpp>
 #include <mettle/driver/log/term.hpp>
+#include <mettle/driver/log/test_list.hpp>
 #include <mettle/driver/detail/export.hpp>
 #include <mettle/suite/compiled_suite.hpp>
 
@@ -35,23 +53,197 @@ namespace mettle {
   namespace {
     struct all_options : generic_options, driver_options, output_options {
       std::optional<fd_type> output_fd;
-#ifdef _WIN32
+      std::optional<std::string> history_file;
+#ifndef _WIN32
+      std::optional<int> control_fd;
+#else
       std::optional<test_uid> test_id;
       std::optional<HANDLE> log_fd;
 #endif
       bool no_subproc = false;
+      bool all_thread_safe = false;
+      bool passing_output = true;
+      unsigned int protocol_version = 0;
     };
 
+    // How long to hold onto events before sending them to whoever's reading
+    // --output-fd. Events are always sent when each test starts, so this
+    // mostly coalesces each test's result with the start of the next one.
+    const log::flush_policy output_fd_policy(
+      64 * 1024, std::chrono::milliseconds(100)
+    );
+
+// Ignore warnings from MSVC about unsafe getenv.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4996)
+#endif
+
+    // Read an environment variable that `mettle` set for us, and then clear
+    // it so that it doesn't leak into anything our tests run.
+    std::optional<std::string> take_env(const char *name) {
+      const char *value = std::getenv(name);
+      if(!value)
+        return std::nullopt;
+
+      std::string result = value;
+#ifndef _WIN32
+      unsetenv(name);
+#else
+      _putenv_s(name, "");
+#endif
+      return result;
+    }
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
     void report_error(const std::string &program_name,
                       const std::string &message) {
       std::cerr << program_name << ": " << message << std::endl;
     }
+
+    // A test run in this process has timed out, and there's no way to stop
+    // it. The watchdog has already ended the run, so flush what's been logged
+    // and bail out.
+    [[noreturn]] void exit_timed_out() {
+      std::cout.flush();
+      std::cerr.flush();
+      std::_Exit(exit_code::timeout);
+    }
+
+#ifndef _WIN32
+    // Wait for the next command from whoever's on the other end of
+    // --control-fd: either "run" to run all the tests again, or "run" followed
+    // by the IDs of the tests to run. Returns nothing once there are no more
+    // commands.
+    std::optional<std::set<test_uid>> read_run_command(int fd) {
+      // Read a byte at a time so that we never consume part of the next
+      // command.
+      std::string line;
+      char c;
+      ssize_t size;
+      while((size = read(fd, &c, 1)) != 0) {
+        if(size < 0) {
+          if(errno == EINTR)
+            continue;
+          throw std::system_error(errno, std::system_category());
+        }
+        if(c == '\n')
+          break;
+        line += c;
+      }
+      if(size == 0 && line.empty())
+        return std::nullopt;
+
+      std::istringstream ss(line);
+      std::string command;
+      if(!(ss >> command) || command != "run")
+        throw std::runtime_error("unknown command \"" + line + "\"");
+
+      std::set<test_uid> ids;
+      test_uid id;
+      while(ss >> id)
+        ids.insert(id);
+      if(!ss.eof())
+        throw std::runtime_error("invalid test ID in \"" + line + "\"");
+      return ids;
+    }
+#endif
+
+    // Hide any tests not in `ids` (unless it's empty), and otherwise defer to
+    // the usual filters.
+    struct id_filter {
+      filter_result
+      operator ()(const test_name &name, const attributes &attrs) const {
+        if(!ids.empty() && !ids.count(name.id))
+          return test_action::hide;
+        return filters(name, attrs);
+      }
+
+      const filter_set &filters;
+      const std::set<test_uid> &ids;
+    };
+
+    bool has_shared_fixtures(const suites_list &suites) {
+      for(const auto &suite : suites) {
+        if(suite.shared_fixture() || has_shared_fixtures(suite.subsuites()))
+          return true;
+      }
+      return false;
+    }
+
+    // Whether any test in `suites` sets its own timeout.
+    bool has_timeouts(const suites_list &suites) {
+      for(const auto &suite : suites) {
+        for(const auto &test : suite.tests()) {
+          if(has_attr(test.attrs, timeout))
+            return true;
+        }
+        if(has_timeouts(suite.subsuites()))
+          return true;
+      }
+      return false;
+    }
+
+    // Forward events to another logger, recording how long each test took.
+    class history_logger : public log::test_logger {
+    public:
+      history_logger(log::test_logger &logger, duration_history &history)
+        : logger_(logger), history_(history) {}
+
+      void started_run() override {
+        logger_.started_run();
+      }
+      void ended_run() override {
+        logger_.ended_run();
+      }
+
+      void started_suite(const std::vector<suite_name> &suites) override {
+        logger_.started_suite(suites);
+      }
+      void ended_suite(const std::vector<suite_name> &suites) override {
+        logger_.ended_suite(suites);
+      }
+
+      void started_test(const test_name &test) override {
+        logger_.started_test(test);
+      }
+      void passed_test(const test_name &test, const log::test_output &output,
+                       log::test_duration duration) override {
+        record(test, duration);
+        logger_.passed_test(test, output, duration);
+      }
+      void failed_test(const test_name &test, const test_failure &failure,
+                       const log::test_output &output,
+                       log::test_duration duration) override {
+        record(test, duration);
+        logger_.failed_test(test, failure, output, duration);
+      }
+      void skipped_test(const test_name &test,
+                        const std::string &message) override {
+        logger_.skipped_test(test, message);
+      }
+    private:
+      void record(const test_name &test, log::test_duration duration) {
+        using namespace std::chrono;
+        history_.record(test.full_name(),
+                        duration_cast<duration_history::duration>(
+                          duration.wall
+                        ));
+      }
+
+      log::test_logger &logger_;
+      duration_history &history_;
+    };
   }
 
   namespace detail {
 
     METTLE_PUBLIC int
-    drive_tests(int argc, const char *argv[], const suites_list &suites) {
+    drive_tests(int argc, const char *argv[],
+                const suites_list &registered_suites) {
       using namespace mettle;
       namespace opts = boost::program_options;
 
@@ -65,13 +257,23 @@ namespace mettle {
       driver.add_options()
         ("no-subproc", opts::value(&args.no_subproc)->zero_tokens(),
          "don't create a subprocess for each test")
+        ("all-thread-safe",
+         opts::value(&args.all_thread_safe)->zero_tokens(),
+         "treat every test as thread-safe when running tests in parallel "
+         "with --no-subproc")
+        ("history", opts::value(&args.history_file)->value_name("FILE"),
+         "record how long each test takes in FILE, and use it to start the "
+         "slowest tests first")
       ;
 
       opts::options_description hidden("Hidden options");
       hidden.add_options()
         ("output-fd", opts::value(&args.output_fd),
          "pipe the results to this file descriptor")
-#ifdef _WIN32
+#ifndef _WIN32
+        ("control-fd", opts::value(&args.control_fd),
+         "wait for commands on this file descriptor before each run")
+#else
         ("test-id", opts::value(&args.test_id), "internal id of a test to run")
         ("log-fd", opts::value(&args.log_fd), "HANDLE to log pipe")
 #endif
@@ -92,6 +294,15 @@ namespace mettle {
         return exit_code::bad_args;
       }
 
+      if(auto value = take_env(log::passing_output_env))
+        args.passing_output = *value != "0";
+      if(auto value = take_env(log::binary::version_env)) {
+        // If we can't make sense of this, just stick with bencode.
+        std::istringstream ss(*value);
+        if(!(ss >> args.protocol_version))
+          args.protocol_version = 0;
+      }
+
       if(args.show_help) {
         opts::options_description displayed;
         displayed.add(generic).add(driver).add(output);
@@ -102,6 +313,27 @@ namespace mettle {
         return exit_code::success;
       }
 
+      // The registered suites belong to our caller, so give a copy of them
+      // new IDs if we're not using the ones they were built with.
+      std::optional<suites_list> renumbered_suites;
+      if(args.test_uids != test_uid_scheme::sequential) {
+#ifdef _WIN32
+        if(!args.no_subproc && !args.list) {
+          report_error(argv[0], "--test-ids requires --no-subproc on Windows");
+          return exit_code::bad_args;
+        }
+#endif
+        try {
+          renumbered_suites = registered_suites;
+          assign_test_uids(*renumbered_suites, args.test_uids);
+        } catch(const std::exception &e) {
+          report_error(argv[0], e.what());
+          return exit_code::bad_args;
+        }
+      }
+      const suites_list &suites = renumbered_suites ? *renumbered_suites
+                                                    : registered_suites;
+
 #ifdef _WIN32
       if(args.test_id || args.log_fd) {
         if(!args.test_id || !args.log_fd) {
@@ -119,19 +351,158 @@ namespace mettle {
       }
 #endif
 
+      if(args.jobs == 0) {
+        report_error(argv[0], "--jobs must be at least 1");
+        return exit_code::bad_args;
+      }
+
+      // Suites whose fixtures are built before forking need a worker process
+      // to build them in, so use the fork server for them.
+      bool use_fork_server = args.fork_server;
+#ifndef _WIN32
+      use_fork_server = use_fork_server || has_shared_fixtures(suites);
+#endif
+
+      subprocess_test_runner::max_output_t max_output;
+      if(args.max_output)
+        max_output = args.max_output->bytes;
+
       test_runner runner;
-      if(args.no_subproc) {
-        if(args.timeout) {
+      std::unique_ptr<concurrent_test_runner> parallel_runner;
+      threaded_test_runner *threaded_runner = nullptr;
+      bool use_watchdog = false;
+      if(args.list) {
+        // We're not running anything, so there's no runner to set up.
+      } else if(args.no_subproc) {
+        if(args.max_output) {
           report_error(
-            argv[0], "--timeout requires running tests in subprocesses"
+            argv[0], "--max-output requires running tests in subprocesses"
           );
           return exit_code::bad_args;
         }
-        runner = inline_test_runner;
+        if(!args.limits.empty()) {
+          report_error(
+            argv[0], "resource limits require running tests in subprocesses"
+          );
+          return exit_code::bad_args;
+        }
+        if(args.fork_server) {
+          report_error(
+            argv[0], "--fork-server requires running tests in subprocesses"
+          );
+          return exit_code::bad_args;
+        }
+        if(args.jobs > 1) {
+          auto threaded = std::make_unique<threaded_test_runner>(
+            args.jobs, args.all_thread_safe, args.timeout
+          );
+          threaded_runner = threaded.get();
+          parallel_runner = std::move(threaded);
+        } else if(args.timeout || has_timeouts(suites)) {
+          // Tests run inline under a watchdog; see `run_inline` below.
+          use_watchdog = true;
+        } else {
+          runner = inline_test_runner;
+        }
+      } else if(args.all_thread_safe) {
+        report_error(argv[0], "--all-thread-safe requires --no-subproc");
+        return exit_code::bad_args;
+      } else if(use_fork_server) {
+#ifndef _WIN32
+        parallel_runner = std::make_unique<forkserver_test_runner>(
+          suites, args.jobs, args.timeout, max_output, args.limits
+        );
+#else
+        report_error(argv[0], "--fork-server is not supported on Windows");
+        return exit_code::bad_args;
+#endif
       } else {
-        runner = subprocess_test_runner(args.timeout);
+#ifndef _WIN32
+        // Use the concurrent runner even for one job, since it can report
+        // each test's CPU time (as measured by `wait4`).
+        parallel_runner = std::make_unique<parallel_subprocess_runner>(
+          args.jobs, args.timeout, max_output, args.limits
+        );
+#else
+        if(args.jobs > 1) {
+          report_error(argv[0], "--jobs is not supported on Windows");
+          return exit_code::bad_args;
+        }
+        if(!args.limits.empty()) {
+          report_error(argv[0], "resource limits are not supported on Windows");
+          return exit_code::bad_args;
+        }
+        runner = subprocess_test_runner(args.timeout, max_output);
+#endif
       }
 
+      std::optional<duration_history> history;
+      test_estimator estimate;
+      if(args.history_file) {
+        try {
+          history.emplace(*args.history_file);
+        } catch(const std::exception &e) {
+          report_error(argv[0], e.what());
+          return exit_code::unknown_error;
+        }
+
+        // Reordering only helps when tests run in parallel. Also, the fork
+        // server prepares shared fixtures as tests arrive in suite order, so
+        // starting tests out of order would only slow it down.
+        if(args.jobs > 1 && !has_shared_fixtures(suites)) {
+          estimate = [&history](const test_name &test) {
+            return history->find(test.full_name());
+          };
+        }
+      }
+
+      // Called when a test run in this process takes too long; this should
+      // flush the logger and exit.
+      watchdog::handler_type on_timeout = exit_timed_out;
+
+      // The tests to run when driven by --control-fd; empty means all of them.
+      std::set<test_uid> only_ids;
+      id_filter filter = {args.filters, only_ids};
+
+      auto run_inline = [&](log::test_logger &logger) {
+        watchdog dog(logger, args.timeout, on_timeout);
+        run_tests(suites, dog, [&dog](const test_info &test,
+                                      log::test_output &) {
+          return dog.run(test);
+        }, filter);
+      };
+
+      auto run = [&](log::test_logger &logger) {
+        if(args.list) {
+          list_tests(suites, logger, args.filters);
+          return;
+        }
+
+        std::optional<history_logger> recorder;
+        if(history)
+          recorder.emplace(logger, *history);
+        log::test_logger &l = recorder ? *recorder : logger;
+
+        if(parallel_runner && estimate)
+          run_tests(suites, l, *parallel_runner, filter, estimate);
+        else if(parallel_runner)
+          run_tests(suites, l, *parallel_runner, filter);
+        else if(use_watchdog)
+          run_inline(l);
+        else
+          run_tests(suites, l, runner, filter);
+
+        // A test on the thread pool timed out and is still running, so we
+        // can't go on (or even clean up after ourselves).
+        if(threaded_runner && threaded_runner->timed_out())
+          on_timeout();
+      };
+
+      auto save_history = [&]() {
+        if(history && !args.list)
+          history->save(*args.history_file);
+      };
+
       if(args.output_fd) {
         if(auto output_opt = has_option(output, vm)) {
           using namespace opts::command_line_style;
@@ -140,15 +511,54 @@ namespace mettle {
           return exit_code::bad_args;
         }
 
+        // Run once, or else once for each command on --control-fd, making
+        // sure the reader gets all of a run's events before we wait for the
+        // next command.
+        auto run_all = [&](auto &logger) {
+#ifndef _WIN32
+          if(args.control_fd) {
+            while(auto ids = read_run_command(*args.control_fd)) {
+              only_ids = std::move(*ids);
+              run(logger);
+              logger.flush();
+            }
+            return;
+          }
+#endif
+          run(logger);
+        };
+
         try {
           make_fd_private(*args.output_fd);
+#ifndef _WIN32
+          if(args.control_fd)
+            make_fd_private(*args.control_fd);
+#endif
           namespace io = boost::iostreams;
           io::stream<io::file_descriptor_sink> fds(
             *args.output_fd, io::never_close_handle
           );
           fds.exceptions(fds.failbit | fds.badbit);
-          log::child logger(fds);
-          run_tests(suites, logger, runner, args.filters);
+          // Use the binary protocol if the reader understands it; otherwise,
+          // fall back to bencode.
+          if(args.protocol_version >= log::binary::version) {
+            log::binary_child logger(fds, args.passing_output,
+                                     output_fd_policy);
+            on_timeout = [&logger]() {
+              logger.flush();
+              exit_timed_out();
+            };
+            run_all(logger);
+          } else {
+            log::child logger(fds, args.passing_output,
+                              output_fd_policy);
+            on_timeout = [&logger]() {
+              logger.flush();
+              exit_timed_out();
+            };
+            run_all(logger);
+          }
+          save_history();
           return exit_code::success;
         } catch(const std::exception &e) {
           report_error(argv[0], e.what());
@@ -156,6 +566,19 @@ namespace mettle {
         }
       }
 
+#ifndef _WIN32
+      if(args.control_fd) {
+        report_error(argv[0], "--control-fd requires --output-fd");
+        return exit_code::bad_args;
+      }
+#endif
+
+      if(args.list) {
+        log::test_list logger(std::cout, args.listing_format);
+        run(logger);
+        return exit_code::success;
+      }
+
       if(args.no_subproc && args.show_terminal) {
         report_error(
           argv[0], "--show-terminal requires running tests in subprocesses"
@@ -174,10 +597,15 @@ namespace mettle {
 
         log::summary logger(
           out, factory.make(args.output, out, args), args.show_time,
-          args.show_terminal
+          args.show_terminal, args.top_usage
         );
+        on_timeout = [&logger]() {
+          logger.summarize();
+          exit_timed_out();
+        };
         for(std::size_t i = 0; i != args.runs; i++)
-          run_tests(suites, logger, runner, args.filters);
+          run(logger);
+        save_history();
 
         logger.summarize();
         return logger.good() ? exit_code::success : exit_code::failure;
@@ -1,5 +1,7 @@
 #include <mettle/driver/filters.hpp>
 
+#include <mettle/detail/hash.hpp>
+
 namespace mettle {
 
   filter_result attr_filter::operator ()(const test_name &,
@@ -67,4 +69,14 @@ namespace mettle {
     return test_action::hide;
   }
 
+  filter_result shard_filter::operator ()(const test_name &name,
+                                          const attributes &) const {
+    if(empty())
+      return test_action::indeterminate;
+
+    auto hash = detail::fnv1a(name.full_name());
+    return hash % count == index - 1 ? test_action::indeterminate :
+      test_action::hide;
+  }
+
 } // namespace mettle
@@ -0,0 +1,21 @@
+#include <mettle/driver/subprocess_test_runner.hpp>
+
+namespace mettle {
+
+  const test_info *
+  find_test(const suites_list &suites, test_uid id) {
+    for(const auto &suite : suites) {
+      for(const auto &test : suite.tests()) {
+        if(test.id == id)
+          return &test;
+      }
+
+      auto found = find_test(suite.subsuites(), id);
+      if(found)
+        return found;
+    }
+
+    return nullptr;
+  }
+
+} // namespace mettle
@@ -0,0 +1,69 @@
+#include <mettle/driver/history.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace mettle {
+
+  duration_history::duration_history(const std::string &file) {
+    std::ifstream in(file);
+    std::string line;
+    while(std::getline(in, line)) {
+      std::istringstream ss(line);
+      duration::rep count;
+      std::string key;
+      if(ss >> count && ss.get() == ' ' && std::getline(ss, key) &&
+         count >= 0 && !key.empty())
+        durations_[std::move(key)] = duration(count);
+    }
+  }
+
+  std::optional<duration_history::duration>
+  duration_history::find(std::string_view key) const {
+    auto i = durations_.find(key);
+    if(i == durations_.end())
+      return std::nullopt;
+    return i->second;
+  }
+
+  void duration_history::record(const std::string &key, duration d) {
+    // Keys are stored one per line, so we can't remember anything with a
+    // newline in its name.
+    if(key.empty() || key.find('\n') != std::string::npos)
+      return;
+
+    auto [i, added] = durations_.try_emplace(key, d);
+    if(!added)
+      i->second = (i->second + d) / 2;
+  }
+
+  void duration_history::save(const std::string &file) const {
+    namespace fs = std::filesystem;
+
+    // Write to a temporary file first, so that a concurrent reader never sees
+    // a partial history.
+    std::random_device rd;
+    fs::path tmp = file + ".tmp-" + std::to_string(rd());
+
+    bool ok;
+    {
+      std::ofstream out(tmp);
+      for(const auto &[key, d] : durations_)
+        out << d.count() << " " << key << "\n";
+      ok = bool(out.flush());
+    }
+
+    std::error_code ec;
+    if(ok)
+      fs::rename(tmp, file, ec);
+    if(!ok || ec) {
+      fs::remove(tmp, ec);
+      throw std::runtime_error("unable to write history file \"" + file +
+                               "\"");
+    }
+  }
+
+} // namespace mettle
@@ -50,4 +50,8 @@ namespace mettle::log {
          << std::flush;
   }
 
+  bool brief::uses_passing_output() const {
+    return false;
+  }
+
 } // namespace mettle::log
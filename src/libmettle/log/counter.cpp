@@ -55,6 +55,10 @@ namespace mettle::log {
     print_counter();
   }
 
+  bool counter::uses_passing_output() const {
+    return false;
+  }
+
   void counter::print_counter() {
     using namespace term;
     format all(sgr::bold);
@@ -1,5 +1,9 @@
 #include <mettle/driver/log/format.hpp>
 
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
 #include <mettle/driver/log/term.hpp>
 
 namespace mettle {
@@ -37,4 +41,43 @@ namespace mettle {
               << link();
   }
 
+  namespace log {
+
+    std::ostream & operator <<(std::ostream &os, const resource_usage &usage) {
+      return os << format_size(usage.max_rss) << " max RSS, "
+                << usage.minor_faults << " minor/" << usage.major_faults
+                << " major page faults, " << usage.voluntary_switches
+                << " voluntary/" << usage.involuntary_switches
+                << " involuntary context switches, " << usage.block_inputs
+                << " blocks in/" << usage.block_outputs << " out";
+    }
+
+    std::string format_milliseconds(std::chrono::nanoseconds time) {
+      using namespace std::chrono;
+      auto us = duration_cast<microseconds>(time).count();
+      auto result = std::to_string(us / 1000);
+      if(auto fraction = us % 1000) {
+        auto digits = std::to_string(1000 + fraction).substr(1);
+        result += "." + digits.substr(0, digits.find_last_not_of('0') + 1);
+      }
+      return result;
+    }
+
+    std::string format_size(std::uint64_t bytes) {
+      const char *units[] = {"KiB", "MiB", "GiB", "TiB"};
+      if(bytes < 1024)
+        return std::to_string(bytes) + " B";
+
+      double value = static_cast<double>(bytes) / 1024;
+      std::size_t unit = 0;
+      for(; value >= 1024 && unit + 1 < std::size(units); unit++)
+        value /= 1024;
+
+      std::ostringstream ss;
+      ss << std::fixed << std::setprecision(1) << value << " " << units[unit];
+      return ss.str();
+    }
+
+  } // namespace log
+
 } // namespace mettle
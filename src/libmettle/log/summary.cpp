@@ -1,5 +1,6 @@
 #include <mettle/driver/log/summary.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -21,9 +22,9 @@ namespace mettle::log {
   }
 
   summary::summary(indenting_ostream &out, std::unique_ptr<file_logger> &&log,
-                   bool show_time, bool show_terminal)
+                   bool show_time, bool show_terminal, std::size_t top_usage)
     : out_(out), log_(std::move(log)), show_time_(show_time),
-      show_terminal_(show_terminal) {}
+      show_terminal_(show_terminal), top_usage_(top_usage) {}
 
   void summary::started_run() {
     if(log_) log_->started_run();
@@ -56,12 +57,16 @@ namespace mettle::log {
   void summary::passed_test(const test_name &test, const test_output &output,
                             test_duration duration) {
     if(log_) log_->passed_test(test, output, duration);
+
+    add_usage(test, duration);
   }
 
   void summary::failed_test(const test_name &test, const test_failure &failure,
                             const test_output &output, test_duration duration) {
     if(log_) log_->failed_test(test, failure, output, duration);
 
+    add_usage(test, duration);
+
     bool term_enabled = term::is_enabled(out_);
 
     add_unpass(test.id, to_term_string(test, term_enabled), fail)
@@ -141,13 +146,22 @@ namespace mettle::log {
 
     out_ << reset() << std::endl;
 
-    scoped_indent indent(out_);
-    for(const auto &i : unpasses_) {
-      if(i.second.type == skip)
-        summarize_skip(i.second.name, i.second.skip_message);
-      else
-        summarize_failure(i.second.name, i.second.failures);
+    {
+      scoped_indent indent(out_);
+      for(const auto &i : unpasses_) {
+        if(i.second.type == skip)
+          summarize_skip(i.second.name, i.second.skip_message);
+        else
+          summarize_failure(i.second.name, i.second.failures);
+      }
     }
+
+    if(top_usage_)
+      summarize_usage();
+  }
+
+  bool summary::uses_passing_output() const {
+    return log_ && log_->uses_passing_output();
   }
 
   bool summary::good() const {
@@ -163,6 +177,21 @@ namespace mettle::log {
     return it->second;
   }
 
+  void summary::add_usage(const test_name &test,
+                          const test_duration &duration) {
+    if(!top_usage_ || duration.usage.empty())
+      return;
+
+    // Keep the run of each test that used the most memory.
+    auto [it, inserted] = usages_.try_emplace(test.id);
+    if(inserted) {
+      it->second.name = to_term_string(test, term::is_enabled(out_));
+    }
+    if(inserted || duration.usage.max_rss >
+                   it->second.duration.usage.max_rss)
+      it->second.duration = duration;
+  }
+
   void summary::summarize_skip(const std::string &test,
                                const std::string &message) const {
     using namespace term;
@@ -209,6 +238,35 @@ namespace mettle::log {
     }
   }
 
+  void summary::summarize_usage() const {
+    std::vector<const usage *> top;
+    for(const auto &i : usages_)
+      top.push_back(&i.second);
+    if(top.empty())
+      return;
+
+    auto n = std::min(top_usage_, top.size());
+    std::partial_sort(top.begin(), top.begin() + n, top.end(),
+                      [](const usage *lhs, const usage *rhs) {
+      return lhs->duration.usage.max_rss > rhs->duration.usage.max_rss;
+    });
+    top.resize(n);
+
+    using namespace term;
+    out_ << std::endl << format(sgr::bold) << "Peak memory use" << reset()
+         << std::endl;
+
+    scoped_indent si(out_);
+    for(const auto *i : top) {
+      const auto &d = i->duration;
+      out_ << i->name << " " << format(sgr::bold, fg(color::yellow))
+           << format_size(d.usage.max_rss) << reset() << " "
+           << format(fg(color::black)) << "(" << d.usage.major_faults
+           << " major page faults, " << format_milliseconds(d.cpu())
+           << " ms CPU)" << reset() << std::endl;
+    }
+  }
+
   void summary::log_output(const test_output &output,
                            bool extra_newline) const {
     if(!show_terminal_ || output.empty())
@@ -0,0 +1,124 @@
+#include <mettle/driver/log/test_list.hpp>
+
+#include <cstdio>
+#include <map>
+
+#include <mettle/detail/algorithm.hpp>
+
+namespace mettle::log {
+
+  namespace {
+
+    const std::map<char, std::string> json_replace = []() {
+      std::map<char, std::string> replace = {
+        {'"', "\\\""},
+        {'\\', "\\\\"},
+        {'\n', "\\n"},
+        {'\r', "\\r"},
+        {'\t', "\\t"}
+      };
+      for(char c = 0; c != 0x20; c++) {
+        char buf[7];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        replace.try_emplace(c, buf);
+      }
+      return replace;
+    }();
+
+    auto json_string(const std::string &s) {
+      return detail::escaped(s, json_replace);
+    }
+
+  }
+
+  test_list::test_list(std::ostream &out, list_format format)
+    : out_(out), format_(format) {}
+
+  void test_list::started_run() {
+    count_ = 0;
+    if(format_ == list_format::json)
+      out_ << "[";
+  }
+
+  void test_list::ended_run() {
+    // Only flush once everything's been listed, since there may be a great
+    // many tests.
+    if(format_ == list_format::json)
+      out_ << (count_ ? "\n]" : "]") << "\n";
+    out_.flush();
+  }
+
+  void test_list::started_suite(const std::vector<suite_name> &) {}
+  void test_list::ended_suite(const std::vector<suite_name> &) {}
+
+  void test_list::started_test(const test_name &) {}
+  void test_list::passed_test(const test_name &, const test_output &,
+                              test_duration) {}
+  void test_list::failed_test(const test_name &, const test_failure &,
+                              const test_output &, test_duration) {}
+  void test_list::skipped_test(const test_name &, const std::string &) {}
+
+  void test_list::listed_test(const test_name &test, const test_attrs &attrs) {
+    if(format_ == list_format::json)
+      print_json(test, attrs);
+    else
+      print_text(test, attrs);
+    count_++;
+  }
+
+  void test_list::started_file(const test_file &file) {
+    file_ = file;
+  }
+
+  void test_list::ended_file(const test_file &) {
+    file_.reset();
+  }
+
+  void test_list::failed_file(const test_file &file,
+                              const std::string &message) {
+    failures_.emplace_back(file, message);
+    file_.reset();
+  }
+
+  void test_list::print_text(const test_name &test, const test_attrs &attrs) {
+    out_ << test.id << "\t" << test.full_name() << "\t" << test.file_name
+         << ":" << test.line;
+    if(!attrs.empty()) {
+      out_ << "\t" << detail::joined(attrs, [](const auto &attr) {
+        std::string result = attr.first;
+        if(!attr.second.empty())
+          result += "=" + detail::stringify(detail::joined(attr.second,
+                                                           std::identity{},
+                                                           ","));
+        return result;
+      }, " ");
+    }
+    out_ << "\n";
+  }
+
+  void test_list::print_json(const test_name &test, const test_attrs &attrs) {
+    auto quoted = [](const std::string &s) {
+      return "\"" + detail::stringify(json_string(s)) + "\"";
+    };
+
+    out_ << (count_ ? ",\n  " : "\n  ") << "{\"id\": " << test.id;
+    if(file_)
+      out_ << ", \"test_file\": " << quoted(file_->name);
+    out_ << ", \"name\": " << quoted(test.name)
+         << ", \"full_name\": " << quoted(test.full_name())
+         << ", \"suites\": ["
+         << detail::joined(test.suites, [&quoted](const auto &suite) {
+              return quoted(suite.name);
+            })
+         << "], \"file_name\": " << quoted(test.file_name)
+         << ", \"line\": " << test.line
+         << ", \"attributes\": {"
+         << detail::joined(attrs, [&quoted](const auto &attr) {
+              return quoted(attr.first) + ": [" + detail::stringify(
+                detail::joined(attr.second, quoted)
+              ) + "]";
+            })
+         << "}}";
+  }
+
+} // namespace mettle::log
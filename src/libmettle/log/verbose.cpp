@@ -67,6 +67,7 @@ namespace mettle::log {
     out_ << std::endl;
 
     scoped_indent si(out_);
+    log_usage(duration.usage);
     log_output(output, false);
   }
 
@@ -79,6 +80,7 @@ namespace mettle::log {
     out_ << std::endl;
 
     scoped_indent si(out_);
+    log_usage(duration.usage);
     out_ << failure << std::endl;
     log_output(output, true);
   }
@@ -120,7 +122,19 @@ namespace mettle::log {
     using namespace term;
     if(show_time_) {
       out_ << " " << format(sgr::bold, fg(color::black)) << "("
-           << duration.count() << " ms)" << reset();
+           << format_milliseconds(duration.wall) << " ms";
+      if(duration.cpu() != test_duration::duration::zero()) {
+        out_ << ", " << format_milliseconds(duration.user) << " ms user, "
+             << format_milliseconds(duration.system) << " ms system";
+      }
+      out_ << ")" << reset();
+    }
+  }
+
+  void verbose::log_usage(const resource_usage &usage) const {
+    using namespace term;
+    if(show_time_ && !usage.empty()) {
+      out_ << format(fg(color::black)) << usage << reset() << std::endl;
     }
   }
 
@@ -9,11 +9,15 @@
 
 namespace mettle::log {
 
-  static inline std::string get_duration(test_duration duration) {
+  static inline std::string get_seconds(test_duration::duration time) {
     using seconds = std::chrono::duration<
       double, std::chrono::seconds::period
     >;
-    return std::to_string(seconds(duration).count());
+    return std::to_string(seconds(time).count());
+  }
+
+  static inline std::string get_duration(test_duration duration) {
+    return get_seconds(duration.wall);
   }
 
   static xml::element_ptr
@@ -31,6 +35,33 @@ namespace mettle::log {
     return e;
   }
 
+  // Add the test's CPU time and resource usage (if we have them) as
+  // properties of the test case.
+  static void append_test_usage(xml::element_ptr &test,
+                                const test_duration &duration) {
+    const auto &u = duration.usage;
+    if(duration.cpu() == test_duration::duration::zero() && u.empty())
+      return;
+
+    auto props = xml::element::make("properties");
+    auto add = [&props](std::string name, std::string value) {
+      auto prop = xml::element::make("property");
+      prop->attr("name", std::move(name));
+      prop->attr("value", std::move(value));
+      props->append_child(std::move(prop));
+    };
+    add("user_time", get_seconds(duration.user));
+    add("system_time", get_seconds(duration.system));
+    add("max_rss", std::to_string(u.max_rss));
+    add("minor_faults", std::to_string(u.minor_faults));
+    add("major_faults", std::to_string(u.major_faults));
+    add("voluntary_switches", std::to_string(u.voluntary_switches));
+    add("involuntary_switches", std::to_string(u.involuntary_switches));
+    add("block_inputs", std::to_string(u.block_inputs));
+    add("block_outputs", std::to_string(u.block_outputs));
+    test->append_child(std::move(props));
+  }
+
   static void append_test_output(xml::element_ptr &test,
                                  const test_output &output) {
     if(!output.stdout_log.empty()) {
@@ -64,6 +95,7 @@ namespace mettle::log {
     doc_.root()->attr("time", get_duration(duration_));
 
     doc_.write(*out_);
+    out_->flush();
   }
 
   void xunit::started_suite(const std::vector<suite_name> &suites) {
@@ -93,6 +125,7 @@ namespace mettle::log {
     auto &suite = current_suite();
     auto t = test_element(test);
     t->attr("time", get_duration(duration));
+    append_test_usage(t, duration);
     append_test_output(t, output);
     suite.elt->append_child(std::move(t));
     tests_++;
@@ -108,6 +141,7 @@ namespace mettle::log {
     auto &suite = current_suite();
     auto t = test_element(test);
     t->attr("time", get_duration(duration));
+    append_test_usage(t, duration);
     t->append_child(message_element("failure", ss.str()));
     append_test_output(t, output);
     suite.elt->append_child(std::move(t));
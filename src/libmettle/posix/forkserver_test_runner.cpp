@@ -0,0 +1,723 @@
+#include <mettle/driver/subprocess_test_runner.hpp>
+
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <bencode.hpp>
+
+// Ignore warnings about deprecated implicit copy constructor.
+#if defined(__clang__)
+#  pragma clang diagnostic push
+#  pragma clang diagnostic ignored "-Wdeprecated"
+#endif
+
+#include <boost/iostreams/device/file_descriptor.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#if defined(__clang__)
+#  pragma clang diagnostic pop
+#endif
+
+#include <mettle/detail/source_location.hpp>
+#include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/posix/io_multiplexer.hpp>
+#include <mettle/driver/posix/rlimit.hpp>
+#include <mettle/driver/posix/rusage.hpp>
+#include <mettle/driver/posix/scoped_pipe.hpp>
+#include <mettle/driver/posix/scoped_signal.hpp>
+#include <mettle/driver/posix/subprocess.hpp>
+#include <mettle/driver/posix/test_child.hpp>
+
+#include "../../err_string.hpp"
+
+#ifdef METTLE_NO_SOURCE_LOCATION
+#  define PARENT_FAILED() parent_failed(                                      \
+     ::mettle::detail::source_location::current(__FILE__, __func__, __LINE__) \
+   )
+#else
+#  define PARENT_FAILED() parent_failed()
+#endif
+
+namespace mettle {
+
+  using namespace posix;
+
+  namespace {
+    using timeout_t = forkserver_test_runner::timeout_t;
+    using max_output_t = forkserver_test_runner::max_output_t;
+    using test_index = forkserver_test_runner::test_index;
+
+    // The workers, so that we can pass along SIGINT/SIGQUIT to them.
+    std::vector<pid_t> worker_pids;
+    struct sigaction old_sigint, old_sigquit;
+
+    void sig_handler(int signum) {
+      for(pid_t pid : worker_pids)
+        kill(pid, signum);
+
+      // Restore the previous signal action and re-raise the signal.
+      struct sigaction *old_act = signum == SIGINT ? &old_sigint : &old_sigquit;
+      sigaction(signum, old_act, nullptr);
+      raise(signum);
+    }
+
+    // The process group of the test a worker is currently running.
+    volatile sig_atomic_t test_pgid = 0;
+
+    void worker_sig_handler(int signum) {
+      if(test_pgid)
+        killpg(test_pgid, SIGKILL);
+
+      signal(signum, SIG_DFL);
+      raise(signum);
+    }
+
+    void sig_chld(int) {}
+
+    test_result parent_failed(detail::source_location loc =
+                                detail::source_location::current()) {
+      return {{ .message = "Fatal error: " + err_string(errno),
+                .file_name = loc.file_name(), .line = loc.line() }};
+    }
+
+    [[noreturn]] inline void child_failed() {
+      _exit(exit_code::fatal);
+    }
+
+    int send_test_id(int fd, test_uid id) {
+      ssize_t size;
+      do {
+        size = send(fd, &id, sizeof(id), MSG_NOSIGNAL);
+      } while(size < 0 && errno == EINTR);
+
+      if(size < 0)
+        return size;
+      if(size == sizeof(id))
+        return 0;
+      errno = EIO;
+      return -1;
+    }
+
+    // Returns 1 if we got a test ID, 0 on EOF, and -1 on error.
+    int recv_test_id(int fd, test_uid *id) {
+      ssize_t size;
+      do {
+        size = read(fd, id, sizeof(*id));
+      } while(size < 0 && errno == EINTR);
+
+      if(size <= 0)
+        return size;
+      if(size == sizeof(*id))
+        return 1;
+      errno = EIO;
+      return -1;
+    }
+
+    // The CPU times and resource usage of a test, as sent by the worker.
+    bencode::list_view wrap_usage(const log::test_duration &duration) {
+      const auto &u = duration.usage;
+      bencode::list_view result;
+      for(std::uint64_t i : {
+        static_cast<std::uint64_t>(duration.user.count()),
+        static_cast<std::uint64_t>(duration.system.count()),
+        u.max_rss, u.minor_faults, u.major_faults, u.voluntary_switches,
+        u.involuntary_switches, u.block_inputs, u.block_outputs
+      }) {
+        result.push_back(static_cast<bencode::integer>(i));
+      }
+      return result;
+    }
+
+    void unwrap_usage(const bencode::list &list,
+                      log::test_duration &duration) {
+      auto at = [&list](std::size_t i) {
+        return static_cast<std::uint64_t>(std::get<bencode::integer>(
+          list.at(i)
+        ));
+      };
+      auto &u = duration.usage;
+      duration.user = std::chrono::nanoseconds(at(0));
+      duration.system = std::chrono::nanoseconds(at(1));
+      u.max_rss = at(2);
+      u.minor_faults = at(3);
+      u.major_faults = at(4);
+      u.voluntary_switches = at(5);
+      u.involuntary_switches = at(6);
+      u.block_inputs = at(7);
+      u.block_outputs = at(8);
+    }
+
+    int send_result(int fd, const test_result &result,
+                    const log::test_output &output,
+                    const log::test_duration &duration) {
+      try {
+        namespace io = boost::iostreams;
+        io::stream<io::file_descriptor_sink> stream(
+          fd, io::never_close_handle
+        );
+        stream.exceptions(stream.failbit | stream.badbit);
+
+        bencode::dict_view data = {
+          {"event", result ? "failed_test" : "passed_test"},
+          {"output", bencode::dict_view{
+            {"stdout_log", output.stdout_log},
+            {"stderr_log", output.stderr_log},
+            {"stdout_dropped", bencode::integer(output.stdout_dropped)},
+            {"stderr_dropped", bencode::integer(output.stderr_dropped)}
+          }},
+          {"usage", wrap_usage(duration)}
+        };
+        if(result)
+          data.emplace("failure", result->to_bencode<bencode::data_view>());
+        bencode::encode(stream, data);
+        stream.flush();
+        return 0;
+      } catch(...) {
+        return -1;
+      }
+    }
+
+    int recv_result(int fd, test_result &result, log::test_output &output,
+                    log::test_duration &duration) {
+      try {
+        namespace io = boost::iostreams;
+        io::stream<io::file_descriptor_source> stream(
+          fd, io::never_close_handle
+        );
+        stream.exceptions(stream.failbit | stream.badbit);
+
+        auto tmp = bencode::decode(stream, bencode::no_check_eof);
+        auto &data = std::get<bencode::dict>(tmp);
+        auto &&event = std::get<bencode::string>(data.at("event"));
+
+        auto &out = std::get<bencode::dict>(data.at("output"));
+        output.stdout_log = std::move(
+          std::get<bencode::string>(out.at("stdout_log"))
+        );
+        output.stderr_log = std::move(
+          std::get<bencode::string>(out.at("stderr_log"))
+        );
+        output.stdout_dropped = static_cast<std::size_t>(
+          std::get<bencode::integer>(out.at("stdout_dropped"))
+        );
+        output.stderr_dropped = static_cast<std::size_t>(
+          std::get<bencode::integer>(out.at("stderr_dropped"))
+        );
+        unwrap_usage(std::get<bencode::list>(data.at("usage")), duration);
+        if(event == "failed_test")
+          result = test_failure::from_bencode(std::move(data.at("failure")));
+        return 0;
+      } catch(...) {
+        return -1;
+      }
+    }
+
+    // Run a single test in a fork of the worker, enforcing the timeout (if
+    // any) from here rather than by spawning any more processes. The test's
+    // resource usage is stored in `usage`.
+    test_result run_forked(const test_info &test, timeout_t timeout,
+                           const resource_limits &limits, int control_fd,
+                           output_capture &stdout_capture,
+                           output_capture &stderr_capture, rusage &usage) {
+      using namespace std::chrono;
+
+      scoped_pipe stdout_pipe, stderr_pipe, log_pipe;
+      if(stdout_pipe.open() < 0 ||
+         stderr_pipe.open() < 0 ||
+         log_pipe.open() < 0)
+        return PARENT_FAILED();
+
+      fflush(nullptr);
+
+      pid_t pid;
+      if((pid = fork()) < 0)
+        return PARENT_FAILED();
+
+      if(pid == 0) {
+        sigset_t empty;
+        sigemptyset(&empty);
+        if(signal(SIGINT, SIG_DFL) == SIG_ERR ||
+           signal(SIGQUIT, SIG_DFL) == SIG_ERR ||
+           signal(SIGTERM, SIG_DFL) == SIG_ERR ||
+           signal(SIGCHLD, SIG_DFL) == SIG_ERR ||
+           sigprocmask(SIG_SETMASK, &empty, nullptr) < 0)
+          child_failed();
+
+        if(close(control_fd) < 0 ||
+           stdout_pipe.close_read() < 0 ||
+           stderr_pipe.close_read() < 0 ||
+           log_pipe.close_read() < 0)
+          child_failed();
+
+        if(enter_test_process(stdout_pipe, stderr_pipe) < 0)
+          child_failed();
+
+        run_test_in_child(test, limits, log_pipe.write_fd);
+      }
+
+      // Set the test's process group from here too so that there's no window
+      // where we'd be unable to kill it as a group. This can only fail if the
+      // test has already exited, which is fine.
+      setpgid(pid, pid);
+      test_pgid = pid;
+
+      auto fail = [pid, &usage]() {
+        auto result = PARENT_FAILED();
+        killpg(pid, SIGKILL);
+        wait4(pid, nullptr, 0, &usage);
+        test_pgid = 0;
+        return result;
+      };
+
+      if(stdout_pipe.close_write() < 0 ||
+         stderr_pipe.close_write() < 0 ||
+         log_pipe.close_write() < 0)
+        return fail();
+
+      std::string message;
+      io_multiplexer io;
+      auto capture = [](output_capture &c) {
+        return [&c](const char *data, std::size_t size) {
+          c.append(data, size);
+        };
+      };
+      if(io.add(stdout_pipe.read_fd, capture(stdout_capture)) < 0 ||
+         io.add(stderr_pipe.read_fd, capture(stderr_capture)) < 0 ||
+         io.add(log_pipe.read_fd, &message) < 0)
+        return fail();
+
+      std::optional<steady_clock::time_point> deadline;
+      if(timeout)
+        deadline = steady_clock::now() + *timeout;
+
+      sigset_t empty;
+      sigemptyset(&empty);
+
+      int status;
+      while(true) {
+        pid_t exited = wait4(pid, &status, WNOHANG, &usage);
+        if(exited < 0)
+          return fail();
+        if(exited == pid)
+          break;
+
+        timespec wait_time, *wait_ptr = nullptr;
+        if(deadline) {
+          auto left = *deadline - steady_clock::now();
+          if(left <= steady_clock::duration::zero()) {
+            killpg(pid, SIGKILL);
+            wait4(pid, nullptr, 0, &usage);
+            test_pgid = 0;
+
+            std::ostringstream ss;
+            ss << "Timed out after " << timeout->count() << " ms";
+            return {{ .message = ss.str() }};
+          }
+          wait_time = to_timespec(left);
+          wait_ptr = &wait_time;
+        }
+
+        // Read from the test's pipes until it exits (or we time out). If all
+        // the pipes have been closed, this just waits for SIGCHLD.
+        if(io.wait(wait_ptr, &empty) < 0 && errno != EINTR)
+          return fail();
+      }
+
+      // Do one last non-blocking read to get any data we might have missed,
+      // then make sure everything in the test's process group is dead.
+      bool read_failed = io.drain(stdout_pipe.read_fd) < 0 ||
+                         io.drain(stderr_pipe.read_fd) < 0 ||
+                         io.drain(log_pipe.read_fd) < 0;
+      auto read_result = read_failed ? PARENT_FAILED() : std::nullopt;
+      killpg(pid, SIGKILL);
+      test_pgid = 0;
+      if(read_result)
+        return read_result;
+
+      if(WIFEXITED(status)) {
+        if(WEXITSTATUS(status) == exit_code::success)
+          return std::nullopt;
+
+        try {
+          return test_failure::from_bencode(bencode::decode(message));
+        } catch(const std::exception &e) {
+          return {{ .message = e.what() }};
+        }
+      } else { // WIFSIGNALED
+        if(auto message = exceeded_limit(limits, status, usage))
+          return {{ .message = std::move(*message) }};
+        return {{ .message = strsignal(WTERMSIG(status)) }};
+      }
+    }
+
+    // Index every test by its ID, along with the shared fixtures of each suite
+    // enclosing it, so that workers can look tests up quickly.
+    void index_tests(const suites_list &suites,
+                     std::vector<detail::shared_fixture_base *> &fixtures,
+                     test_index &index) {
+      for(const auto &suite : suites) {
+        auto shared = suite.shared_fixture();
+        if(shared)
+          fixtures.push_back(shared);
+
+        for(const auto &test : suite.tests())
+          index.emplace(test.id, forkserver_test_runner::indexed_test{
+            &test, fixtures
+          });
+        index_tests(suite.subsuites(), fixtures, index);
+
+        if(shared)
+          fixtures.pop_back();
+      }
+    }
+
+    // Arm (or with no timeout, disarm) a timer that kills the worker with
+    // SIGALRM once `timeout` has passed.
+    int set_alarm(timeout_t timeout) {
+      itimerval timer = {};
+      if(timeout) {
+        auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::max(*timeout, timeout_t::value_type(1))
+        ).count();
+        timer.it_value.tv_sec = usecs / 1000000;
+        timer.it_value.tv_usec = usecs % 1000000;
+      }
+      return setitimer(ITIMER_REAL, &timer, nullptr);
+    }
+
+    // Build any shared fixtures the next test needs here in the worker, so
+    // that the test (forked from the worker) inherits them. Tests arrive in
+    // suite order, so we can free the ones we're done with. If building a
+    // fixture fails, just leave it unprepared; the test will then try to build
+    // it on its own and report the error.
+    //
+    // Building the fixtures gets the same timeout as the test. There's no way
+    // to stop a fixture partway through, so if it takes too long, SIGALRM
+    // kills the whole worker, and the parent reports the test as timed out.
+    int prepare_fixtures(std::vector<detail::shared_fixture_base *> &prepared,
+                         const std::vector<detail::shared_fixture_base *> &
+                         fixtures, timeout_t timeout) {
+      for(auto *i : prepared) {
+        if(std::find(fixtures.begin(), fixtures.end(), i) == fixtures.end())
+          i->reset();
+      }
+
+      bool armed = false;
+      for(auto *i : fixtures) {
+        if(std::find(prepared.begin(), prepared.end(), i) == prepared.end()) {
+          if(!armed && timeout) {
+            if(set_alarm(timeout) < 0)
+              return -1;
+            armed = true;
+          }
+          try {
+            i->prepare();
+          } catch(...) {}
+        }
+      }
+      prepared = fixtures;
+      return armed ? set_alarm(std::nullopt) : 0;
+    }
+
+    [[noreturn]] void
+    run_worker(const test_index &tests, timeout_t timeout,
+               max_output_t max_output, const resource_limits &limits,
+               int fd) {
+      struct sigaction act = {};
+      sigemptyset(&act.sa_mask);
+      act.sa_handler = worker_sig_handler;
+      if(sigaction(SIGINT, &act, nullptr) < 0 ||
+         sigaction(SIGQUIT, &act, nullptr) < 0 ||
+         sigaction(SIGTERM, &act, nullptr) < 0)
+        child_failed();
+
+      act.sa_handler = sig_chld;
+      if(sigaction(SIGCHLD, &act, nullptr) < 0)
+        child_failed();
+
+      // Make sure SIGALRM kills us when preparing fixtures times out.
+      if(signal(SIGALRM, SIG_DFL) == SIG_ERR)
+        child_failed();
+
+      // Keep SIGCHLD blocked except while we're waiting for a test, so that we
+      // can't miss it exiting.
+      sigset_t chld;
+      sigemptyset(&chld);
+      sigaddset(&chld, SIGCHLD);
+      if(sigprocmask(SIG_SETMASK, &chld, nullptr) < 0)
+        child_failed();
+
+      std::vector<detail::shared_fixture_base *> prepared;
+      test_uid id;
+      int rv;
+      while((rv = recv_test_id(fd, &id)) > 0) {
+        output_capture stdout_capture(max_output), stderr_capture(max_output);
+        test_result result;
+        rusage usage = {};
+        if(auto found = tests.find(id); found != tests.end()) {
+          const auto &test = *found->second.test;
+          try {
+            auto this_timeout = test_timeout(timeout, test.attrs);
+            if(prepare_fixtures(prepared, found->second.fixtures,
+                                this_timeout) < 0)
+              child_failed();
+            result = run_forked(
+              test, this_timeout, test_limits(limits, test.attrs), fd,
+              stdout_capture, stderr_capture, usage
+            );
+          } catch(const std::exception &e) {
+            result = {{ .message = e.what() }};
+          }
+        } else {
+          result = {{ .message = "Unable to find test" }};
+        }
+
+        log::test_output output = {
+          stdout_capture.str(), stderr_capture.str(),
+          stdout_capture.dropped(), stderr_capture.dropped()
+        };
+
+        log::test_duration duration;
+        add_rusage(duration, usage);
+        if(send_result(fd, result, output, duration) < 0)
+          child_failed();
+      }
+
+      if(rv < 0)
+        child_failed();
+      _exit(exit_code::success);
+    }
+  }
+
+  struct forkserver_test_runner::worker {
+    worker() = default;
+    worker(const worker &) = delete;
+
+    ~worker() {
+      if(fd != -1)
+        close(fd);
+
+      // Closing the control socket tells an idle worker to exit; a busy one
+      // needs to be told to kill its test first.
+      if(pid && !reaped) {
+        if(done)
+          kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+      }
+    }
+
+    pid_t pid = 0;
+    bool reaped = false;
+    int fd = -1;
+    callback_type done;
+    std::chrono::steady_clock::time_point start_time;
+  };
+
+  forkserver_test_runner::forkserver_test_runner(
+    const suites_list &suites, std::size_t jobs, timeout_t timeout,
+    max_output_t max_output, resource_limits limits
+  ) : jobs_(std::max<std::size_t>(jobs, 1)), timeout_(timeout),
+      max_output_(max_output), limits_(limits) {
+    std::vector<detail::shared_fixture_base *> fixtures;
+    index_tests(suites, fixtures, tests_);
+  }
+
+  forkserver_test_runner::~forkserver_test_runner() {
+    while(!workers_.empty())
+      remove_worker(*workers_.back());
+  }
+
+  test_result forkserver_test_runner::operator ()(
+    const test_info &test, log::test_output &output
+  ) {
+    test_result result;
+    start(test, [&result, &output](
+      const test_result &r, const log::test_output &o, log::test_duration
+    ) {
+      result = r;
+      output = o;
+    });
+    wait();
+    return result;
+  }
+
+  void forkserver_test_runner::start(const test_info &test,
+                                     callback_type done) {
+    // If an idle worker has died, we'll only find out when we try to send it
+    // a test; in that case, replace it and try once more.
+    for(int attempt = 0; ; attempt++) {
+      worker *w = nullptr;
+      while(!w) {
+        auto idle = std::find_if(
+          workers_.begin(), workers_.end(),
+          [](const auto &i) { return !i->done; }
+        );
+        if(idle != workers_.end()) {
+          w = idle->get();
+        } else if(workers_.size() < jobs_) {
+          if(spawn_worker() < 0) {
+            auto err = PARENT_FAILED();
+            if(workers_.empty()) {
+              sigint_.close();
+              sigquit_.close();
+            }
+            return done(err, {}, {});
+          }
+          w = workers_.back().get();
+        } else {
+          wait_any();
+        }
+      }
+
+      w->start_time = std::chrono::steady_clock::now();
+      if(send_test_id(w->fd, test.id) == 0) {
+        w->done = std::move(done);
+        return;
+      }
+
+      auto err = PARENT_FAILED();
+      remove_worker(*w);
+      if(attempt)
+        return done(err, {}, {});
+    }
+  }
+
+  void forkserver_test_runner::wait() {
+    while(std::any_of(workers_.begin(), workers_.end(),
+                      [](const auto &i) { return bool(i->done); }))
+      wait_any();
+  }
+
+  void forkserver_test_runner::wait_any() {
+    std::vector<worker *> busy;
+    std::vector<pollfd> fds;
+    for(auto &w : workers_) {
+      if(w->done) {
+        busy.push_back(w.get());
+        fds.push_back({w->fd, POLLIN, 0});
+      }
+    }
+    assert(!busy.empty());
+
+    int rv;
+    do {
+      rv = poll(fds.data(), fds.size(), -1);
+    } while(rv < 0 && errno == EINTR);
+
+    if(rv < 0) {
+      auto err = PARENT_FAILED();
+      for(auto *w : busy) {
+        finish(*w, err, {});
+        remove_worker(*w);
+      }
+      return;
+    }
+
+    for(std::size_t i = 0; i != busy.size(); i++) {
+      if(!fds[i].revents)
+        continue;
+
+      auto &w = *busy[i];
+      test_result result;
+      log::test_output output;
+      log::test_duration duration;
+      if(recv_result(w.fd, result, output, duration) == 0) {
+        finish(w, result, output, duration);
+        continue;
+      }
+
+      // The worker died, so report the test as failed and replace the worker
+      // the next time we need one.
+      std::string message = "Test worker exited unexpectedly";
+      int status;
+      if(waitpid(w.pid, &status, 0) == w.pid) {
+        w.reaped = true;
+        if(WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+          message = "Timed out while preparing shared fixtures";
+        else if(WIFSIGNALED(status))
+          message = std::string("Test worker killed: ") +
+                    strsignal(WTERMSIG(status));
+      }
+      finish(w, {{ .message = message }}, output);
+      remove_worker(w);
+    }
+  }
+
+  void forkserver_test_runner::finish(worker &w, const test_result &result,
+                                      const log::test_output &output,
+                                      log::test_duration duration) {
+    duration.wall = std::chrono::steady_clock::now() - w.start_time;
+
+    auto done = std::move(w.done);
+    w.done = nullptr;
+    done(result, output, duration);
+  }
+
+  int forkserver_test_runner::spawn_worker() {
+    if(workers_.empty()) {
+      if(sigaction(SIGINT, nullptr, &old_sigint) < 0 ||
+         sigaction(SIGQUIT, nullptr, &old_sigquit) < 0)
+        return -1;
+
+      if(sigint_.open(SIGINT, sig_handler) < 0 ||
+         sigquit_.open(SIGQUIT, sig_handler) < 0)
+        return -1;
+    }
+
+    auto w = std::make_unique<worker>();
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+      return -1;
+    w->fd = fds[0];
+
+    fflush(nullptr);
+
+    // Don't let SIGINT/SIGQUIT look at the list of workers while we're
+    // changing it.
+    scoped_sigprocmask mask;
+    if(mask.push(SIG_BLOCK, {SIGINT, SIGQUIT}) < 0 ||
+       (w->pid = fork()) < 0) {
+      int err = errno;
+      w->pid = 0;
+      close(fds[1]);
+      errno = err;
+      return -1;
+    }
+
+    if(w->pid == 0) {
+      // Don't hold onto the sockets for any other workers.
+      close(fds[0]);
+      for(auto &other : workers_)
+        close(other->fd);
+
+      run_worker(tests_, timeout_, max_output_, limits_, fds[1]);
+    }
+
+    close(fds[1]);
+    worker_pids.push_back(w->pid);
+    workers_.push_back(std::move(w));
+    return mask.pop();
+  }
+
+  void forkserver_test_runner::remove_worker(worker &w) {
+    {
+      scoped_sigprocmask mask;
+      mask.push(SIG_BLOCK, {SIGINT, SIGQUIT});
+      std::erase(worker_pids, w.pid);
+    }
+
+    std::erase_if(workers_, [&w](const auto &i) { return i.get() == &w; });
+    if(workers_.empty()) {
+      sigint_.close();
+      sigquit_.close();
+    }
+  }
+
+} // namespace mettle
@@ -0,0 +1,184 @@
+#include <mettle/driver/posix/io_multiplexer.hpp>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+
+#ifdef __linux__
+#  include <sys/epoll.h>
+#else
+#  include <sys/select.h>
+#endif
+
+namespace mettle::posix {
+
+  namespace {
+    // Tests can be chatty, so read in large chunks to keep the number of
+    // syscalls down.
+    constexpr std::size_t buffer_size = 64 * 1024;
+
+#ifdef __linux__
+    constexpr int max_events = 64;
+
+    int timeout_to_ms(const timespec *timeout) {
+      if(!timeout)
+        return -1;
+
+      // Round up so that we don't wake up just before the deadline.
+      long long ms = static_cast<long long>(timeout->tv_sec) * 1000 +
+                     (timeout->tv_nsec + 999999) / 1000000;
+      return static_cast<int>(std::min<long long>(ms, INT_MAX));
+    }
+#endif
+  }
+
+  io_multiplexer::io_multiplexer() : buffer_(buffer_size) {}
+
+  io_multiplexer::~io_multiplexer() {
+    close();
+  }
+
+  int io_multiplexer::add(int fd, sink_type sink) {
+    return add_entry({fd, std::move(sink), nullptr});
+  }
+
+  int io_multiplexer::watch(int fd, event_type on_ready) {
+    return add_entry({fd, nullptr, std::move(on_ready)});
+  }
+
+  int io_multiplexer::add_entry(entry e) {
+    int fd = e.fd;
+    if(fds_.contains(fd)) {
+      errno = EEXIST;
+      return -1;
+    }
+
+#ifdef __linux__
+    if(epoll_fd_ < 0 && (epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) < 0)
+      return -1;
+
+    auto &added = fds_[fd];
+    added = std::move(e);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = &added;
+    if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+      int err = errno;
+      fds_.erase(fd);
+      errno = err;
+      return -1;
+    }
+#else
+    if(fd >= FD_SETSIZE) {
+      errno = EINVAL;
+      return -1;
+    }
+    fds_[fd] = std::move(e);
+#endif
+    return 0;
+  }
+
+  int io_multiplexer::remove(int fd) {
+    if(fds_.erase(fd) == 0)
+      return 0;
+#ifdef __linux__
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#else
+    return 0;
+#endif
+  }
+
+  int io_multiplexer::close() {
+    fds_.clear();
+    if(epoll_fd_ < 0)
+      return 0;
+
+    int rv = ::close(epoll_fd_);
+    epoll_fd_ = -1;
+    return rv;
+  }
+
+  int io_multiplexer::wait(const timespec *timeout, const sigset_t *sigmask) {
+#ifdef __linux__
+    if(epoll_fd_ < 0 && (epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) < 0)
+      return -1;
+
+    epoll_event events[max_events];
+    int rv = epoll_pwait(epoll_fd_, events, max_events,
+                         timeout_to_ms(timeout), sigmask);
+    if(rv <= 0)
+      return rv;
+
+    // Reading one entry may remove it from `fds_`, but that doesn't
+    // invalidate the others.
+    for(int i = 0; i != rv; i++) {
+      if(read_ready(*static_cast<entry*>(events[i].data.ptr)) < 0)
+        return -1;
+    }
+    return rv;
+#else
+    int maxfd = -1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    for(const auto &i : fds_) {
+      maxfd = std::max(maxfd, i.first);
+      FD_SET(i.first, &fds);
+    }
+
+    int rv = pselect(maxfd + 1, &fds, nullptr, nullptr, timeout, sigmask);
+    if(rv <= 0)
+      return rv;
+
+    std::vector<entry*> ready;
+    for(auto &i : fds_) {
+      if(FD_ISSET(i.first, &fds))
+        ready.push_back(&i.second);
+    }
+    for(auto *e : ready) {
+      if(read_ready(*e) < 0)
+        return -1;
+    }
+    return rv;
+#endif
+  }
+
+  int io_multiplexer::drain(int fd) {
+    auto i = fds_.find(fd);
+    while(i != fds_.end()) {
+      pollfd p = {fd, POLLIN, 0};
+      int rv = poll(&p, 1, 0);
+      if(rv <= 0)
+        return rv;
+
+      if(read_ready(i->second) < 0)
+        return -1;
+      i = fds_.find(fd);
+    }
+    return 0;
+  }
+
+  int io_multiplexer::read_ready(entry &e) {
+    if(e.on_ready) {
+      // Removing the entry destroys it, so hold onto the callback first.
+      auto on_ready = std::move(e.on_ready);
+      if(remove(e.fd) < 0)
+        return -1;
+      on_ready();
+      return 0;
+    }
+
+    ssize_t size = read(e.fd, buffer_.data(), buffer_.size());
+    if(size < 0)
+      return -1;
+    if(size == 0)
+      return remove(e.fd);
+
+    e.sink(buffer_.data(), size);
+    return 0;
+  }
+
+} // namespace mettle::posix
@@ -0,0 +1,36 @@
+#include <mettle/driver/posix/pidfd.hpp>
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
+namespace mettle::posix {
+
+  int open_pidfd(pid_t pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    // Older C libraries don't wrap this, so make the syscall ourselves.
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+
+  bool has_pidfd() {
+    // Kernels before 5.3 (or sandboxes that filter the syscall) reject this,
+    // so try it once on ourselves.
+    static const bool supported = []() {
+      int fd = open_pidfd(getpid());
+      if(fd < 0)
+        return false;
+      close(fd);
+      return true;
+    }();
+    return supported;
+  }
+
+} // namespace mettle::posix
@@ -0,0 +1,102 @@
+#include <mettle/driver/posix/rlimit.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+#include <mettle/driver/log/format.hpp>
+#include <mettle/driver/posix/rusage.hpp>
+
+namespace mettle::posix {
+
+  namespace {
+    // Set if allocating memory has failed since we applied a memory limit.
+    bool out_of_memory = false;
+
+    void new_handler() {
+      out_of_memory = true;
+      throw std::bad_alloc();
+    }
+
+    int set_limit(int resource, rlim_t soft, rlim_t hard) {
+      rlimit old;
+      if(getrlimit(resource, &old) < 0)
+        return -1;
+
+      // We can't raise the hard limit, so just tighten whatever's there.
+      rlimit lim = {std::min(soft, old.rlim_max), std::min(hard, old.rlim_max)};
+      return setrlimit(resource, &lim);
+    }
+
+    bool out_of_files() {
+      int fd = fcntl(STDOUT_FILENO, F_DUPFD, 0);
+      if(fd < 0)
+        return errno == EMFILE;
+      close(fd);
+      return false;
+    }
+  }
+
+  int set_limits(const resource_limits &limits) {
+    if(limits.memory) {
+      auto memory = static_cast<rlim_t>(limits.memory);
+      if(set_limit(RLIMIT_AS, memory, memory) < 0)
+        return -1;
+      std::set_new_handler(new_handler);
+    }
+    if(limits.cpu_time.count()) {
+      // The soft limit sends SIGXCPU; give the test one more second before
+      // the hard limit kills it outright.
+      auto cpu_time = static_cast<rlim_t>(limits.cpu_time.count());
+      if(set_limit(RLIMIT_CPU, cpu_time, cpu_time + 1) < 0)
+        return -1;
+    }
+    if(limits.open_files) {
+      auto open_files = static_cast<rlim_t>(limits.open_files);
+      if(set_limit(RLIMIT_NOFILE, open_files, open_files) < 0)
+        return -1;
+    }
+    return 0;
+  }
+
+  void check_limits(const resource_limits &limits, test_result &result) {
+    if(!result)
+      return;
+
+    std::string reason;
+    if(limits.memory && out_of_memory) {
+      reason = "Exceeded memory limit of " + log::format_size(limits.memory);
+    } else if(limits.open_files && out_of_files()) {
+      reason = "Exceeded open files limit of " +
+               std::to_string(limits.open_files);
+    } else {
+      return;
+    }
+
+    if(result->message.empty())
+      result->message = std::move(reason);
+    else
+      result->message = reason + "\n" + result->message;
+  }
+
+  std::optional<std::string>
+  exceeded_limit(const resource_limits &limits, int status,
+                 const rusage &usage) {
+    if(!limits.cpu_time.count() || !WIFSIGNALED(status))
+      return std::nullopt;
+
+    int signum = WTERMSIG(status);
+    auto cpu = to_duration(usage.ru_utime) + to_duration(usage.ru_stime);
+    if(signum == SIGXCPU || (signum == SIGKILL && cpu >= limits.cpu_time)) {
+      return "Exceeded CPU time limit of " +
+             std::to_string(limits.cpu_time.count()) + " s";
+    }
+    return std::nullopt;
+  }
+
+} // namespace mettle::posix
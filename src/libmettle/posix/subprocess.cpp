@@ -6,7 +6,6 @@
 
 #include <pthread.h>
 #include <signal.h>
-#include <sys/select.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -62,39 +61,38 @@ namespace mettle::posix {
     }
   }
 
-  int read_into(std::vector<readfd> &dests, const timespec *timeout,
-                const sigset_t *sigmask) {
-    while(true) {
-      int maxfd = -1;
-      fd_set fds;
-      FD_ZERO(&fds);
-      for(const auto &i : dests) {
-        if(i.fd >= 0) {
-          maxfd = std::max(maxfd, i.fd);
-          FD_SET(i.fd, &fds);
-        }
-      }
-      if(maxfd < 0)
-        return 0;
+  timespec to_timespec(std::chrono::nanoseconds duration) {
+    using namespace std::chrono;
+    auto secs = duration_cast<seconds>(duration);
+    return {static_cast<time_t>(secs.count()),
+            static_cast<long>((duration - secs).count())};
+  }
 
-      int rv = pselect(maxfd + 1, &fds, nullptr, nullptr, timeout, sigmask);
-      if(rv <= 0)
-        return rv;
-
-      for(auto &i : dests) {
-        if(i.fd >= 0 && FD_ISSET(i.fd, &fds)) {
-          ssize_t size;
-          char buf[BUFSIZ];
-
-          if((size = read(i.fd, buf, sizeof(buf))) < 0)
-            return size;
-          if(size == 0)
-            i.fd = -i.fd;
-          else
-            i.dest->append(buf, size);
-        }
+  int read_into(io_multiplexer &io, std::vector<readfd> &dests,
+                const timespec *timeout, const sigset_t *sigmask) {
+    int rv = 0;
+    for(const auto &i : dests) {
+      if(i.fd >= 0 && io.add(i.fd, i.dest) < 0) {
+        rv = -1;
+        break;
       }
     }
+
+    if(rv == 0)
+      while(!io.empty() && (rv = io.wait(timeout, sigmask)) > 0) {}
+
+    // Anything still registered goes back to the caller for next time.
+    int err = errno;
+    for(auto &i : dests) {
+      if(i.fd < 0)
+        continue;
+      if(io.contains(i.fd))
+        io.remove(i.fd);
+      else if(rv >= 0)
+        i.fd = -i.fd;
+    }
+    errno = err;
+    return rv < 0 ? rv : 0;
   }
 
   int send_pgid(int fd, int pgid) {
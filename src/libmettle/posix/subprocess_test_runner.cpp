@@ -6,37 +6,23 @@
 #include <string.h>
 #include <sys/wait.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include <bencode.hpp>
 
-// Ignore warnings about deprecated implicit copy constructor.
-#if defined(__clang__)
-#  pragma clang diagnostic push
-#  pragma clang diagnostic ignored "-Wdeprecated"
-#endif
-
-#include <boost/iostreams/device/file_descriptor.hpp>
-#include <boost/iostreams/stream.hpp>
-
-#if defined(__clang__)
-#  pragma clang diagnostic pop
-#endif
-
 #include <mettle/detail/source_location.hpp>
 #include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/posix/pidfd.hpp>
+#include <mettle/driver/posix/rlimit.hpp>
+#include <mettle/driver/posix/rusage.hpp>
 #include <mettle/driver/posix/scoped_pipe.hpp>
 #include <mettle/driver/posix/scoped_signal.hpp>
 #include <mettle/driver/posix/subprocess.hpp>
+#include <mettle/driver/posix/test_child.hpp>
 
 #include "../../err_string.hpp"
 
-#ifdef METTLE_SAFE_EXIT
-#  define EXIT_FUNC _exit
-#else
-#  define EXIT_FUNC exit
-#endif
-
 #ifdef METTLE_NO_SOURCE_LOCATION
 #  define PARENT_FAILED() parent_failed(                                      \
      ::mettle::detail::source_location::current(__FILE__, __func__, __LINE__) \
@@ -50,12 +36,12 @@ namespace mettle {
   using namespace posix;
 
   namespace {
-    pid_t test_pgid = 0;
+    std::vector<pid_t> test_pgids;
     struct sigaction old_sigint, old_sigquit;
 
     void sig_handler(int signum) {
-      assert(test_pgid != 0);
-      killpg(test_pgid, signum);
+      for(pid_t pgid : test_pgids)
+        killpg(pgid, signum);
 
       // Restore the previous signal action and re-raise the signal.
       struct sigaction *old_act = signum == SIGINT ? &old_sigint : &old_sigquit;
@@ -67,10 +53,6 @@ namespace mettle {
 
     test_result parent_failed(detail::source_location loc =
                                 detail::source_location::current()) {
-      if(test_pgid)
-        killpg(test_pgid, SIGKILL);
-      test_pgid = 0;
-
       return {{ .message = "Fatal error: " + err_string(errno),
                 .file_name = loc.file_name(), .line = loc.line() }};
     }
@@ -85,46 +67,129 @@ namespace mettle {
     }
   }
 
+  struct parallel_subprocess_runner::job {
+    ~job() {
+      if(pidfd >= 0)
+        close(pidfd);
+    }
+
+    callback_type done;
+    pid_t pid = 0, pgid = 0;
+    int pidfd = -1;
+    bool exited = false, reaped = false;
+    rusage usage = {};
+    timeout_t timeout;
+    resource_limits limits;
+    scoped_pipe stdout_pipe, stderr_pipe, log_pipe;
+    output_capture stdout_capture, stderr_capture;
+    log::test_output output;
+    std::string message;
+    std::chrono::steady_clock::time_point start_time;
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+  };
+
   test_result subprocess_test_runner::operator ()(
     const test_info &test, log::test_output &output
   ) const {
-    assert(test_pgid == 0);
+    if(!runner_) {
+      runner_ = std::make_shared<parallel_subprocess_runner>(
+        1, timeout_, max_output_, limits_
+      );
+    }
 
-    scoped_pipe stdout_pipe, stderr_pipe, pgid_pipe, log_pipe;
-    if(stdout_pipe.open() < 0 ||
-       stderr_pipe.open() < 0 ||
-       pgid_pipe.open() < 0 ||
-       log_pipe.open(O_CLOEXEC) < 0)
-      return PARENT_FAILED();
+    test_result result;
+    runner_->start(test, [&result, &output](
+      const test_result &r, const log::test_output &o, log::test_duration
+    ) {
+      result = r;
+      output = o;
+    });
+    runner_->wait();
+    return result;
+  }
 
-    fflush(nullptr);
+  parallel_subprocess_runner::parallel_subprocess_runner(
+    std::size_t jobs, timeout_t timeout, max_output_t max_output,
+    resource_limits limits
+  ) : jobs_(std::max<std::size_t>(jobs, 1)), timeout_(timeout),
+      max_output_(max_output), limits_(limits) {}
+
+  parallel_subprocess_runner::~parallel_subprocess_runner() {
+    if(running_.empty())
+      return;
 
     scoped_sigprocmask mask;
-    if(mask.push(SIG_BLOCK, SIGCHLD) < 0 ||
-       mask.push(SIG_BLOCK, {SIGINT, SIGQUIT}) < 0)
-      return PARENT_FAILED();
+    mask.push(SIG_BLOCK, {SIGINT, SIGQUIT});
+    for(auto &j : running_) {
+      killpg(j->pgid, SIGKILL);
+      waitpid(j->pid, nullptr, 0);
+      std::erase(test_pgids, j->pgid);
+    }
+    close_signals();
+  }
+
+  void parallel_subprocess_runner::start(const test_info &test,
+                                         callback_type done) {
+    while(running_.size() >= jobs_)
+      wait_any();
+
+    auto j = std::make_unique<job>();
+    j->done = std::move(done);
+    j->stdout_capture = output_capture(max_output_);
+    j->stderr_capture = output_capture(max_output_);
+
+    try {
+      j->timeout = test_timeout(timeout_, test.attrs);
+      j->limits = test_limits(limits_, test.attrs);
+    } catch(const std::exception &e) {
+      return finish(std::move(j), {{ .message = e.what() }});
+    }
 
-    pid_t pid;
-    if((pid = fork()) < 0)
-      return PARENT_FAILED();
+    // Set up our signal handlers before forking the first running test; they
+    // stay in place until every test is finished.
+    if(running_.empty() && open_signals() < 0)
+      return finish(std::move(j), PARENT_FAILED());
 
-    if(pid == 0) {
-      if(mask.clear() < 0)
-        child_failed();
+    scoped_pipe pgid_pipe;
+    if(j->stdout_pipe.open() < 0 ||
+       j->stderr_pipe.open() < 0 ||
+       pgid_pipe.open() < 0 ||
+       j->log_pipe.open(O_CLOEXEC) < 0)
+      return finish(std::move(j), PARENT_FAILED());
 
-      if(stdout_pipe.close_read() < 0 ||
-         stderr_pipe.close_read() < 0 ||
-         pgid_pipe.close_read() < 0 ||
-         log_pipe.close_read() < 0)
+    fflush(nullptr);
+
+    // Don't let SIGINT/SIGQUIT look at the list of test process groups while
+    // we're changing it.
+    scoped_sigprocmask mask;
+    if(mask.push(SIG_BLOCK, {SIGINT, SIGQUIT}) < 0)
+      return finish(std::move(j), PARENT_FAILED());
+
+    if((j->pid = fork()) < 0)
+      return finish(std::move(j), PARENT_FAILED());
+
+    if(j->pid == 0) {
+      sigint_.close();
+      sigquit_.close();
+      sigchld_.close();
+      io_.close();
+      if(mask.clear() < 0 || mask_.clear() < 0)
         child_failed();
 
-      if(stdout_pipe.move_write(STDOUT_FILENO) < 0 ||
-         stderr_pipe.move_write(STDERR_FILENO) < 0)
+      // Don't hold onto the pipes for any other tests that are running.
+      for(auto &other : running_) {
+        other->stdout_pipe.close_read();
+        other->stderr_pipe.close_read();
+        other->log_pipe.close_read();
+      }
+
+      if(j->stdout_pipe.close_read() < 0 ||
+         j->stderr_pipe.close_read() < 0 ||
+         pgid_pipe.close_read() < 0 ||
+         j->log_pipe.close_read() < 0)
         child_failed();
 
-      // Make a new process group so we can kill the test and all its children
-      // as a group.
-      if(setpgid(0, 0) < 0)
+      if(enter_test_process(j->stdout_pipe, j->stderr_pipe) < 0)
         child_failed();
 
       if(send_pgid(pgid_pipe.write_fd, getpgid(0)) < 0)
@@ -133,95 +198,216 @@ namespace mettle {
       if(pgid_pipe.close_write() < 0)
         child_failed();
 
-      if(timeout_)
-        make_timeout_monitor(*timeout_);
-
-      auto failed = test.function();
-      if(failed) {
-        try {
-          namespace io = boost::iostreams;
-          io::stream<io::file_descriptor_sink> stream(
-            log_pipe.write_fd, io::never_close_handle
-          );
-          stream.exceptions(stream.failbit | stream.badbit);
-          bencode::encode(stream, failed->to_bencode<bencode::data_view>());
-          stream.flush();
-        } catch(...) {
-          child_failed();
-        }
+      run_test_in_child(test, j->limits, j->log_pipe.write_fd);
+    }
+
+    j->start_time = std::chrono::steady_clock::now();
+    if(j->timeout)
+      j->deadline = j->start_time + *j->timeout;
+
+    if(j->stdout_pipe.close_write() < 0 ||
+       j->stderr_pipe.close_write() < 0 ||
+       pgid_pipe.close_write() < 0 ||
+       j->log_pipe.close_write() < 0)
+      return finish(std::move(j), PARENT_FAILED());
+
+    if(recv_pgid(pgid_pipe.read_fd, &j->pgid) < 0)
+      return finish(std::move(j), PARENT_FAILED());
+    test_pgids.push_back(j->pgid);
+
+    if(mask.pop() < 0)
+      return finish(std::move(j), PARENT_FAILED());
+
+    // If we can, watch for the test exiting with a pidfd, so that its exit is
+    // just another event for `io_`. Otherwise, we rely on SIGCHLD.
+    if(has_pidfd()) {
+      if((j->pidfd = open_pidfd(j->pid)) < 0 ||
+         io_.watch(j->pidfd, [&exited = j->exited]() { exited = true; }) < 0)
+        return finish(std::move(j), PARENT_FAILED());
+    }
+
+    auto capture = [](output_capture &c) {
+      return [&c](const char *data, std::size_t size) { c.append(data, size); };
+    };
+    if(io_.add(j->stdout_pipe.read_fd, capture(j->stdout_capture)) < 0 ||
+       io_.add(j->stderr_pipe.read_fd, capture(j->stderr_capture)) < 0 ||
+       io_.add(j->log_pipe.read_fd, &j->message) < 0)
+      return finish(std::move(j), PARENT_FAILED());
+    running_.push_back(std::move(j));
+  }
+
+  void parallel_subprocess_runner::wait() {
+    while(!running_.empty())
+      wait_any();
+  }
+
+  void parallel_subprocess_runner::wait_any() {
+    assert(!running_.empty());
+
+    sigset_t empty;
+    sigemptyset(&empty);
+    while(!reap_finished()) {
+      // Don't wait past the deadline of the next test to time out.
+      timespec wait_time, *wait_ptr = nullptr;
+      if(auto deadline = next_deadline()) {
+        auto left = *deadline - std::chrono::steady_clock::now();
+        wait_time = to_timespec(std::max(left, decltype(left)::zero()));
+        wait_ptr = &wait_time;
       }
 
-      fflush(nullptr);
-
-      EXIT_FUNC(failed ? exit_code::failure : exit_code::success);
-    } else {
-      scoped_sigaction sigint, sigquit, sigchld;
-
-      if(stdout_pipe.close_write() < 0 ||
-         stderr_pipe.close_write() < 0 ||
-         pgid_pipe.close_write() < 0 ||
-         log_pipe.close_write() < 0)
-        return PARENT_FAILED();
-
-      if(recv_pgid(pgid_pipe.read_fd, &test_pgid) < 0)
-        return PARENT_FAILED();
-
-      if(sigaction(SIGINT, nullptr, &old_sigint) < 0 ||
-         sigaction(SIGQUIT, nullptr, &old_sigquit) < 0)
-        return PARENT_FAILED();
-
-      if(sigint.open(SIGINT, sig_handler) < 0 ||
-         sigquit.open(SIGQUIT, sig_handler) < 0 ||
-         sigchld.open(SIGCHLD, sig_chld) < 0)
-        return PARENT_FAILED();
-
-      if(mask.pop() < 0)
-        return PARENT_FAILED();
-
-      std::string message;
-      std::vector<readfd> dests = {
-        {stdout_pipe.read_fd, &output.stdout_log},
-        {stderr_pipe.read_fd, &output.stderr_log},
-        {log_pipe.read_fd,    &message}
-      };
-
-      // Read from the piped stdout, stderr, and log. If we're interrupted
-      // (probably by SIGCHLD), do one last non-blocking read to get any data we
-      // might have missed.
-      sigset_t empty;
-      sigemptyset(&empty);
-      if(read_into(dests, nullptr, &empty) < 0) {
-        if(errno != EINTR)
-          return PARENT_FAILED();
-        timespec timeout = {0, 0};
-        if(read_into(dests, &timeout, nullptr) < 0)
-          return PARENT_FAILED();
+      // Read from the piped stdout, stderr, and log of every running test
+      // until a test exits or times out. With pidfds, exits show up as events
+      // like any other; otherwise, we're interrupted by SIGCHLD. If all the
+      // pipes have been closed, this just waits for a test to exit.
+      int rv = io_.wait(wait_ptr, has_pidfd() ? nullptr : &empty);
+      if(rv < 0 && errno != EINTR) {
+        auto err = PARENT_FAILED();
+        while(!running_.empty()) {
+          auto j = std::move(running_.back());
+          running_.pop_back();
+          finish(std::move(j), err);
+        }
+        return;
       }
+    }
+  }
+
+  std::optional<std::chrono::steady_clock::time_point>
+  parallel_subprocess_runner::next_deadline() const {
+    std::optional<std::chrono::steady_clock::time_point> next;
+    for(auto &j : running_) {
+      if(j->deadline && (!next || *j->deadline < *next))
+        next = j->deadline;
+    }
+    return next;
+  }
 
+  bool parallel_subprocess_runner::reap_finished() {
+    bool reaped = false;
+    for(std::size_t i = 0; i != running_.size();) {
+      // If we have a pidfd, there's nothing to reap until it says so.
       int status;
-      if(waitpid(pid, &status, 0) < 0)
-        return PARENT_FAILED();
+      pid_t pid = 0;
+      if(running_[i]->pidfd < 0 || running_[i]->exited)
+        pid = wait4(running_[i]->pid, &status, WNOHANG, &running_[i]->usage);
+      if(pid == 0) {
+        auto &deadline = running_[i]->deadline;
+        if(!deadline || std::chrono::steady_clock::now() < *deadline) {
+          i++;
+          continue;
+        }
 
-      // Make sure everything in the test's process group is dead. Don't worry
-      // about reaping.
-      killpg(test_pgid, SIGKILL);
-      test_pgid = 0;
+        // The test timed out, so kill its entire process group.
+        auto j = std::move(running_[i]);
+        running_.erase(running_.begin() + i);
+        killpg(j->pgid, SIGKILL);
+        wait4(j->pid, nullptr, 0, &j->usage);
+        j->reaped = reaped = true;
+
+        std::ostringstream ss;
+        ss << "Timed out after " << j->timeout->count() << " ms";
+        finish(std::move(j), {{ .message = ss.str() }});
+        continue;
+      }
+
+      auto j = std::move(running_[i]);
+      running_.erase(running_.begin() + i);
+      j->reaped = reaped = true;
+
+      if(pid < 0) {
+        finish(std::move(j), PARENT_FAILED());
+        continue;
+      }
+
+      // Do one last non-blocking read to get any data we might have missed.
+      if(io_.drain(j->stdout_pipe.read_fd) < 0 ||
+         io_.drain(j->stderr_pipe.read_fd) < 0 ||
+         io_.drain(j->log_pipe.read_fd) < 0) {
+        finish(std::move(j), PARENT_FAILED());
+        continue;
+      }
 
       if(WIFEXITED(status)) {
-        int exit_status = WEXITSTATUS(status);
-        if(exit_status == exit_code::timeout) {
-          std::ostringstream ss;
-          ss << "Timed out after " << timeout_->count() << " ms";
-          return {{ .message = ss.str() }};
-        } else if(exit_status == exit_code::success) {
-          return std::nullopt;
+        if(WEXITSTATUS(status) == exit_code::success) {
+          finish(std::move(j), std::nullopt);
         } else {
-          return {test_failure::from_bencode(bencode::decode(message))};
+          auto message = std::move(j->message);
+          finish(std::move(j), {test_failure::from_bencode(
+            bencode::decode(message)
+          )});
         }
       } else { // WIFSIGNALED
-        return {{ .message = strsignal(WTERMSIG(status)) }};
+        auto message = exceeded_limit(j->limits, status, j->usage);
+        if(!message)
+          message = strsignal(WTERMSIG(status));
+        finish(std::move(j), {{ .message = std::move(*message) }});
       }
     }
+    return reaped;
+  }
+
+  void parallel_subprocess_runner::finish(std::unique_ptr<job> j,
+                                          const test_result &result) {
+    log::test_duration duration;
+    duration.wall = std::chrono::steady_clock::now() - j->start_time;
+    add_rusage(duration, j->usage);
+
+    // Stop watching the test's pipes before they're closed (and their
+    // descriptors potentially reused).
+    io_.remove(j->stdout_pipe.read_fd);
+    io_.remove(j->stderr_pipe.read_fd);
+    io_.remove(j->log_pipe.read_fd);
+    if(j->pidfd >= 0)
+      io_.remove(j->pidfd);
+
+    // Make sure everything in the test's process group is dead. Don't worry
+    // about reaping.
+    if(j->pgid) {
+      killpg(j->pgid, SIGKILL);
+
+      scoped_sigprocmask mask;
+      mask.push(SIG_BLOCK, {SIGINT, SIGQUIT});
+      std::erase(test_pgids, j->pgid);
+    }
+    if(j->pid > 0 && !j->reaped) {
+      kill(j->pid, SIGKILL);
+      waitpid(j->pid, nullptr, 0);
+    }
+
+    if(running_.empty())
+      close_signals();
+
+    j->output.stdout_log = j->stdout_capture.str();
+    j->output.stderr_log = j->stderr_capture.str();
+    j->output.stdout_dropped = j->stdout_capture.dropped();
+    j->output.stderr_dropped = j->stderr_capture.dropped();
+    j->done(result, j->output, duration);
+  }
+
+  int parallel_subprocess_runner::open_signals() {
+    // Without pidfds, we find out about tests exiting from SIGCHLD, so keep
+    // it blocked (except while waiting) to make sure we can't miss it.
+    bool use_sigchld = !has_pidfd();
+    if(use_sigchld && mask_.push(SIG_BLOCK, SIGCHLD) < 0)
+      return -1;
+
+    if(sigaction(SIGINT, nullptr, &old_sigint) < 0 ||
+       sigaction(SIGQUIT, nullptr, &old_sigquit) < 0)
+      return -1;
+
+    if(sigint_.open(SIGINT, sig_handler) < 0 ||
+       sigquit_.open(SIGQUIT, sig_handler) < 0)
+      return -1;
+    if(use_sigchld && sigchld_.open(SIGCHLD, sig_chld) < 0)
+      return -1;
+    return 0;
+  }
+
+  void parallel_subprocess_runner::close_signals() {
+    sigint_.close();
+    sigquit_.close();
+    sigchld_.close();
+    mask_.clear();
   }
 
   int make_fd_private(int fd) {
@@ -0,0 +1,72 @@
+#include <mettle/driver/posix/test_child.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <bencode.hpp>
+
+// Ignore warnings about deprecated implicit copy constructor.
+#if defined(__clang__)
+#  pragma clang diagnostic push
+#  pragma clang diagnostic ignored "-Wdeprecated"
+#endif
+
+#include <boost/iostreams/device/file_descriptor.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#if defined(__clang__)
+#  pragma clang diagnostic pop
+#endif
+
+#include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/posix/rlimit.hpp>
+
+#ifdef METTLE_SAFE_EXIT
+#  define EXIT_FUNC _exit
+#else
+#  define EXIT_FUNC exit
+#endif
+
+namespace mettle::posix {
+
+  namespace {
+    [[noreturn]] inline void child_failed() {
+      _exit(exit_code::fatal);
+    }
+  }
+
+  int enter_test_process(scoped_pipe &stdout_pipe, scoped_pipe &stderr_pipe) {
+    if(stdout_pipe.move_write(STDOUT_FILENO) < 0 ||
+       stderr_pipe.move_write(STDERR_FILENO) < 0)
+      return -1;
+    return setpgid(0, 0);
+  }
+
+  void run_test_in_child(const test_info &test, const resource_limits &limits,
+                         int log_fd) {
+    if(set_limits(limits) < 0)
+      child_failed();
+
+    auto failed = test.function();
+    check_limits(limits, failed);
+    if(failed) {
+      try {
+        namespace io = boost::iostreams;
+        io::stream<io::file_descriptor_sink> stream(
+          log_fd, io::never_close_handle
+        );
+        stream.exceptions(stream.failbit | stream.badbit);
+        bencode::encode(stream, failed->to_bencode<bencode::data_view>());
+        stream.flush();
+      } catch(...) {
+        child_failed();
+      }
+    }
+
+    fflush(nullptr);
+
+    EXIT_FUNC(failed ? exit_code::failure : exit_code::success);
+  }
+
+} // namespace mettle::posix
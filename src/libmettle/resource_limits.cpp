@@ -0,0 +1,56 @@
+#include <mettle/driver/resource_limits.hpp>
+
+#include <stdexcept>
+#include <string>
+
+#include <boost/lexical_cast.hpp>
+
+#include <mettle/driver/cmd_line.hpp>
+
+namespace mettle {
+
+  namespace {
+    const std::string * attr_value(const attributes &attrs,
+                                   const attr_base &attr) {
+      auto found = find_attr(attrs, attr);
+      if(!found || found->value.empty())
+        return nullptr;
+      return &*found->value.begin();
+    }
+
+    template<typename Parse>
+    auto parse_value(const attr_base &attr, const std::string &value,
+                     Parse &&parse) {
+      try {
+        return parse(value);
+      } catch(...) {
+        throw std::invalid_argument(
+          "invalid value for " + attr.name() + ": \"" + value + "\""
+        );
+      }
+    }
+
+    std::uint64_t parse_count(const std::string &value) {
+      return boost::lexical_cast<std::uint64_t>(value);
+    }
+  }
+
+  resource_limits
+  test_limits(const resource_limits &defaults, const attributes &attrs) {
+    resource_limits limits = defaults;
+    if(auto value = attr_value(attrs, memory_limit)) {
+      limits.memory = parse_value(memory_limit, *value, [](const auto &v) {
+        return parse_data_size(v).bytes;
+      });
+    }
+    if(auto value = attr_value(attrs, cpu_limit)) {
+      limits.cpu_time = std::chrono::seconds(
+        parse_value(cpu_limit, *value, parse_count)
+      );
+    }
+    if(auto value = attr_value(attrs, open_files_limit))
+      limits.open_files = parse_value(open_files_limit, *value, parse_count);
+    return limits;
+  }
+
+} // namespace mettle
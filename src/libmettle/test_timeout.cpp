@@ -0,0 +1,28 @@
+#include <mettle/driver/subprocess_test_runner.hpp>
+
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+namespace mettle {
+
+  subprocess_test_runner::timeout_t
+  test_timeout(subprocess_test_runner::timeout_t timeout,
+               const attributes &attrs) {
+    auto found = find_attr(attrs, mettle::timeout);
+    if(!found || found->value.empty())
+      return timeout;
+
+    const auto &value = *found->value.begin();
+    try {
+      return std::chrono::milliseconds(
+        boost::lexical_cast<std::size_t>(value)
+      );
+    } catch(...) {
+      throw std::invalid_argument(
+        "invalid value for timeout: \"" + value + "\""
+      );
+    }
+  }
+
+} // namespace mettle
@@ -0,0 +1,84 @@
+#include <mettle/driver/test_uids.hpp>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <mettle/detail/hash.hpp>
+
+namespace mettle {
+
+  namespace {
+    // 0 is never a test ID, and `detail::max_local_bits` uses 0xffffffff to
+    // refer to a whole file, so keep hashed IDs between those.
+    constexpr test_uid max_hashed_uid = 0xfffffffe;
+
+    class uid_assigner {
+    public:
+      uid_assigner(test_uid_scheme scheme) : scheme_(scheme) {}
+
+      void operator ()(suites_list &suites) {
+        for(auto &suite : suites)
+          assign(suite);
+      }
+    private:
+      void assign(runnable_suite &suite) {
+        parents_.push_back(suite.name());
+        for(auto &test : suite.tests())
+          assign(test);
+        for(auto &subsuite : suite.subsuites())
+          assign(subsuite);
+        parents_.pop_back();
+      }
+
+      void assign(test_info &test) {
+        std::string name;
+        for(const auto &i : parents_)
+          name += i + " > ";
+        name += test.name;
+
+        // Hash the full name the same way as `test_name::full_name()`, so
+        // that these IDs line up with what users see.
+        auto hash = detail::fnv1a(name);
+        if(scheme_ == test_uid_scheme::location) {
+          std::string where = std::string(test.location.file_name()) + ":" +
+                              std::to_string(test.location.line());
+          hash = detail::fnv1a(where, detail::fnv1a({"\0", 1}, hash));
+          name += " (" + where + ")";
+        }
+
+        // If another test already has this ID, try the next one until we find
+        // a free one. Tests are visited in declaration order, so this is still
+        // deterministic. A test with exactly the same name as an earlier one
+        // would have followed the same path, so we'll run into it on the way;
+        // that's a real ambiguity, so report it.
+        test_uid id = (hash ^ (hash >> 32)) % max_hashed_uid + 1;
+        while(true) {
+          auto [i, added] = seen_.emplace(id, name);
+          if(added)
+            break;
+          if(i->second == name) {
+            throw std::runtime_error(
+              "tests \"" + i->second + "\" and \"" + name +
+              "\" have the same ID"
+            );
+          }
+          id = id % max_hashed_uid + 1;
+        }
+        test.id = id;
+      }
+
+      test_uid_scheme scheme_;
+      std::vector<std::string> parents_;
+      std::map<test_uid, std::string> seen_;
+    };
+  }
+
+  void assign_test_uids(suites_list &suites, test_uid_scheme scheme) {
+    if(scheme == test_uid_scheme::sequential)
+      return;
+    uid_assigner{scheme}(suites);
+  }
+
+} // namespace mettle
@@ -0,0 +1,217 @@
+#include <mettle/driver/threaded_test_runner.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+#include <mettle/driver/subprocess_test_runner.hpp>
+
+namespace mettle {
+
+  namespace {
+    // Like `detail::current_usage()`, but only for the calling thread (when
+    // the OS can tell us that).
+    log::test_duration thread_usage() {
+      log::test_duration now;
+      now.wall = std::chrono::steady_clock::now().time_since_epoch();
+#ifdef RUSAGE_THREAD
+      rusage usage;
+      if(getrusage(RUSAGE_THREAD, &usage) == 0)
+        posix::add_rusage(now, usage);
+#endif
+      return now;
+    }
+
+    const char not_run_message[] = "Not run: an earlier test timed out";
+  }
+
+  threaded_test_runner::threaded_test_runner(std::size_t jobs,
+                                             bool all_thread_safe,
+                                             timeout_t timeout)
+    : all_thread_safe_(all_thread_safe), timeout_(timeout) {
+    jobs = std::max<std::size_t>(jobs, 1);
+    threads_.reserve(jobs);
+    for(std::size_t i = 0; i != jobs; i++)
+      threads_.emplace_back([this]() { run_worker(); });
+  }
+
+  threaded_test_runner::~threaded_test_runner() {
+    {
+      std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for(auto &t : threads_)
+      t.join();
+  }
+
+  void threaded_test_runner::start(const test_info &test,
+                                   callback_type done) {
+    auto j = std::make_shared<job>();
+    j->test = &test;
+    j->done = std::move(done);
+    try {
+      j->timeout = test_timeout(timeout_, test.attrs);
+    } catch(const std::exception &e) {
+      return j->done({{ .message = e.what() }}, {}, {});
+    }
+
+    std::unique_lock lock(mutex_);
+    if(all_thread_safe_ || has_attr(test.attrs, thread_safe)) {
+      if(timed_out_)
+        return not_run(std::move(j), lock);
+      pending_.push_back(std::move(j));
+      lock.unlock();
+      work_ready_.notify_one();
+      return;
+    }
+
+    // This test might touch state shared with other tests, so wait until
+    // nothing else is running, and then wait for it to finish too.
+    wait_idle(lock);
+    if(timed_out_)
+      return not_run(std::move(j), lock);
+    pending_.push_back(std::move(j));
+    work_ready_.notify_one();
+    wait_idle(lock);
+  }
+
+  void threaded_test_runner::wait() {
+    std::unique_lock lock(mutex_);
+    wait_idle(lock);
+  }
+
+  bool threaded_test_runner::timed_out() {
+    std::lock_guard lock(mutex_);
+    return timed_out_;
+  }
+
+  void threaded_test_runner::not_run(job_ptr j,
+                                     std::unique_lock<std::mutex> &lock) {
+    lock.unlock();
+    j->done({{ .message = not_run_message }}, {}, {});
+  }
+
+  void threaded_test_runner::run_job(job &j) {
+    auto then = thread_usage();
+    j.result = j.test->function();
+    j.duration = detail::usage_since(then, thread_usage());
+  }
+
+  void threaded_test_runner::run_worker() {
+    std::unique_lock lock(mutex_);
+    while(true) {
+      work_ready_.wait(lock, [this]() {
+        return stopping_ || !pending_.empty();
+      });
+      if(stopping_)
+        return;
+
+      auto j = std::move(pending_.front());
+      pending_.pop_front();
+      j->worker = std::this_thread::get_id();
+      j->started = clock::now();
+      running_.push_back(j);
+      work_done_.notify_one();
+
+      lock.unlock();
+      run_job(*j);
+
+      // If the test timed out, this thread has already been detached and
+      // replaced, and the runner may even be gone, so don't touch it.
+      auto expected = job_state::running;
+      if(!j->state.compare_exchange_strong(expected, job_state::finished))
+        return;
+      lock.lock();
+
+      std::erase(running_, j);
+      finished_.push_back(std::move(j));
+      work_done_.notify_one();
+    }
+  }
+
+  void threaded_test_runner::wait_idle(std::unique_lock<std::mutex> &lock) {
+    // Report results from this thread, since loggers aren't thread-safe. The
+    // lock is released while reporting, so check again for new results
+    // before deciding that we're done.
+    while(true) {
+      while(!finished_.empty()) {
+        auto j = std::move(finished_.front());
+        finished_.pop_front();
+
+        lock.unlock();
+        j->done(j->result, {}, j->duration);
+        lock.lock();
+      }
+
+      if(pending_.empty() && running_.empty() && finished_.empty())
+        return;
+
+      if(auto deadline = next_deadline()) {
+        if(work_done_.wait_until(lock, *deadline) == std::cv_status::timeout)
+          expire_overdue();
+      } else {
+        work_done_.wait(lock);
+      }
+    }
+  }
+
+  std::optional<threaded_test_runner::clock::time_point>
+  threaded_test_runner::next_deadline() const {
+    std::optional<clock::time_point> result;
+    for(const auto &j : running_) {
+      if(!j->timeout)
+        continue;
+      auto deadline = j->started + *j->timeout;
+      if(!result || deadline < *result)
+        result = deadline;
+    }
+    return result;
+  }
+
+  void threaded_test_runner::expire_overdue() {
+    auto now = clock::now();
+    for(auto i = running_.begin(); i != running_.end();) {
+      auto &j = **i;
+      if(!j.timeout || now < j.started + *j.timeout) {
+        ++i;
+        continue;
+      }
+
+      // The test may have only just finished; if so, let the worker report
+      // it as usual.
+      auto expected = job_state::running;
+      if(!j.state.compare_exchange_strong(expected, job_state::abandoned)) {
+        ++i;
+        continue;
+      }
+
+      std::ostringstream ss;
+      ss << "Timed out after " << j.timeout->count() << " ms";
+      j.result = test_failure{ .message = ss.str() };
+      j.duration = log::test_duration(now - j.started);
+      finished_.push_back(std::move(*i));
+      i = running_.erase(i);
+
+      // Let the stuck thread go. It's still running the test, so running
+      // anything else now could break the isolation between tests; fail
+      // whatever hasn't started yet instead.
+      auto t = std::find_if(threads_.begin(), threads_.end(), [&j](auto &t) {
+        return t.get_id() == j.worker;
+      });
+      assert(t != threads_.end());
+      t->detach();
+      threads_.erase(t);
+      timed_out_ = true;
+    }
+
+    if(timed_out_) {
+      for(auto &p : pending_) {
+        p->result = test_failure{ .message = not_run_message };
+        finished_.push_back(std::move(p));
+      }
+      pending_.clear();
+    }
+  }
+
+} // namespace mettle
@@ -0,0 +1,133 @@
+#include <mettle/driver/watchdog.hpp>
+
+#include <sstream>
+
+#include <mettle/driver/subprocess_test_runner.hpp>
+
+namespace mettle {
+
+  watchdog::watchdog(log::test_logger &logger, timeout_t timeout,
+                     handler_type on_timeout)
+    : logger_(logger), timeout_(timeout), on_timeout_(std::move(on_timeout)),
+      thread_([this]() { watch(); }) {}
+
+  watchdog::~watchdog() {
+    {
+      std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_one();
+    thread_.join();
+  }
+
+  void watchdog::started_run() {
+    std::lock_guard lock(log_mutex_);
+    logger_.started_run();
+  }
+
+  void watchdog::ended_run() {
+    std::lock_guard lock(log_mutex_);
+    logger_.ended_run();
+  }
+
+  void watchdog::started_suite(const std::vector<suite_name> &suites) {
+    std::lock_guard lock(log_mutex_);
+    logger_.started_suite(suites);
+  }
+
+  void watchdog::ended_suite(const std::vector<suite_name> &suites) {
+    std::lock_guard lock(log_mutex_);
+    logger_.ended_suite(suites);
+  }
+
+  void watchdog::started_test(const test_name &test) {
+    {
+      std::lock_guard lock(mutex_);
+      current_ = test;
+    }
+    std::lock_guard lock(log_mutex_);
+    logger_.started_test(test);
+  }
+
+  void watchdog::passed_test(const test_name &test,
+                             const log::test_output &output,
+                             log::test_duration duration) {
+    std::lock_guard lock(log_mutex_);
+    logger_.passed_test(test, output, duration);
+  }
+
+  void watchdog::failed_test(const test_name &test,
+                             const test_failure &failure,
+                             const log::test_output &output,
+                             log::test_duration duration) {
+    std::lock_guard lock(log_mutex_);
+    logger_.failed_test(test, failure, output, duration);
+  }
+
+  void watchdog::skipped_test(const test_name &test,
+                              const std::string &message) {
+    std::lock_guard lock(log_mutex_);
+    logger_.skipped_test(test, message);
+  }
+
+  test_result watchdog::run(const test_info &test) {
+    timeout_t timeout;
+    try {
+      timeout = test_timeout(timeout_, test.attrs);
+    } catch(const std::exception &e) {
+      return {{ .message = e.what() }};
+    }
+    if(!timeout)
+      return test.function();
+
+    {
+      std::lock_guard lock(mutex_);
+      limit_ = *timeout;
+      started_ = clock::now();
+      deadline_ = started_ + *timeout;
+    }
+    changed_.notify_one();
+
+    auto result = test.function();
+
+    // If the test has already expired, the watchdog thread holds onto the
+    // lock while it reports the timeout, so we'll wait here until it's done.
+    std::lock_guard lock(mutex_);
+    deadline_.reset();
+    return result;
+  }
+
+  void watchdog::watch() {
+    std::unique_lock lock(mutex_);
+    while(!stopping_) {
+      if(!deadline_) {
+        changed_.wait(lock);
+      } else if(clock::now() >= *deadline_) {
+        // The handler should have ended the process, but if it hasn't, stop
+        // watching this test and wait for the next one.
+        expire();
+        deadline_.reset();
+      } else {
+        changed_.wait_until(lock, *deadline_);
+      }
+    }
+  }
+
+  void watchdog::expire() {
+    std::lock_guard lock(log_mutex_);
+    log::test_duration duration(clock::now() - started_);
+    std::ostringstream ss;
+    ss << "Timed out after " << limit_.count() << " ms";
+    logger_.failed_test(*current_, {.message = ss.str()}, {}, duration);
+
+    // Close up everything that's still open, innermost first, so the logger
+    // has a complete run to write out.
+    const auto &suites = current_->suites;
+    for(auto end = suites.end(); end != suites.begin(); --end)
+      logger_.ended_suite({suites.begin(), end});
+    logger_.ended_run();
+
+    on_timeout_();
+  }
+
+} // namespace mettle
@@ -84,13 +84,20 @@ namespace mettle {
     if(!(job = CreateJobObject(nullptr, nullptr)))
       return METTLE_FAILED();
 
+    timeout_t timeout;
+    try {
+      timeout = test_timeout(timeout_, test.attrs);
+    } catch(const std::exception &e) {
+      return {{ .message = e.what() }};
+    }
+
     scoped_handle timeout_event;
-    if(timeout_) {
+    if(timeout) {
       if(!(timeout_event = CreateWaitableTimer(nullptr, true, nullptr)))
         return METTLE_FAILED();
       LARGE_INTEGER t;
       // Convert from ms to 100s-of-nanoseconds (negative for relative time).
-      t.QuadPart = -timeout_->count() * 10000;
+      t.QuadPart = -timeout->count() * 10000;
       if(!SetWaitableTimer(timeout_event, &t, 0, nullptr, nullptr, false))
         return METTLE_FAILED();
     }
@@ -122,7 +129,7 @@ namespace mettle {
       {log_pipe.read_handle,    &message}
     };
     std::vector<HANDLE> interrupts = {proc_info.hProcess};
-    if(timeout_)
+    if(timeout)
       interrupts.push_back(timeout_event);
 
     HANDLE finished = read_into(dests, INFINITE, interrupts);
@@ -131,13 +138,23 @@ namespace mettle {
     // Do one last non-blocking read to get any data we might have missed.
     read_into(dests, 0, interrupts);
 
+    // Apply the output limit, if any. Unlike on POSIX systems, this happens
+    // after all the output has been read.
+    if(max_output_) {
+      output_capture stdout_capture(max_output_), stderr_capture(max_output_);
+      stdout_capture.append(output.stdout_log.data(), output.stdout_log.size());
+      stderr_capture.append(output.stderr_log.data(), output.stderr_log.size());
+      output = {stdout_capture.str(), stderr_capture.str(),
+                stdout_capture.dropped(), stderr_capture.dropped()};
+    }
+
     // By now, the child process's main thread has returned, so kill any stray
     // processes in the job.
     TerminateJobObject(job, 1);
 
     if(finished == timeout_event) {
       std::ostringstream ss;
-      ss << "Timed out after " << timeout_->count() << " ms";
+      ss << "Timed out after " << timeout->count() << " ms";
       return {{ .message = ss.str() }};
     } else {
       DWORD exit_status;
@@ -150,22 +167,6 @@ namespace mettle {
     }
   }
 
-  const test_info *
-  find_test(const suites_list &suites, test_uid id) {
-    for(const auto &suite : suites) {
-      for(const auto &test : suite.tests()) {
-        if(test.id == id)
-          return &test;
-      }
-
-      auto found = find_test(suite.subsuites(), id);
-      if(found)
-        return found;
-    }
-
-    return nullptr;
-  }
-
   int run_single_test(const test_info &test, HANDLE log_pipe) {
     auto failed = test.function();
     if(failed) {
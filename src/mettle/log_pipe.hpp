@@ -1,10 +1,16 @@
 #ifndef INC_METTLE_SRC_LOG_PIPE_HPP
 #define INC_METTLE_SRC_LOG_PIPE_HPP
 
+#include <algorithm>
+#include <cstdint>
 #include <istream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
-#include <bencode.hpp>
-
+#include <mettle/driver/log/binary_child.hpp>
 #include <mettle/driver/log/core.hpp>
 
 namespace mettle::log {
@@ -14,93 +20,515 @@ namespace mettle::log {
     pipe(log::file_logger &logger, test_uid file_uid)
       : logger_(logger), file_uid_(file_uid) {}
 
+    // Read and log the next event from the stream. Streams from test files
+    // may use either the binary protocol (announced by a header) or bencode.
     void operator ()(std::istream &s) {
-      auto tmp = bencode::decode(s, bencode::no_check_eof);
-      auto &data = std::get<bencode::dict>(tmp);
-      auto &&event = std::get<bencode::string>(data.at("event"));
+      using traits = std::istream::traits_type;
+      if(!binary_ && s.peek() == traits::to_int_type(binary::magic[0]))
+        read_binary_header(s);
+
+      if(binary_)
+        read_binary_event(s);
+      else
+        read_bencode_event(s);
+    }
+
+    // The number of failed tests (or files) logged so far.
+    std::size_t failures() const {
+      return failures_;
+    }
+
+    // The number of runs the test file has said it finished. This lets us
+    // tell where each run ends when a test file runs its tests more than
+    // once (see --control-fd).
+    std::size_t ended_runs() const {
+      return ended_runs_;
+    }
+  private:
+    // A view of an event's payload that we can pick values off of. Strings
+    // refer to the payload itself, so they're only copied if necessary.
+    class payload_reader {
+    public:
+      payload_reader(std::string_view data) : data_(data) {}
+
+      std::uint64_t uint() {
+        std::uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+          if(data_.empty())
+            throw std::runtime_error("truncated event");
+          unsigned char byte = static_cast<unsigned char>(data_.front());
+          data_.remove_prefix(1);
+          value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+          if(!(byte & 0x80))
+            return value;
+        }
+        throw std::runtime_error("invalid integer in event");
+      }
+
+      std::string_view string() {
+        auto size = uint();
+        if(size > data_.size())
+          throw std::runtime_error("truncated event");
+        auto result = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return result;
+      }
+    private:
+      std::string_view data_;
+    };
+
+    // The largest event payload we'll accept. This is far more than any test
+    // should produce (especially with --max-output), but keeps a corrupt
+    // stream from making us allocate arbitrary amounts of memory. See the docs
+    // for --max-output.
+    static constexpr std::uint64_t max_payload = 256 * 1024 * 1024;
+
+    void read_binary_header(std::istream &s) {
+      char header[sizeof(binary::magic) + 1];
+      read_exactly(s, header, sizeof(header));
+      if(!std::equal(binary::magic, binary::magic + sizeof(binary::magic),
+                     header))
+        throw std::runtime_error("invalid event stream header");
+      auto version = static_cast<unsigned char>(header[sizeof(binary::magic)]);
+      if(version > binary::version)
+        throw std::runtime_error("unsupported event protocol version");
+      binary_ = true;
+    }
+
+    static std::uint64_t read_uint(std::istream &s) {
+      std::uint64_t value = 0;
+      for(int shift = 0; shift < 64; shift += 7) {
+        auto byte = static_cast<unsigned char>(next_char(s));
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+          return value;
+      }
+      throw std::runtime_error("invalid integer in event");
+    }
+
+    void read_binary_event(std::istream &s) {
+      using tag = binary::tag;
+      using traits = std::istream::traits_type;
+
+      // Definitions are sent just before the event that needs them, so keep
+      // going until we get to a real event.
+      while(s.peek() != traits::eof()) {
+        auto t = static_cast<tag>(next_char(s));
+        auto size = read_uint(s);
+        if(size > max_payload)
+          throw std::runtime_error("event too large");
+        payload_.resize(static_cast<std::size_t>(size));
+        read_exactly(s, payload_.data(), payload_.size());
+        payload_reader r(payload_);
+
+        switch(t) {
+        case tag::define_file: {
+          auto id = r.uint();
+          define(files_, id, std::string(r.string()));
+          continue;
+        }
+        case tag::define_suite: {
+          auto id = r.uint();
+          auto name = r.string();
+          auto &file = files_.at(r.uint());
+          define(suites_, id, suite_name{
+            std::string(name), file,
+            static_cast<std::uint_least32_t>(r.uint())
+          });
+          continue;
+        }
+        case tag::started_suite:
+          logger_.started_suite(read_suites(r));
+          break;
+        case tag::ended_suite:
+          logger_.ended_suite(read_suites(r));
+          break;
+        case tag::started_test:
+          logger_.started_test(read_test_name(r));
+          break;
+        case tag::passed_test: {
+          auto test = read_test_name(r);
+          auto duration = read_duration(r);
+          logger_.passed_test(test, read_test_output(r), duration);
+          break;
+        }
+        case tag::failed_test: {
+          auto test = read_test_name(r);
+          auto duration = read_duration(r);
+          test_failure failure;
+          failure.desc = r.string();
+          failure.message = r.string();
+          failure.file_name = r.string();
+          failure.line = static_cast<std::uint_least32_t>(r.uint());
+          logger_.failed_test(test, failure, read_test_output(r), duration);
+          failures_++;
+          break;
+        }
+        case tag::skipped_test: {
+          auto test = read_test_name(r);
+          logger_.skipped_test(test, std::string(r.string()));
+          break;
+        }
+        case tag::listed_test: {
+          auto test = read_test_name(r);
+          log::test_attrs attrs;
+          for(auto n = r.uint(); n != 0; n--) {
+            auto &values = attrs[std::string(r.string())];
+            for(auto m = r.uint(); m != 0; m--)
+              values.emplace(r.string());
+          }
+          logger_.listed_test(test, attrs);
+          break;
+        }
+        case tag::ended_run:
+          ended_runs_++;
+          break;
+        default:
+          // Ignore started_run and anything we don't recognize.
+          break;
+        }
+        return;
+      }
+    }
+
+    template<typename T>
+    static void define(std::vector<T> &table, std::uint64_t id, T value) {
+      if(id != table.size())
+        throw std::runtime_error("out-of-order definition in event stream");
+      table.push_back(std::move(value));
+    }
+
+    std::vector<suite_name> read_suites(payload_reader &r) {
+      std::vector<suite_name> result(r.uint());
+      for(auto &i : result)
+        i = suites_.at(r.uint());
+      return result;
+    }
+
+    test_name read_test_name(payload_reader &r) {
+      test_uid id = file_uid_ + static_cast<test_uid>(r.uint());
+      auto suites = read_suites(r);
+      auto name = r.string();
+      auto &file = files_.at(r.uint());
+      return {
+        id, std::move(suites), std::string(name), file,
+        static_cast<std::uint_least32_t>(r.uint())
+      };
+    }
+
+    log::test_duration read_duration(payload_reader &r) {
+      using namespace std::chrono;
+      log::test_duration duration;
+      duration.wall = nanoseconds(r.uint());
+      duration.user = nanoseconds(r.uint());
+      duration.system = nanoseconds(r.uint());
+
+      auto &u = duration.usage;
+      u.max_rss = r.uint();
+      u.minor_faults = r.uint();
+      u.major_faults = r.uint();
+      u.voluntary_switches = r.uint();
+      u.involuntary_switches = r.uint();
+      u.block_inputs = r.uint();
+      u.block_outputs = r.uint();
+      return duration;
+    }
+
+    log::test_output read_test_output(payload_reader &r) {
+      log::test_output output;
+      output.stdout_log = r.string();
+      output.stderr_log = r.string();
+      output.stdout_dropped = static_cast<std::size_t>(r.uint());
+      output.stderr_dropped = static_cast<std::size_t>(r.uint());
+      return output;
+    }
+
+    // Decode a bencoded event directly from the stream into the fields we
+    // need, without building a bencode::data tree first. Dict keys are sorted,
+    // so we don't know what event this is until we've read "event"; just
+    // collect every field we understand and then dispatch.
+    void read_bencode_event(std::istream &s) {
+      std::string event, message, file_name;
+      std::vector<suite_name> suites;
+      test_name test;
+      test_failure failure;
+      log::test_output output;
+      log::test_attrs attrs;
+      std::int64_t duration_ms = 0;
+      std::optional<log::test_duration> times;
+      log::resource_usage usage;
+
+      read_dict(s, [&](const std::string &key) {
+        if(key == "event")
+          read_string(s, event);
+        else if(key == "suites")
+          read_suites(s, suites);
+        else if(key == "test")
+          read_test_name(s, test);
+        else if(key == "duration")
+          duration_ms = read_integer(s);
+        else if(key == "times")
+          read_duration(s, times.emplace());
+        else if(key == "usage")
+          read_usage(s, usage);
+        else if(key == "failure")
+          read_failure(s, failure);
+        else if(key == "output")
+          read_test_output(s, output);
+        else if(key == "message")
+          read_string(s, message);
+        else if(key == "file_name")
+          read_string(s, file_name);
+        else if(key == "attributes")
+          read_attrs(s, attrs);
+        else
+          skip_value(s);
+      });
+
+      // Newer test files send their times in nanoseconds as well as the
+      // wall-clock time in milliseconds; prefer those if we have them.
+      auto duration = times ? *times : log::test_duration{
+        std::chrono::milliseconds(duration_ms)
+      };
+      duration.usage = usage;
 
       if(event == "started_suite") {
-        logger_.started_suite(read_suites( std::move(data.at("suites")) ));
+        logger_.started_suite(suites);
       } else if(event == "ended_suite") {
-        logger_.ended_suite(read_suites( std::move(data.at("suites")) ));
+        logger_.ended_suite(suites);
       } else if(event == "started_test") {
-        logger_.started_test(read_test_name( std::move(data.at("test")) ));
+        logger_.started_test(test);
       } else if(event == "passed_test") {
-        logger_.passed_test(
-          read_test_name( std::move(data.at("test")) ),
-          read_test_output( std::move(data.at("output")) ),
-          read_test_duration( std::move(data.at("duration")) )
-        );
+        logger_.passed_test(test, output, duration);
       } else if(event == "failed_test") {
-        logger_.failed_test(
-          read_test_name( std::move(data.at("test")) ),
-          test_failure::from_bencode( std::move(data.at("failure")) ),
-          read_test_output( std::move(data.at("output")) ),
-          read_test_duration( std::move(data.at("duration")) )
-        );
+        logger_.failed_test(test, failure, output, duration);
+        failures_++;
       } else if(event == "skipped_test") {
-        logger_.skipped_test(read_test_name( std::move(data.at("test")) ),
-                             read_string( std::move(data.at("message"))) );
+        logger_.skipped_test(test, message);
+      } else if(event == "listed_test") {
+        logger_.listed_test(test, attrs);
       } else if(event == "failed_file") {
-        logger_.failed_file(
-          {file_uid_, read_string( std::move(data.at("file_name")) )},
-          read_string( std::move(data.at("message")) )
-        );
+        logger_.failed_file({file_uid_, file_name}, message);
+        failures_++;
+      } else if(event == "ended_run") {
+        ended_runs_++;
       }
     }
-  private:
-    std::vector<suite_name> read_suites(bencode::data &&suites) {
-      std::vector<suite_name> result;
-      for(auto &&i : std::get<bencode::list>(suites)) {
-        auto &data = std::get<bencode::dict>(i);
-        result.emplace_back(
-          read_string( std::move(data.at("suite")) ),
-          read_string( std::move(data.at("file_name")) ),
-          read_line( std::move(data.at("line")) )
-        );
+
+    // Get the next character, or throw if the stream ends first. We peek
+    // before reading so that running out of input doesn't trip the stream's
+    // own exceptions (if any), which would hide what actually went wrong.
+    static char next_char(std::istream &s) {
+      using traits = std::istream::traits_type;
+      if(s.peek() == traits::eof())
+        throw std::runtime_error("unexpected end of event");
+      return traits::to_char_type(s.get());
+    }
+
+    // Read exactly `size` bytes into `data`, or throw if the stream ends
+    // first. Like `next_char`, this avoids setting the stream's failbit.
+    static void read_exactly(std::istream &s, char *data, std::size_t size) {
+      auto want = static_cast<std::streamsize>(size);
+      if(want && s.rdbuf()->sgetn(data, want) != want)
+        throw std::runtime_error("unexpected end of event");
+    }
+
+    static void expect_char(std::istream &s, char expected) {
+      if(next_char(s) != expected)
+        throw std::runtime_error("invalid bencode in event");
+    }
+
+    static std::int64_t read_digits(std::istream &s, char end) {
+      std::int64_t value = 0;
+      bool negative = false, any = false;
+      char c = next_char(s);
+      if(c == '-') {
+        negative = true;
+        c = next_char(s);
       }
-      return result;
+      for(; c != end; c = next_char(s)) {
+        if(c < '0' || c > '9')
+          throw std::runtime_error("invalid bencode in event");
+        value = value * 10 + (c - '0');
+        any = true;
+      }
+      if(!any)
+        throw std::runtime_error("invalid bencode in event");
+      return negative ? -value : value;
     }
 
-    test_name read_test_name(bencode::data &&test) {
-      auto &data = std::get<bencode::dict>(test);
+    static std::int64_t read_integer(std::istream &s) {
+      expect_char(s, 'i');
+      return read_digits(s, 'e');
+    }
 
-      // Make sure every test has a unique ID, even if some files have
-      // overlapping IDs.
-      test_uid id = file_uid_ + static_cast<test_uid>(
-        std::get<bencode::integer>(data.at("id"))
-      );
-      return {
-        id,
-        read_suites( std::move(data.at("suites")) ),
-        read_string( std::move(data.at("test")) ),
-        read_string( std::move(data.at("file_name")) ),
-        read_line( std::move(data.at("line")) )
-      };
+    static void read_string(std::istream &s, std::string &value) {
+      auto size = read_digits(s, ':');
+      if(size < 0)
+        throw std::runtime_error("invalid bencode in event");
+      value.resize(static_cast<std::size_t>(size));
+      read_exactly(s, value.data(), value.size());
     }
 
-    log::test_output read_test_output(bencode::data &&output) {
-      auto &data = std::get<bencode::dict>(output);
-      return log::test_output{
-        read_string( std::move(data.at("stdout_log")) ),
-        read_string( std::move(data.at("stderr_log")) )
-      };
+    template<typename T>
+    static T read_unsigned(std::istream &s) {
+      return static_cast<T>(read_integer(s));
+    }
+
+    template<typename Func>
+    static void read_dict(std::istream &s, Func &&func) {
+      expect_char(s, 'd');
+      std::string key;
+      while(s.peek() != 'e') {
+        read_string(s, key);
+        func(key);
+      }
+      s.get();
+    }
+
+    template<typename Func>
+    static void read_list(std::istream &s, Func &&func) {
+      expect_char(s, 'l');
+      while(s.peek() != 'e')
+        func();
+      s.get();
+    }
+
+    static void skip_value(std::istream &s) {
+      std::string tmp;
+      switch(s.peek()) {
+      case 'i':
+        read_integer(s);
+        break;
+      case 'l':
+        read_list(s, [&s]() { skip_value(s); });
+        break;
+      case 'd':
+        read_dict(s, [&s](const std::string &) { skip_value(s); });
+        break;
+      default:
+        read_string(s, tmp);
+      }
+    }
+
+    static void read_attrs(std::istream &s, log::test_attrs &attrs) {
+      read_dict(s, [&s, &attrs](const std::string &key) {
+        auto &values = attrs[key];
+        read_list(s, [&s, &values]() {
+          std::string value;
+          read_string(s, value);
+          values.insert(std::move(value));
+        });
+      });
+    }
+
+    static void read_suites(std::istream &s, std::vector<suite_name> &suites) {
+      read_list(s, [&s, &suites]() {
+        auto &suite = suites.emplace_back();
+        read_dict(s, [&s, &suite](const std::string &key) {
+          if(key == "suite")
+            read_string(s, suite.name);
+          else if(key == "file_name")
+            read_string(s, suite.file_name);
+          else if(key == "line")
+            suite.line = read_unsigned<std::uint_least32_t>(s);
+          else
+            skip_value(s);
+        });
+      });
+    }
+
+    void read_test_name(std::istream &s, test_name &test) {
+      read_dict(s, [this, &s, &test](const std::string &key) {
+        // Make sure every test has a unique ID, even if some files have
+        // overlapping IDs.
+        if(key == "id")
+          test.id = file_uid_ + read_unsigned<test_uid>(s);
+        else if(key == "suites")
+          read_suites(s, test.suites);
+        else if(key == "test")
+          read_string(s, test.name);
+        else if(key == "file_name")
+          read_string(s, test.file_name);
+        else if(key == "line")
+          test.line = read_unsigned<std::uint_least32_t>(s);
+        else
+          skip_value(s);
+      });
+    }
+
+    static void read_failure(std::istream &s, test_failure &failure) {
+      read_dict(s, [&s, &failure](const std::string &key) {
+        if(key == "desc")
+          read_string(s, failure.desc);
+        else if(key == "message")
+          read_string(s, failure.message);
+        else if(key == "file_name")
+          read_string(s, failure.file_name);
+        else if(key == "line")
+          failure.line = read_unsigned<std::uint_least32_t>(s);
+        else
+          skip_value(s);
+      });
     }
 
-    log::test_duration read_test_duration(bencode::data &&duration) {
-      return log::test_duration(std::get<bencode::integer>(duration));
+    static void read_duration(std::istream &s, log::test_duration &duration) {
+      read_dict(s, [&s, &duration](const std::string &key) {
+        if(key == "wall")
+          duration.wall = std::chrono::nanoseconds(read_integer(s));
+        else if(key == "user")
+          duration.user = std::chrono::nanoseconds(read_integer(s));
+        else if(key == "system")
+          duration.system = std::chrono::nanoseconds(read_integer(s));
+        else
+          skip_value(s);
+      });
     }
 
-    std::string read_string(bencode::data &&message) {
-      return std::move(std::get<bencode::string>(message));
+    static void read_usage(std::istream &s, log::resource_usage &usage) {
+      read_dict(s, [&s, &usage](const std::string &key) {
+        if(key == "max_rss")
+          usage.max_rss = read_unsigned<std::uint64_t>(s);
+        else if(key == "minor_faults")
+          usage.minor_faults = read_unsigned<std::uint64_t>(s);
+        else if(key == "major_faults")
+          usage.major_faults = read_unsigned<std::uint64_t>(s);
+        else if(key == "voluntary_switches")
+          usage.voluntary_switches = read_unsigned<std::uint64_t>(s);
+        else if(key == "involuntary_switches")
+          usage.involuntary_switches = read_unsigned<std::uint64_t>(s);
+        else if(key == "block_inputs")
+          usage.block_inputs = read_unsigned<std::uint64_t>(s);
+        else if(key == "block_outputs")
+          usage.block_outputs = read_unsigned<std::uint64_t>(s);
+        else
+          skip_value(s);
+      });
     }
 
-    std::uint_least32_t read_line(bencode::data &&line) {
-      return static_cast<std::uint_least32_t>(std::get<bencode::integer>(line));
+    static void read_test_output(std::istream &s, log::test_output &output) {
+      read_dict(s, [&s, &output](const std::string &key) {
+        if(key == "stdout_log")
+          read_string(s, output.stdout_log);
+        else if(key == "stderr_log")
+          read_string(s, output.stderr_log);
+        else if(key == "stdout_dropped")
+          output.stdout_dropped = read_unsigned<std::size_t>(s);
+        else if(key == "stderr_dropped")
+          output.stderr_dropped = read_unsigned<std::size_t>(s);
+        else
+          skip_value(s);
+      });
     }
 
     log::file_logger &logger_;
     test_uid file_uid_;
+    bool binary_ = false;
+    std::size_t failures_ = 0;
+    std::size_t ended_runs_ = 0;
+    std::string payload_;
+    std::vector<std::string> files_;
+    std::vector<suite_name> suites_;
   };
 
 } // namespace mettle::log
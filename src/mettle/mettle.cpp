@@ -1,13 +1,18 @@
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <vector>
 
 #include <boost/program_options.hpp>
 
 #include <mettle/driver/cmd_line.hpp>
 #include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/log/binary_child.hpp>
+#include <mettle/driver/log/child.hpp>
 #include <mettle/driver/log/summary.hpp>
 #include <mettle/driver/log/term.hpp>
+#include <mettle/driver/log/test_list.hpp>
 
 #include "run_test_files.hpp"
 
@@ -15,9 +20,25 @@ namespace mettle {
 
   namespace {
     struct all_options : generic_options, driver_options, output_options {
+      std::size_t file_jobs = 1;
+      std::optional<std::string> cache_dir;
+      std::optional<std::string> history_file;
+      bool prune_cache = false;
+      bool persistent = false;
       std::vector<test_command> files;
     };
 
+    // Set an environment variable for the test files we run. Test binaries
+    // ignore variables they don't know about, so this is how we tell them
+    // things that older versions wouldn't understand.
+    void set_child_env(const char *name, const std::string &value) {
+#ifndef _WIN32
+      setenv(name, value.c_str(), 1);
+#else
+      _putenv_s(name, value.c_str());
+#endif
+    }
+
     const char program_name[] = "mettle";
     void report_error(const std::string &message) {
       std::cerr << program_name << ": " << message << std::endl;
@@ -37,6 +58,23 @@ int main(int argc, const char *argv[]) {
   auto driver = make_driver_options(args);
   auto output = make_output_options(args, factory);
 
+  opts::options_description frontend("Front-end options");
+  frontend.add_options()
+    ("file-jobs,J", opts::value(&args.file_jobs)->value_name("N"),
+     "number of test files to run in parallel")
+    ("cache-dir", opts::value(&args.cache_dir)->value_name("DIR"),
+     "cache the results of test files whose tests all pass in DIR, and reuse "
+     "them while the files, arguments, and environment are unchanged")
+    ("prune-cache", opts::value(&args.prune_cache)->zero_tokens(),
+     "remove entries from the --cache-dir for files that have changed")
+    ("history", opts::value(&args.history_file)->value_name("FILE"),
+     "record how long each test file takes in FILE, and use it to start the "
+     "slowest files first")
+    ("persistent", opts::value(&args.persistent)->zero_tokens(),
+     "with --runs, keep each test file running between runs instead of "
+     "starting it anew every time")
+  ;
+
   opts::options_description hidden("Hidden options");
   hidden.add_options()
     ("input-file", opts::value(&args.files), "input file")
@@ -47,7 +85,7 @@ int main(int argc, const char *argv[]) {
   std::vector<std::string> child_args;
   try {
     opts::options_description all;
-    all.add(generic).add(driver).add(output).add(hidden);
+    all.add(generic).add(driver).add(output).add(frontend).add(hidden);
     auto parsed = opts::command_line_parser(argc, argv)
       .options(all).positional(pos).run();
 
@@ -55,6 +93,9 @@ int main(int argc, const char *argv[]) {
     opts::store(parsed, vm);
     opts::notify(vm);
     child_args = filter_options(parsed, driver);
+
+    set_child_env(log::binary::version_env,
+                  std::to_string(log::binary::version));
   } catch(const std::exception &e) {
     report_error(e.what());
     return exit_code::bad_args;
@@ -62,7 +103,7 @@ int main(int argc, const char *argv[]) {
 
   if(args.show_help) {
     opts::options_description displayed;
-    displayed.add(generic).add(driver).add(output);
+    displayed.add(generic).add(driver).add(output).add(frontend);
     std::cout << displayed << std::endl;
     return exit_code::success;
   } else if(args.show_version) {
@@ -70,6 +111,26 @@ int main(int argc, const char *argv[]) {
     return exit_code::success;
   }
 
+  std::optional<result_cache> cache;
+  if(args.cache_dir) {
+    try {
+      cache.emplace(*args.cache_dir);
+      if(args.prune_cache) {
+        auto pruned = cache->prune();
+        if(args.files.empty()) {
+          std::cout << "pruned " << pruned << " cache entries" << std::endl;
+          return exit_code::success;
+        }
+      }
+    } catch(const std::exception &e) {
+      report_error(e.what());
+      return exit_code::unknown_error;
+    }
+  } else if(args.prune_cache) {
+    report_error("--prune-cache requires --cache-dir");
+    return exit_code::bad_args;
+  }
+
   if(args.files.empty()) {
     report_error("no inputs specified");
     return exit_code::no_inputs;
@@ -80,16 +141,69 @@ int main(int argc, const char *argv[]) {
     return exit_code::no_inputs;
   }
 
+  if(args.file_jobs == 0) {
+    report_error("--file-jobs must be at least 1");
+    return exit_code::bad_args;
+  }
+  if(args.persistent && (args.file_jobs > 1 || cache)) {
+    report_error("--persistent can't be used with --file-jobs or --cache-dir");
+    return exit_code::bad_args;
+  }
+#ifdef _WIN32
+  if(args.file_jobs > 1) {
+    report_error("--file-jobs is not supported on Windows");
+    return exit_code::bad_args;
+  }
+  if(args.persistent) {
+    report_error("--persistent is not supported on Windows");
+    return exit_code::bad_args;
+  }
+#endif
+
+  if(args.list) {
+    try {
+      log::test_list logger(std::cout, args.listing_format);
+      run_test_files(args.files, logger, child_args, args.file_jobs);
+
+      for(const auto &[file, message] : logger.failures())
+        report_error(file.name + ": " + message);
+      return logger.good() ? exit_code::success : exit_code::failure;
+    } catch(const std::exception &e) {
+      report_error(e.what());
+      return exit_code::unknown_error;
+    }
+  }
+
   try {
+    std::optional<duration_history> history;
+    if(args.history_file)
+      history.emplace(*args.history_file);
+
     term::enable(std::cout, color_enabled(args.color));
     indenting_ostream out(std::cout);
 
     log::summary logger(
       out, factory.make(args.output, out, args), args.show_time,
-      args.show_terminal
+      args.show_terminal, args.top_usage
     );
-    for(std::size_t i = 0; i != args.runs; i++)
-      run_test_files(args.files, logger, child_args);
+    // Don't have the test files send the output of passing tests if we'd
+    // only throw it away.
+    if(!logger.uses_passing_output())
+      set_child_env(log::passing_output_env, "0");
+
+    // If asked, keep each test file running between runs rather than
+    // starting it up every time.
+    if(args.persistent && args.runs > 1) {
+      run_test_files_repeatedly(args.files, logger, child_args, args.runs,
+                                history ? &*history : nullptr);
+    } else {
+      for(std::size_t i = 0; i != args.runs; i++)
+        run_test_files(args.files, logger, child_args, args.file_jobs,
+                       cache ? &*cache : nullptr,
+                       history ? &*history : nullptr);
+    }
+    if(history)
+      history->save(*args.history_file);
 
     logger.summarize();
     return logger.good() ? exit_code::success : exit_code::failure;
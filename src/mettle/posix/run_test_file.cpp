@@ -1,10 +1,15 @@
 #include "run_test_file.hpp"
 
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <string.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
+#include <cassert>
 #include <cstdint>
 #include <sstream>
 
@@ -14,8 +19,11 @@
 #  pragma clang diagnostic ignored "-Wdeprecated"
 #endif
 
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/device/file_descriptor.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/tee.hpp>
 
 #if defined(__clang__)
 #  pragma clang diagnostic pop
@@ -27,6 +35,8 @@
 
 #include "../../err_string.hpp"
 
+extern char **environ;
+
 #ifdef METTLE_NO_SOURCE_LOCATION
 #  define PARENT_FAILED() parent_failed(                                      \
      ::mettle::detail::source_location::current(__FILE__, __func__, __LINE__) \
@@ -47,28 +57,6 @@ namespace mettle::posix {
       return {false, ss.str()};
     }
 
-    [[noreturn]] void
-    child_failed(int fd, const std::string &file_name) {
-      auto err = err_string(errno);
-
-      try {
-        namespace io = boost::iostreams;
-        io::stream<io::file_descriptor_sink> stream(
-          fd, io::never_close_handle
-        );
-        stream.exceptions(stream.failbit | stream.badbit);
-        bencode::encode(stream, bencode::dict_view{
-          {"event", "failed_file"},
-          {"file_name", file_name},
-          {"message", err}
-        });
-        stream.flush();
-        _exit(exit_code::success);
-      } catch(...) {
-        _exit(exit_code::fatal);
-      }
-    }
-
     std::unique_ptr<char *[]>
     make_argv(const std::vector<std::string> &argv) {
       auto real_argv = std::make_unique<char *[]>(argv.size() + 1);
@@ -79,81 +67,253 @@ namespace mettle::posix {
 
   }
 
-  file_result run_test_file(std::vector<std::string> args, log::pipe &logger) {
-    posix::scoped_pipe message_pipe;
-    if(message_pipe.open() < 0)
+  test_file_process::~test_file_process() {
+    if(pid_) {
+      kill(pid_, SIGKILL);
+      waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  file_result test_file_process::start(std::vector<std::string> args,
+                                       int control_fd) {
+    assert(pid_ == 0);
+    if(message_pipe_.open(O_CLOEXEC) < 0)
       return PARENT_FAILED();
 
     rlimit lim;
     if(getrlimit(RLIMIT_NOFILE, &lim) < 0)
       return PARENT_FAILED();
     int max_fd = lim.rlim_cur - 1;
+    int control_target = max_fd - 1;
 
     args.insert(args.end(), { "--output-fd", std::to_string(max_fd) });
+    if(control_fd >= 0) {
+      args.insert(args.end(), {
+        "--control-fd", std::to_string(control_target)
+      });
+    }
     auto argv = make_argv(args);
 
+    // The message pipe is close-on-exec, so the test file only inherits the
+    // copy we make at `max_fd`. If the pipe is already there, clear
+    // FD_CLOEXEC ourselves, since a dup2 onto itself won't; we close our end
+    // of the pipe before starting anything else, so nothing else can inherit
+    // it in the meantime.
+    posix_spawn_file_actions_t actions;
+    if(int err = posix_spawn_file_actions_init(&actions)) {
+      errno = err;
+      return PARENT_FAILED();
+    }
+
+    int err = 0;
+    if(message_pipe_.write_fd != max_fd) {
+      err = posix_spawn_file_actions_adddup2(
+        &actions, message_pipe_.write_fd, max_fd
+      );
+    } else if(fcntl(max_fd, F_SETFD, 0) < 0) {
+      err = errno;
+    }
+    // The control descriptor (if any) gets the same treatment, just below
+    // the message pipe.
+    if(!err && control_fd >= 0) {
+      if(control_fd != control_target) {
+        err = posix_spawn_file_actions_adddup2(
+          &actions, control_fd, control_target
+        );
+      } else if(fcntl(control_target, F_SETFD, 0) < 0) {
+        err = errno;
+      }
+    }
+    if(err) {
+      posix_spawn_file_actions_destroy(&actions);
+      errno = err;
+      return PARENT_FAILED();
+    }
+
+    // Spawn rather than fork, so that starting a test file doesn't have to
+    // copy our page tables (which grow as the loggers accumulate results).
     pid_t pid;
-    if((pid = fork()) < 0)
+    err = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.get(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if(err)
+      return {false, err_string(err)};
+
+    pid_ = pid;
+    if(message_pipe_.close_write() < 0)
       return PARENT_FAILED();
+    return {true, ""};
+  }
+
+  ssize_t test_file_process::read_events(std::string &buf) {
+    char tmp[BUFSIZ];
+    ssize_t size;
+    do {
+      size = read(message_pipe_.read_fd, tmp, sizeof(tmp));
+    } while(size < 0 && errno == EINTR);
 
-    if(pid == 0) {
-      if(message_pipe.close_read() < 0)
-        child_failed(message_pipe.write_fd, args[0]);
+    if(size > 0)
+      buf.append(tmp, size);
+    return size;
+  }
+
+  file_result test_file_process::wait() {
+    assert(pid_ != 0);
+    message_pipe_.close_read();
 
-      if(message_pipe.write_fd != max_fd) {
-        if(dup2(message_pipe.write_fd, max_fd) < 0)
-          child_failed(message_pipe.write_fd, args[0]);
+    int status;
+    if(waitpid(pid_, &status, 0) < 0)
+      return PARENT_FAILED();
+    pid_ = 0;
+    exit_status_ = -1;
 
-        if(message_pipe.close_write() < 0)
-          child_failed(max_fd, args[0]);
+    if(WIFEXITED(status)) {
+      exit_status_ = WEXITSTATUS(status);
+      if(exit_status_ != exit_code::success) {
+        std::ostringstream ss;
+        ss << "Exited with status " << exit_status_;
+        return {false, ss.str()};
       }
+      return {true, ""};
+    } else { // WIFSIGNALED
+      return {false, strsignal(WTERMSIG(status))};
+    }
+  }
+
+  file_result test_file_process::abort() {
+    auto result = PARENT_FAILED();
+    if(pid_) {
+      kill(pid_, SIGKILL);
+      waitpid(pid_, nullptr, 0);
+      pid_ = 0;
+    }
+    message_pipe_.close_read();
+    return result;
+  }
+
+  persistent_test_file::~persistent_test_file() {
+    if(events_)
+      stop();
+  }
 
-      execvp(argv[0], argv.get());
-      child_failed(max_fd, args[0]);
-    } else {
-      if(message_pipe.close_write() < 0) {
-        kill(pid, SIGKILL);
+  file_result persistent_test_file::run(std::vector<std::string> args,
+                                        const std::vector<test_uid> &ids) {
+    bool starting = !events_;
+    if(starting) {
+      // Use a socket rather than a pipe so that we can write to it without
+      // risking SIGPIPE if the test file has died.
+      int fds[2];
+      if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
         return PARENT_FAILED();
+      control_fd_ = fds[0];
+
+      auto result = proc_.start(std::move(args), fds[1]);
+      close(fds[1]);
+      if(!result.passed) {
+        close(control_fd_);
+        control_fd_ = -1;
+        return result;
       }
 
-      std::exception_ptr except;
+      namespace io = boost::iostreams;
+      auto events = std::make_unique<io::stream<io::file_descriptor_source>>(
+        proc_.read_fd(), io::never_close_handle
+      );
+      events->exceptions(events->failbit | events->badbit);
+      events_ = std::move(events);
+    }
+
+    std::string command = "run";
+    for(auto id : ids)
+      command += " " + std::to_string(id);
+    command += "\n";
+
+    // If we can't send the command, the test file must have exited, so
+    // there's nothing to read; just find out what happened to it.
+    std::optional<std::string> error;
+    auto ended = pipe_.ended_runs();
+    if(send(control_fd_, command.data(), command.size(), MSG_NOSIGNAL) ==
+       static_cast<ssize_t>(command.size())) {
       try {
-        namespace io = boost::iostreams;
-        io::stream<io::file_descriptor_source> fds(
-          message_pipe.read_fd, io::never_close_handle
-        );
-        fds.exceptions(fds.failbit | fds.badbit);
-        while(fds.peek() != EOF)
-          logger(fds);
-      } catch(...) {
-        except = std::current_exception();
+        while(pipe_.ended_runs() == ended && events_->peek() != EOF)
+          pipe_(*events_);
+      } catch(const std::exception &e) {
+        error = e.what();
       }
+      if(pipe_.ended_runs() != ended)
+        return {true, ""};
+    }
 
-      int status;
-      if(waitpid(pid, &status, 0) < 0) {
-        kill(pid, SIGKILL);
-        return PARENT_FAILED();
-      }
+    auto result = stop();
+    // A test file that doesn't know about --control-fd rejects it before
+    // running anything.
+    if(starting && proc_.exit_status() == exit_code::bad_args) {
+      supported_ = false;
+      return {false, "--control-fd not supported"};
+    }
+    if(result.passed)
+      result = {false, error ? *error : "Exited before finishing the run"};
+    return result;
+  }
+
+  file_result persistent_test_file::stop() {
+    // Closing the control socket tells the test file to exit.
+    close(control_fd_);
+    control_fd_ = -1;
+    events_.reset();
+    return proc_.wait();
+  }
+
+  int wait_for_events(const std::vector<test_file_process *> &procs,
+                      std::vector<bool> &ready) {
+    std::vector<pollfd> fds;
+    fds.reserve(procs.size());
+    for(const auto *i : procs)
+      fds.push_back({i->read_fd(), POLLIN, 0});
+
+    int err;
+    do {
+      err = poll(fds.data(), fds.size(), -1);
+    } while(err < 0 && errno == EINTR);
+    if(err < 0)
+      return err;
 
-      if(WIFEXITED(status)) {
-        int exit_status = WEXITSTATUS(status);
-        if(exit_status != exit_code::success) {
-          std::ostringstream ss;
-          ss << "Exited with status " << exit_status;
-          return {false, ss.str()};
-        } else if(except) {
-          try {
-            std::rethrow_exception(except);
-          } catch(const std::exception &e) {
-            return {false, e.what()};
-          }
-        } else {
-          return {true, ""};
-        }
-      } else { // WIFSIGNALED
-        return {false, strsignal(WTERMSIG(status))};
+    ready.assign(procs.size(), false);
+    for(std::size_t i = 0; i != fds.size(); i++)
+      ready[i] = fds[i].revents != 0;
+    return 0;
+  }
+
+  file_result run_test_file(std::vector<std::string> args, log::pipe &logger,
+                            std::string *events) {
+    test_file_process proc;
+    if(auto result = proc.start(std::move(args)); !result.passed)
+      return result;
+
+    std::exception_ptr except;
+    try {
+      namespace io = boost::iostreams;
+      io::filtering_istream fds;
+      if(events)
+        fds.push(io::tee(io::back_inserter(*events)));
+      fds.push(io::file_descriptor_source(
+        proc.read_fd(), io::never_close_handle
+      ));
+      fds.exceptions(fds.failbit | fds.badbit);
+      while(fds.peek() != EOF)
+        logger(fds);
+    } catch(...) {
+      except = std::current_exception();
+    }
+
+    auto result = proc.wait();
+    if(result.passed && except) {
+      try {
+        std::rethrow_exception(except);
+      } catch(const std::exception &e) {
+        return {false, e.what()};
       }
     }
+    return result;
   }
 
 } // namespace mettle::posix
@@ -1,19 +1,106 @@
 #ifndef INC_METTLE_SRC_POSIX_RUN_TEST_FILE_HPP
 #define INC_METTLE_SRC_POSIX_RUN_TEST_FILE_HPP
 
+#include <sys/types.h>
+
+#include <istream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <mettle/driver/posix/scoped_pipe.hpp>
+
 #include "../log_pipe.hpp"
 #include "../run_test_files.hpp"
 
 namespace mettle::posix {
 
-  file_result run_test_file(std::vector<std::string> args, log::pipe &logger);
+  class test_file_process {
+  public:
+    test_file_process() = default;
+    test_file_process(const test_file_process &) = delete;
+    test_file_process & operator =(const test_file_process &) = delete;
+    ~test_file_process();
+
+    // Start the test file, returning a failed result if we couldn't. If
+    // `control_fd` is set, the test file gets a copy of it as its
+    // --control-fd.
+    file_result start(std::vector<std::string> args, int control_fd = -1);
+
+    // Read whatever events are available without blocking, appending them to
+    // `buf`. Returns 0 on EOF and -1 on error.
+    ssize_t read_events(std::string &buf);
+
+    // Wait for the test file to exit and report how it went.
+    file_result wait();
+
+    // The status the test file exited with, or -1 if it was killed by a signal
+    // (or hasn't been waited for).
+    int exit_status() const {
+      return exit_status_;
+    }
+
+    // Kill the test file after an error in the parent, returning a failed
+    // result describing the current `errno`.
+    file_result abort();
+
+    int read_fd() const {
+      return message_pipe_.read_fd;
+    }
+  private:
+    pid_t pid_ = 0;
+    int exit_status_ = -1;
+    scoped_pipe message_pipe_;
+  };
+
+  // A test file that stays running between runs, waiting for us to tell it to
+  // run its tests again (see --control-fd). This way, only the first run has
+  // to pay for starting up the test file.
+  class persistent_test_file {
+  public:
+    persistent_test_file(log::file_logger &logger, test_uid file_uid)
+      : pipe_(logger, file_uid) {}
+    persistent_test_file(const persistent_test_file &) = delete;
+    persistent_test_file & operator =(const persistent_test_file &) = delete;
+    ~persistent_test_file();
+
+    // Run the test file's tests (or just the ones in `ids`), passing its
+    // events to the logger. If the test file isn't running yet, start it with
+    // `args` first. If it exits partway through, this returns a failed result
+    // and the next run starts it up again.
+    file_result run(std::vector<std::string> args,
+                    const std::vector<test_uid> &ids = {});
+
+    // Whether the test file understands --control-fd. Test files built
+    // against older versions of mettle reject it, in which case `run()` fails
+    // without logging anything, and the file should be run the usual way.
+    bool supported() const {
+      return supported_;
+    }
+  private:
+    file_result stop();
+
+    test_file_process proc_;
+    int control_fd_ = -1;
+    bool supported_ = true;
+    log::pipe pipe_;
+    std::unique_ptr<std::istream> events_;
+  };
+
+  // Block until at least one of `procs` has events (or EOF) to read, setting
+  // `ready[i]` for each one that does.
+  int wait_for_events(const std::vector<test_file_process *> &procs,
+                      std::vector<bool> &ready);
+
+  // Run a test file, passing its events to `logger`. If `events` is
+  // non-null, a copy of the raw events is appended to it as well.
+  file_result run_test_file(std::vector<std::string> args, log::pipe &logger,
+                            std::string *events = nullptr);
 
   inline file_result
-  run_test_file(std::vector<std::string> args, log::pipe &&logger) {
-    return run_test_file(std::move(args), logger);
+  run_test_file(std::vector<std::string> args, log::pipe &&logger,
+                std::string *events = nullptr) {
+    return run_test_file(std::move(args), logger, events);
   }
 
 } // namespace mettle::posix
@@ -0,0 +1,308 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string_view>
+
+#include <mettle/detail/hash.hpp>
+
+#ifndef _WIN32
+extern char **environ;
+#endif
+
+namespace mettle {
+
+  namespace fs = std::filesystem;
+
+  namespace {
+    // Bump this whenever the way keys are computed or entries are stored
+    // changes, so that old entries are never used.
+    const char cache_format[] = "mettle result cache 1";
+
+    const char file_hashes_name[] = "file-hashes";
+
+    // Environment variables that don't affect how tests run, but that shells
+    // change all the time.
+    const std::string_view volatile_env[] = {"_", "OLDPWD", "SHLVL"};
+
+#ifndef _WIN32
+    const char path_separator = ':';
+#else
+    const char path_separator = ';';
+#endif
+
+    char ** environment() {
+#ifndef _WIN32
+      return environ;
+#else
+      return _environ;
+#endif
+    }
+
+    std::uint64_t add_string(std::string_view s, std::uint64_t hash) {
+      return detail::fnv1a({"\0", 1}, detail::fnv1a(s, hash));
+    }
+
+    std::string to_hex(std::uint64_t value) {
+      std::ostringstream ss;
+      ss << std::hex << std::setw(16) << std::setfill('0') << value;
+      return ss.str();
+    }
+
+    std::optional<std::uint64_t> from_hex(const std::string &s) {
+      std::uint64_t value;
+      std::istringstream ss(s);
+      if(!(ss >> std::hex >> value))
+        return std::nullopt;
+      return value;
+    }
+
+    std::string absolute_path(const fs::path &path) {
+      std::error_code ec;
+      return fs::absolute(path, ec).lexically_normal().string();
+    }
+
+    bool is_file(const fs::path &path) {
+      std::error_code ec;
+      return fs::is_regular_file(path, ec);
+    }
+
+    // Find the program that running `name` would execute.
+    std::optional<fs::path> find_program(const std::string &name) {
+      if(name.find_first_of("/\\") != std::string::npos) {
+        if(is_file(name))
+          return fs::path(name);
+        return std::nullopt;
+      }
+
+      const char *path = std::getenv("PATH");
+      if(!path)
+        return std::nullopt;
+
+      std::istringstream ss(path);
+      std::string dir;
+      while(std::getline(ss, dir, path_separator)) {
+        auto candidate = fs::path(dir.empty() ? "." : dir) / name;
+        if(is_file(candidate))
+          return candidate;
+      }
+      return std::nullopt;
+    }
+
+    // Write `data` to `path` by way of a temporary file, so that readers
+    // never see it half-written.
+    bool write_atomically(const fs::path &path, std::string_view data) {
+      static std::mt19937_64 rng(std::random_device{}());
+      auto tmp = path;
+      tmp += ".tmp-" + to_hex(rng());
+
+      {
+        std::ofstream out(tmp, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if(!out.flush()) {
+          std::error_code ec;
+          fs::remove(tmp, ec);
+          return false;
+        }
+      }
+
+      std::error_code ec;
+      fs::rename(tmp, path, ec);
+      if(ec) {
+        fs::remove(tmp, ec);
+        return false;
+      }
+      return true;
+    }
+  }
+
+  result_cache::result_cache(fs::path dir) : dir_(std::move(dir)) {
+    fs::create_directories(dir_);
+
+    std::ifstream in(dir_ / file_hashes_name);
+    std::string line;
+    while(std::getline(in, line)) {
+      std::istringstream ss(line);
+      std::string hash;
+      file_hash h;
+      std::string path;
+      if(ss >> hash >> h.size >> h.mtime && ss.get() == ' ' &&
+         std::getline(ss, path)) {
+        if(auto value = from_hex(hash)) {
+          h.hash = *value;
+          file_hashes_[path] = h;
+        }
+      }
+    }
+  }
+
+  std::optional<result_cache::entry>
+  result_cache::lookup(const std::vector<std::string> &args) {
+    entry e = {0, args, {}};
+
+    // The key covers the working directory, the arguments (and any files they
+    // name), and the environment. It doesn't cover the shared libraries the
+    // test file loads; see the docs for `--cache-dir`.
+    std::error_code ec;
+    std::uint64_t hash = add_string(cache_format, detail::fnv1a_basis);
+    hash = add_string(fs::current_path(ec).string(), hash);
+
+    for(std::size_t i = 0; i != args.size(); i++) {
+      hash = add_string(args[i], hash);
+
+      std::optional<fs::path> file;
+      if(i == 0) {
+        if(!(file = find_program(args[i])))
+          return std::nullopt;
+      } else if(is_file(args[i])) {
+        file = args[i];
+      }
+
+      if(file) {
+        auto file_hash = hash_file(*file);
+        if(!file_hash)
+          return std::nullopt;
+        e.files.emplace_back(absolute_path(*file), *file_hash);
+        hash = add_string(to_hex(*file_hash), hash);
+      }
+    }
+
+    std::vector<std::string_view> env;
+    for(char **i = environment(); i && *i; i++) {
+      std::string_view var(*i);
+      auto name = var.substr(0, var.find('='));
+      if(std::find(std::begin(volatile_env), std::end(volatile_env), name) ==
+         std::end(volatile_env))
+        env.push_back(var);
+    }
+    std::sort(env.begin(), env.end());
+    for(auto var : env)
+      hash = add_string(var, hash);
+
+    e.key = hash;
+    return e;
+  }
+
+  std::optional<std::string> result_cache::load(const entry &e) const {
+    auto base = dir_ / to_hex(e.key);
+    if(!is_file(fs::path(base) += ".info"))
+      return std::nullopt;
+
+    std::ifstream in(fs::path(base) += ".events", std::ios::binary);
+    if(!in)
+      return std::nullopt;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return std::move(ss).str();
+  }
+
+  bool result_cache::store(const entry &e, const std::string &events) {
+    std::ostringstream info;
+    info << cache_format << "\n";
+    for(const auto &arg : e.args)
+      info << "arg: " << arg << "\n";
+    for(const auto &[path, hash] : e.files)
+      info << "file: " << to_hex(hash) << " " << path << "\n";
+
+    // Write the events first; an entry only counts once its info exists.
+    auto base = dir_ / to_hex(e.key);
+    bool stored = write_atomically(fs::path(base) += ".events", events) &&
+                  write_atomically(fs::path(base) += ".info", info.view());
+    if(dirty_)
+      save_file_hashes();
+    return stored;
+  }
+
+  std::size_t result_cache::prune() {
+    std::vector<fs::path> stale, orphaned;
+    std::error_code ec;
+    for(const auto &i : fs::directory_iterator(dir_, ec)) {
+      const auto &path = i.path();
+      if(path.extension() == ".info") {
+        std::ifstream in(path);
+        std::string line;
+        bool valid = std::getline(in, line) && line == cache_format;
+        while(valid && std::getline(in, line)) {
+          if(!line.starts_with("file: "))
+            continue;
+          auto space = line.find(' ', 6);
+          if(space == std::string::npos) {
+            valid = false;
+            break;
+          }
+          auto expected = from_hex(line.substr(6, space - 6));
+          auto actual = hash_file(line.substr(space + 1));
+          valid = expected && actual && *expected == *actual;
+        }
+        if(!valid)
+          stale.push_back(path);
+      } else if(path.extension() == ".events") {
+        if(!is_file(fs::path(path).replace_extension(".info")))
+          orphaned.push_back(path);
+      }
+    }
+
+    for(const auto &path : orphaned)
+      fs::remove(path, ec);
+    for(auto &path : stale) {
+      fs::remove(path, ec);
+      fs::remove(path.replace_extension(".events"), ec);
+    }
+
+    for(auto i = file_hashes_.begin(); i != file_hashes_.end();) {
+      if(is_file(i->first)) {
+        ++i;
+      } else {
+        i = file_hashes_.erase(i);
+        dirty_ = true;
+      }
+    }
+    if(dirty_)
+      save_file_hashes();
+    return stale.size();
+  }
+
+  std::optional<std::uint64_t>
+  result_cache::hash_file(const fs::path &path) {
+    std::error_code ec;
+    auto abs_path = absolute_path(path);
+    auto size = fs::file_size(path, ec);
+    if(ec)
+      return std::nullopt;
+    auto mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+    if(ec)
+      return std::nullopt;
+
+    if(auto i = file_hashes_.find(abs_path);
+       i != file_hashes_.end() && i->second.size == size &&
+       i->second.mtime == mtime)
+      return i->second.hash;
+
+    std::ifstream in(path, std::ios::binary);
+    if(!in)
+      return std::nullopt;
+
+    std::uint64_t hash = detail::fnv1a_basis;
+    char buf[64 * 1024];
+    while(in.read(buf, sizeof(buf)) || in.gcount())
+      hash = detail::fnv1a({buf, static_cast<std::size_t>(in.gcount())}, hash);
+
+    file_hashes_[abs_path] = {size, static_cast<std::int64_t>(mtime), hash};
+    dirty_ = true;
+    return hash;
+  }
+
+  void result_cache::save_file_hashes() {
+    std::ostringstream ss;
+    for(const auto &[path, h] : file_hashes_)
+      ss << to_hex(h.hash) << " " << h.size << " " << h.mtime << " " << path
+         << "\n";
+    if(write_atomically(dir_ / file_hashes_name, ss.view()))
+      dirty_ = false;
+  }
+
+} // namespace mettle
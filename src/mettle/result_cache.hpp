@@ -0,0 +1,68 @@
+#ifndef INC_METTLE_SRC_METTLE_RESULT_CACHE_HPP
+#define INC_METTLE_SRC_METTLE_RESULT_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mettle {
+
+  // An on-disk cache of the events sent by test files whose tests all passed,
+  // so that a file can be skipped when neither it, its arguments, nor the
+  // environment have changed since then. Each entry is a pair of files named
+  // after its key: `KEY.events` holds the events as the test file sent them,
+  // and `KEY.info` is a text file listing the arguments and the hashes of the
+  // files that went into the key.
+  class result_cache {
+  public:
+    using key_type = std::uint64_t;
+
+    struct entry {
+      key_type key;
+      std::vector<std::string> args;
+      std::vector<std::pair<std::string, std::uint64_t>> files;
+    };
+
+    result_cache(std::filesystem::path dir);
+
+    // Get the entry for running a test file with `args`. Any argument naming
+    // an existing file (including the program itself, which is looked up in
+    // `PATH` if necessary) contributes the hash of its contents to the key.
+    // Returns nothing if the program can't be found.
+    std::optional<entry> lookup(const std::vector<std::string> &args);
+
+    // Load the events for `e`, if they've been stored.
+    std::optional<std::string> load(const entry &e) const;
+
+    // Store the events for `e`, returning false if they couldn't be written.
+    // Entries are written atomically, so concurrent runs sharing a cache
+    // never see partial entries.
+    bool store(const entry &e, const std::string &events);
+
+    // Remove every entry that refers to a file that has changed or been
+    // removed since the entry was stored. Returns the number removed.
+    std::size_t prune();
+  private:
+    struct file_hash {
+      std::uintmax_t size;
+      std::int64_t mtime;
+      std::uint64_t hash;
+    };
+
+    std::optional<std::uint64_t> hash_file(const std::filesystem::path &path);
+    void save_file_hashes();
+
+    std::filesystem::path dir_;
+    // Hashes of the files we've seen before, so we only need to read a file
+    // again if its size or modification time has changed.
+    std::map<std::string, file_hash> file_hashes_;
+    bool dirty_ = false;
+  };
+
+} // namespace mettle
+
+#endif
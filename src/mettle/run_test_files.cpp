@@ -1,5 +1,14 @@
 #include "run_test_files.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <sstream>
+
 #include "log_pipe.hpp"
 
 #ifndef _WIN32
@@ -12,30 +21,304 @@ namespace platform = mettle::windows;
 
 namespace mettle {
 
-  void run_test_files(
-    const std::vector<test_command> &commands, log::file_logger &logger,
-    const std::vector<std::string> &args
-  ) {
-    using namespace platform;
-    logger.started_run();
-
-    detail::file_uid_maker uid;
-    for(const auto &command : commands) {
-      test_file file = {uid.make_file_uid(), command};
-      logger.started_file(file);
+  namespace {
 
+    std::vector<std::string>
+    make_args(const test_command &command,
+              const std::vector<std::string> &args) {
       std::vector<std::string> final_args = command.args();
       final_args.insert(final_args.end(), args.begin(), args.end());
-      auto result = run_test_file(std::move(final_args),
-                                  log::pipe(logger, file.id));
+      return final_args;
+    }
+
+    // Pass the events that a test file sent earlier along to `pipe`.
+    file_result replay_events(std::string events, log::pipe &pipe) {
+      try {
+        std::istringstream ss(std::move(events));
+        ss.exceptions(ss.failbit | ss.badbit);
+        while(ss.peek() != EOF)
+          pipe(ss);
+      } catch(const std::exception &e) {
+        return {false, e.what()};
+      }
+      return {true, ""};
+    }
+
+    // Record how long a test file took to run, if we're keeping a history.
+    void record_duration(duration_history *history,
+                         const test_command &command,
+                         std::chrono::steady_clock::time_point start) {
+      using namespace std::chrono;
+      if(history) {
+        history->record(command.command(), duration_cast<
+          duration_history::duration
+        >(steady_clock::now() - start));
+      }
+    }
+
+    // Look up the stored events for `entry`, if there are any.
+    std::optional<std::string>
+    load_cached(result_cache *cache,
+                const std::optional<result_cache::entry> &entry) {
+      if(!cache || !entry)
+        return std::nullopt;
+      return cache->load(*entry);
+    }
+
+    void run_serially(
+      const std::vector<test_command> &commands, log::file_logger &logger,
+      const std::vector<std::string> &args, result_cache *cache,
+      duration_history *history
+    ) {
+      using namespace platform;
+
+      detail::file_uid_maker uid;
+      for(const auto &command : commands) {
+        test_file file = {uid.make_file_uid(), command};
+        logger.started_file(file);
+
+        auto final_args = make_args(command, args);
+        std::optional<result_cache::entry> entry;
+        if(cache)
+          entry = cache->lookup(final_args);
 
+        log::pipe pipe(logger, file.id);
+        file_result result;
+        if(auto cached = load_cached(cache, entry)) {
+          result = replay_events(std::move(*cached), pipe);
+        } else {
+          std::string events;
+          auto start = std::chrono::steady_clock::now();
+          result = run_test_file(std::move(final_args), pipe,
+                                 entry ? &events : nullptr);
+          if(result.passed)
+            record_duration(history, command, start);
+          if(entry && result.passed && pipe.failures() == 0)
+            cache->store(*entry, events);
+        }
+
+        if(result.passed)
+          logger.ended_file(file);
+        else
+          logger.failed_file(file, result.message);
+      }
+    }
+
+#ifndef _WIN32
+    struct pending_file {
+      pending_file(test_file file, const test_command &command)
+        : file(std::move(file)), command(command) {}
+
+      test_file file;
+      const test_command &command;
+      posix::test_file_process proc;
+      std::chrono::steady_clock::time_point start_time;
+      std::string events;
+      // The cache entry to store this file's events in once it's done.
+      std::optional<result_cache::entry> to_cache;
+      bool done = false;
+      file_result result = {true, ""};
+    };
+
+    // Replay a finished file's buffered events to the logger so that it shows
+    // up as a single contiguous block, just as if we'd run it serially.
+    void replay_file(pending_file &pending, log::file_logger &logger,
+                     result_cache *cache) {
+      logger.started_file(pending.file);
+
+      auto &result = pending.result;
+      bool cacheable = cache && pending.to_cache && result.passed;
+
+      log::pipe pipe(logger, pending.file.id);
+      auto replayed = replay_events(
+        cacheable ? pending.events : std::move(pending.events), pipe
+      );
       if(result.passed)
-        logger.ended_file(file);
+        result = std::move(replayed);
+
+      if(cacheable && result.passed && pipe.failures() == 0)
+        cache->store(*pending.to_cache, pending.events);
+
+      if(result.passed)
+        logger.ended_file(pending.file);
       else
-        logger.failed_file(file, result.message);
+        logger.failed_file(pending.file, result.message);
+    }
+
+    void run_concurrently(
+      const std::vector<test_command> &commands, log::file_logger &logger,
+      const std::vector<std::string> &args, std::size_t jobs,
+      result_cache *cache, duration_history *history
+    ) {
+      detail::file_uid_maker uid;
+      std::deque<std::unique_ptr<pending_file>> pending;
+      for(const auto &command : commands) {
+        pending.push_back(std::make_unique<pending_file>(
+          test_file{uid.make_file_uid(), command}, command
+        ));
+      }
+
+      // Start the files that took the longest last time first, so that a
+      // slow file doesn't hold up the end of the run. Files with no history
+      // go first of all, since they could take any amount of time. Either
+      // way, files are still reported in their original order.
+      std::vector<pending_file *> order;
+      for(auto &f : pending)
+        order.push_back(f.get());
+      if(history) {
+        std::stable_sort(order.begin(), order.end(), [history](
+          const pending_file *lhs, const pending_file *rhs
+        ) {
+          auto l = history->find(lhs->command.command());
+          auto r = history->find(rhs->command.command());
+          if(!l || !r)
+            return !l && r;
+          return *l > *r;
+        });
+      }
+
+      std::vector<pending_file *> running;
+      std::vector<posix::test_file_process *> procs;
+      std::vector<bool> ready;
+
+      auto finish = [](pending_file &f, file_result result) {
+        f.result = std::move(result);
+        f.done = true;
+      };
+
+      auto next = order.begin();
+      while(!pending.empty()) {
+        while(next != order.end() && running.size() < jobs) {
+          auto &f = **next;
+          auto final_args = make_args(f.command, args);
+          if(cache)
+            f.to_cache = cache->lookup(final_args);
+
+          // Cached files are done right away, so they don't take up a job.
+          if(auto cached = load_cached(cache, f.to_cache)) {
+            f.events = std::move(*cached);
+            f.to_cache.reset();
+            finish(f, {true, ""});
+          } else if(auto result = f.proc.start(std::move(final_args));
+                    result.passed) {
+            f.start_time = std::chrono::steady_clock::now();
+            running.push_back(&f);
+          } else {
+            finish(f, std::move(result));
+          }
+          ++next;
+        }
+
+        while(!pending.empty() && pending.front()->done) {
+          replay_file(*pending.front(), logger, cache);
+          pending.pop_front();
+        }
+        if(running.empty())
+          continue;
+
+        procs.clear();
+        for(auto *f : running)
+          procs.push_back(&f->proc);
+
+        if(posix::wait_for_events(procs, ready) < 0) {
+          int err = errno;
+          for(auto *f : running) {
+            errno = err;
+            finish(*f, f->proc.abort());
+          }
+          running.clear();
+          continue;
+        }
+
+        for(std::size_t i = running.size(); i-- != 0;) {
+          if(!ready[i])
+            continue;
+
+          auto &f = *running[i];
+          if(auto size = f.proc.read_events(f.events); size > 0)
+            continue;
+          else if(size == 0) {
+            finish(f, f.proc.wait());
+            if(f.result.passed)
+              record_duration(history, f.command, f.start_time);
+          } else
+            finish(f, f.proc.abort());
+          running.erase(running.begin() + i);
+        }
+      }
     }
+#endif
+
+  }
+
+  void run_test_files(
+    const std::vector<test_command> &commands, log::file_logger &logger,
+    const std::vector<std::string> &args, std::size_t jobs,
+    result_cache *cache, duration_history *history
+  ) {
+    assert(jobs > 0);
+    logger.started_run();
+
+#ifndef _WIN32
+    if(jobs > 1)
+      run_concurrently(commands, logger, args, jobs, cache, history);
+    else
+      run_serially(commands, logger, args, cache, history);
+#else
+    run_serially(commands, logger, args, cache, history);
+#endif
 
     logger.ended_run();
   }
 
+  void run_test_files_repeatedly(
+    const std::vector<test_command> &commands, log::file_logger &logger,
+    const std::vector<std::string> &args, std::size_t runs,
+    duration_history *history
+  ) {
+#ifndef _WIN32
+    // File UIDs are the same from one run to the next, so each file can keep
+    // its process (and the pipe reading its events) for every run.
+    std::vector<std::unique_ptr<posix::persistent_test_file>> files;
+    detail::file_uid_maker uid;
+    for(std::size_t i = 0; i != commands.size(); i++) {
+      files.push_back(std::make_unique<posix::persistent_test_file>(
+        logger, uid.make_file_uid()
+      ));
+    }
+
+    for(std::size_t run = 0; run != runs; run++) {
+      logger.started_run();
+
+      detail::file_uid_maker uid;
+      for(std::size_t i = 0; i != commands.size(); i++) {
+        const auto &command = commands[i];
+        test_file file = {uid.make_file_uid(), command};
+        logger.started_file(file);
+
+        auto start = std::chrono::steady_clock::now();
+        file_result result;
+        if(files[i]->supported())
+          result = files[i]->run(make_args(command, args));
+        // Older test files can't stay running, so start them anew each time.
+        if(!files[i]->supported()) {
+          result = posix::run_test_file(make_args(command, args),
+                                        log::pipe(logger, file.id));
+        }
+        if(result.passed) {
+          record_duration(history, command, start);
+          logger.ended_file(file);
+        } else {
+          logger.failed_file(file, result.message);
+        }
+      }
+
+      logger.ended_run();
+    }
+#else
+    for(std::size_t run = 0; run != runs; run++)
+      run_test_files(commands, logger, args, 1, nullptr, history);
+#endif
+  }
+
 } // namespace mettle
@@ -4,8 +4,10 @@
 #include <string>
 #include <vector>
 
+#include <mettle/driver/history.hpp>
 #include <mettle/driver/log/core.hpp>
 
+#include "result_cache.hpp"
 #include "test_command.hpp"
 
 namespace mettle {
@@ -15,9 +17,26 @@ namespace mettle {
     std::string message;
   };
 
+  // Run each test file, logging its results to `logger`. If `cache` is
+  // non-null, files with a cached result are replayed from it instead of
+  // being run, and files whose tests all pass are added to it. If `history`
+  // is non-null, the time each file takes is recorded there, and when
+  // running files in parallel, the slowest ones are started first.
   void run_test_files(
     const std::vector<test_command> &commands, log::file_logger &logger,
-    const std::vector<std::string> &args = {}
+    const std::vector<std::string> &args = {}, std::size_t jobs = 1,
+    result_cache *cache = nullptr, duration_history *history = nullptr
+  );
+
+  // Like calling `run_test_files` `runs` times (serially and without a
+  // cache), except that each test file is started only once and then told to
+  // run its tests again (see --control-fd), instead of starting it up anew
+  // for every run. A file that fails is started again on the next run, and a
+  // file that doesn't support --control-fd is simply run anew every time.
+  void run_test_files_repeatedly(
+    const std::vector<test_command> &commands, log::file_logger &logger,
+    const std::vector<std::string> &args, std::size_t runs,
+    duration_history *history = nullptr
   );
 
 } // namespace mettle
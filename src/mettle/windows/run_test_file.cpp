@@ -9,8 +9,10 @@
 #  pragma clang diagnostic ignored "-Wdeprecated"
 #endif
 
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/device/file_descriptor.hpp>
-#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/tee.hpp>
 
 #if defined(__clang__)
 #  pragma clang diagnostic pop
@@ -84,7 +86,8 @@ namespace mettle::windows {
     }
   }
 
-  file_result run_test_file(std::vector<std::string> args, log::pipe &logger) {
+  file_result run_test_file(std::vector<std::string> args, log::pipe &logger,
+                            std::string *events) {
     scoped_pipe message_pipe;
     if(!message_pipe.open())
       return METTLE_FAILED();
@@ -115,9 +118,12 @@ namespace mettle::windows {
     std::exception_ptr except;
     try {
       namespace io = boost::iostreams;
-      io::stream<io::file_descriptor_source> fds(
+      io::filtering_istream fds;
+      if(events)
+        fds.push(io::tee(io::back_inserter(*events)));
+      fds.push(io::file_descriptor_source(
         message_pipe.read_handle.handle(), io::never_close_handle
-      );
+      ));
       fds.exceptions(fds.failbit | fds.badbit);
       while(fds.peek() != EOF)
         logger(fds);
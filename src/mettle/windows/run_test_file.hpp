@@ -9,11 +9,15 @@
 
 namespace mettle::windows {
 
-  file_result run_test_file(std::vector<std::string> args, log::pipe &logger);
+  // Run a test file, passing its events to `logger`. If `events` is
+  // non-null, a copy of the raw events is appended to it as well.
+  file_result run_test_file(std::vector<std::string> args, log::pipe &logger,
+                            std::string *events = nullptr);
 
   inline file_result
-  run_test_file(std::vector<std::string> args, log::pipe &&logger) {
-    return run_test_file(std::move(args), logger);
+  run_test_file(std::vector<std::string> args, log::pipe &&logger,
+                std::string *events = nullptr) {
+    return run_test_file(std::move(args), logger, events);
   }
 
 } // namespace mettle::windows
@@ -156,4 +156,32 @@ inline void failing_test_and_file_run(mettle::log::file_logger &logger) {
   logger.ended_run();
 }
 
+
+inline void usage_run(mettle::log::test_logger &logger) {
+  using namespace std::literals::chrono_literals;
+
+  std::vector<suite_name> suites = {{"suite", "file.cpp", 1}};
+  mettle::detail::file_uid_maker f;
+  mettle::test_uid uid;
+
+  logger.started_run();
+
+  uid = f.make_file_uid();
+  logger.started_suite(suites);
+  logger.started_test({uid + 1, suites, "test 1", "file.cpp", 10});
+  logger.passed_test({uid + 1, suites, "test 1", "file.cpp", 10},
+                     log::test_output{},
+                     {100ms, 60ms, 20ms, {2048, 10, 0, 3, 1, 0, 0}});
+  logger.started_test({uid + 2, suites, "test 2", "file.cpp", 20});
+  logger.failed_test({uid + 2, suites, "test 2", "file.cpp", 20},
+                     {"desc", "error", "file.cpp", 22}, {},
+                     {100ms, 80ms, 10ms, {3 << 20, 20, 2, 4, 2, 8, 16}});
+  logger.started_test({uid + 3, suites, "test 3", "file.cpp", 30});
+  logger.passed_test({uid + 3, suites, "test 3", "file.cpp", 30},
+                     log::test_output{}, 100ms);
+  logger.ended_suite(suites);
+
+  logger.ended_run();
+}
+
 #endif
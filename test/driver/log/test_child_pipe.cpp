@@ -3,8 +3,11 @@ using namespace mettle;
 
 #include "../../helpers.hpp"
 #include "../../../src/mettle/log_pipe.hpp"
+#include <mettle/driver/log/binary_child.hpp>
 #include <mettle/driver/log/child.hpp>
 
+using namespace std::literals::chrono_literals;
+
 struct recording_logger : log::file_logger {
   void started_run() override {
     called = "started_run";
@@ -61,6 +64,13 @@ struct recording_logger : log::file_logger {
     message = actual_message;
   }
 
+  void listed_test(const test_name &actual_test,
+                   const log::test_attrs &actual_attrs) override {
+    called = "listed_test";
+    test = actual_test;
+    attrs = actual_attrs;
+  }
+
   std::string called;
   std::vector<suite_name> suites;
   test_name test;
@@ -68,6 +78,7 @@ struct recording_logger : log::file_logger {
   test_failure failure;
   log::test_output output;
   log::test_duration duration;
+  log::test_attrs attrs;
 };
 
 auto equal_suite_name(const suite_name &expected) {
@@ -95,13 +106,16 @@ auto equal_test_name(const test_name &expected) {
   );
 }
 
+template<typename Child>
 struct fixture {
+  using child_type = Child;
+
   fixture() : pipe(parent, test_uid(1) << 32), child(stream) {}
 
   recording_logger parent;
   std::stringstream stream;
   log::pipe pipe;
-  log::child child;
+  Child child;
 
   std::vector<suite_name> suites = {
     {"suite", "file.cpp", 1}, {"subsuite", "file.cpp", 2}
@@ -109,9 +123,10 @@ struct fixture {
   test_name test = {1, suites, "test", "file.cpp", 10};
 };
 
-suite<fixture> test_child("child/pipe loggers", [](auto &_) {
+suite<fixture<log::child>, fixture<log::binary_child>>
+test_child("child/pipe loggers", [](auto &_) {
 
-  _.test("started_run()", [](fixture &f) {
+  _.test("started_run()", [](auto &f) {
     f.child.started_run();
     f.pipe(f.stream);
 
@@ -119,7 +134,7 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.called, equal_to(""));
   });
 
-  _.test("ended_run()", [](fixture &f) {
+  _.test("ended_run()", [](auto &f) {
     f.child.ended_run();
     f.pipe(f.stream);
 
@@ -127,7 +142,7 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.called, equal_to(""));
   });
 
-  _.test("started_suite()", [](fixture &f) {
+  _.test("started_suite()", [](auto &f) {
     f.child.started_suite(f.suites);
     f.pipe(f.stream);
 
@@ -135,7 +150,7 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.suites, each(f.suites, equal_suite_name));
   });
 
-  _.test("ended_suite()", [](fixture &f) {
+  _.test("ended_suite()", [](auto &f) {
     f.child.ended_suite(f.suites);
     f.pipe(f.stream);
 
@@ -143,7 +158,7 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.suites, each(f.suites, equal_suite_name));
   });
 
-  _.test("started_test()", [](fixture &f) {
+  _.test("started_test()", [](auto &f) {
     f.child.started_test(f.test);
     f.pipe(f.stream);
 
@@ -151,9 +166,10 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.test, equal_test_name(f.test));
   });
 
-  _.test("passed_test()", [](fixture &f) {
+  _.test("passed_test()", [](auto &f) {
     log::test_output output = {"stdout", "stderr"};
-    log::test_duration duration(1000);
+    log::test_duration duration(1234567ns, 800us, 200us,
+                                {3 << 20, 10, 1, 3, 2, 8, 16});
 
     f.child.passed_test(f.test, output, duration);
     f.pipe(f.stream);
@@ -165,10 +181,96 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.duration, equal_to(duration));
   });
 
-  _.test("failed_test()", [](fixture &f) {
+  _.test("passed_test() with dropped output", [](auto &f) {
+    log::test_output output = {"stdout", "stderr", 10, 20};
+    log::test_duration duration(1ms);
+
+    f.child.passed_test(f.test, output, duration);
+    f.pipe(f.stream);
+
+    expect(f.parent.called, equal_to("passed_test"));
+    expect(f.parent.output.stdout_dropped, equal_to(10u));
+    expect(f.parent.output.stderr_dropped, equal_to(20u));
+  });
+
+  _.test("passed_test() without passing output", [](auto &f) {
+    std::stringstream stream;
+    using child_type = typename std::remove_cvref_t<decltype(f)>::child_type;
+    child_type child(stream, false);
+    log::test_output output = {"stdout", "stderr"};
+
+    child.passed_test(f.test, output, log::test_duration(1ms));
+    f.pipe(stream);
+
+    expect(f.parent.called, equal_to("passed_test"));
+    expect(f.parent.output.stdout_log, equal_to(""));
+    expect(f.parent.output.stderr_log, equal_to(""));
+  });
+
+  _.test("listed_test()", [](auto &f) {
+    log::test_attrs attrs = { {"skip", {}}, {"tags", {"a", "b"}} };
+    f.child.listed_test(f.test, attrs);
+    f.pipe(f.stream);
+
+    expect(f.parent.called, equal_to("listed_test"));
+    expect(f.parent.test, equal_test_name(f.test));
+    expect(f.parent.attrs, equal_to(attrs));
+  });
+
+  _.test("batched events", [](auto &f) {
+    std::stringstream stream;
+    using child_type = typename std::remove_cvref_t<decltype(f)>::child_type;
+    child_type child(stream, true, log::flush_policy(1024 * 1024));
+    log::test_output output = {"stdout", "stderr"};
+
+    child.started_suite(f.suites);
+    child.passed_test(f.test, output, log::test_duration(1ms));
+    expect(stream.str(), equal_to(""));
+
+    child.ended_suite(f.suites);
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("started_suite"));
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("passed_test"));
+    expect(f.parent.output.stdout_log, equal_to(output.stdout_log));
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("ended_suite"));
+  });
+
+  _.test("batched events are sent when a test starts", [](auto &f) {
+    std::stringstream stream;
+    using child_type = typename std::remove_cvref_t<decltype(f)>::child_type;
+    child_type child(stream, true, log::flush_policy(1024 * 1024));
+
+    child.skipped_test(f.test, "message");
+    expect(stream.str(), equal_to(""));
+
+    child.started_test(f.test);
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("skipped_test"));
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("started_test"));
+  });
+
+  _.test("batched events are sent at the size limit", [](auto &f) {
+    std::stringstream stream;
+    using child_type = typename std::remove_cvref_t<decltype(f)>::child_type;
+    child_type child(stream, true, log::flush_policy(256));
+
+    child.started_suite(f.suites);
+    expect(stream.str(), equal_to(""));
+    child.skipped_test(f.test, std::string(256, 'x'));
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("started_suite"));
+    f.pipe(stream);
+    expect(f.parent.called, equal_to("skipped_test"));
+  });
+
+  _.test("failed_test()", [](auto &f) {
     test_failure failure = {"desc", "error", "file.cpp", 11};
     log::test_output output = {"stdout", "stderr"};
-    log::test_duration duration(1000);
+    log::test_duration duration(1234567ns, 800us, 200us,
+                                {3 << 20, 10, 1, 3, 2, 8, 16});
 
     f.child.failed_test(f.test, failure, output, duration);
     f.pipe(f.stream);
@@ -183,7 +285,7 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.duration, equal_to(duration));
   });
 
-  _.test("skipped_test()", [](fixture &f) {
+  _.test("skipped_test()", [](auto &f) {
     std::string message = "message";
     f.child.skipped_test(f.test, message);
     f.pipe(f.stream);
@@ -194,3 +296,91 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
   });
 
 });
+
+suite<fixture<log::binary_child>>
+test_binary_pipe("binary pipe protocol", [](auto &_) {
+
+  _.test("definitions are only sent once", [](auto &f) {
+    f.child.started_suite(f.suites);
+    auto first = f.stream.str().size();
+    f.child.ended_suite(f.suites);
+    auto second = f.stream.str().size() - first;
+
+    // Only the first event should include the header and the suites'
+    // definitions.
+    expect(second, less(first));
+
+    f.pipe(f.stream);
+    expect(f.parent.called, equal_to("started_suite"));
+    expect(f.parent.suites, each(f.suites, equal_suite_name));
+
+    f.pipe(f.stream);
+    expect(f.parent.called, equal_to("ended_suite"));
+    expect(f.parent.suites, each(f.suites, equal_suite_name));
+  });
+
+  _.test("unsupported version", [](auto &f) {
+    f.stream.write(log::binary::magic, sizeof(log::binary::magic));
+    f.stream.put(static_cast<char>(log::binary::version + 1));
+    expect([&f]() { f.pipe(f.stream); },
+           thrown<std::runtime_error>("unsupported event protocol version"));
+  });
+
+  _.test("oversized event", [](auto &f) {
+    f.stream.write(log::binary::magic, sizeof(log::binary::magic));
+    f.stream.put(static_cast<char>(log::binary::version));
+    // A passed_test event claiming a 16 GiB payload.
+    f.stream.write("\x08\x80\x80\x80\x80\x40", 6);
+    expect([&f]() { f.pipe(f.stream); },
+           thrown<std::runtime_error>("event too large"));
+  });
+
+  _.test("truncated header", [](auto &f) {
+    f.stream.write(log::binary::magic, sizeof(log::binary::magic) - 1);
+    expect([&f]() { f.pipe(f.stream); },
+           thrown<std::runtime_error>("unexpected end of event"));
+  });
+
+  _.test("truncated event", [](auto &f) {
+    f.child.started_suite(f.suites);
+    auto events = f.stream.str();
+    f.stream.str(events.substr(0, events.size() - 1));
+    // Make sure we report the real problem even if the stream would throw on
+    // its own.
+    f.stream.exceptions(f.stream.failbit | f.stream.badbit);
+    expect([&f]() { f.pipe(f.stream); },
+           thrown<std::runtime_error>("unexpected end of event"));
+  });
+
+});
+
+suite<fixture<log::child>>
+test_bencode_pipe("bencode pipe protocol", [](auto &_) {
+
+  _.test("unknown keys are ignored", [](auto &f) {
+    f.stream << "d5:event13:started_suite5:extrali1ed1:xi2eee"
+                "6:suitesld4:linei1e5:suite5:suiteeee";
+    f.pipe(f.stream);
+
+    expect(f.parent.called, equal_to("started_suite"));
+    expect(f.parent.suites, array(equal_suite_name({"suite", "", 0})));
+  });
+
+  _.test("truncated event", [](auto &f) {
+    f.stream << "d5:event13:started_suite6:suitesld5:suite10:sui";
+    expect([&f]() { f.pipe(f.stream); },
+           thrown<std::runtime_error>("unexpected end of event"));
+  });
+
+  _.test("durations in milliseconds", [](auto &f) {
+    // Older test files only sent the wall-clock time, in milliseconds.
+    f.stream << "d8:durationi1000e5:event11:passed_test"
+                "4:testd2:idi1e4:test4:testee";
+    f.pipe(f.stream);
+
+    expect(f.parent.called, equal_to("passed_test"));
+    expect(f.parent.test.name, equal_to("test"));
+    expect(f.parent.duration, equal_to(log::test_duration(1000ms)));
+  });
+
+});
@@ -1,14 +1,17 @@
 #include <mettle.hpp>
 using namespace mettle;
 
+#include <mettle/driver/log/brief.hpp>
 #include <mettle/driver/log/summary.hpp>
 #include <mettle/driver/log/indent.hpp>
+#include <mettle/driver/log/verbose.hpp>
 
 #include "log_runs.hpp"
 
 struct logger_factory {
-  logger_factory(bool show_time, bool show_terminal)
-    : is(ss), logger(is, nullptr, show_time, show_terminal) {}
+  logger_factory(bool show_time, bool show_terminal,
+                 std::size_t top_usage = 0)
+    : is(ss), logger(is, nullptr, show_time, show_terminal, top_usage) {}
 
   std::ostringstream ss;
   indenting_ostream is;
@@ -347,4 +350,64 @@ suite<> test_summary("summary logger", [](auto &_) {
     });
   });
 
+
+  subsuite<logger_factory>(_, "top usage", bind_factory(false, false, 1),
+                           [](auto &_) {
+    _.test("passing run", [](logger_factory &f) {
+      passing_run(f.logger);
+      f.logger.summarize();
+      expect(f.ss.str(), equal_to(
+        "4/4 tests passed\n"
+      ));
+    });
+
+    _.test("usage run", [](logger_factory &f) {
+      usage_run(f.logger);
+      f.logger.summarize();
+      expect(f.ss.str(), equal_to(
+        "2/3 tests passed\n"
+        "  suite > test 2 FAILED\n"
+        "    desc (file.cpp:22)\n"
+        "    error\n"
+        "\n"
+        "Peak memory use\n"
+        "  suite > test 2 3.0 MiB (2 major page faults, 90 ms CPU)\n"
+      ));
+    });
+  });
+
+  subsuite<logger_factory>(_, "top usage (more than ran)",
+                           bind_factory(false, false, 5), [](auto &_) {
+    _.test("usage run", [](logger_factory &f) {
+      usage_run(f.logger);
+      f.logger.summarize();
+      expect(f.ss.str(), equal_to(
+        "2/3 tests passed\n"
+        "  suite > test 2 FAILED\n"
+        "    desc (file.cpp:22)\n"
+        "    error\n"
+        "\n"
+        "Peak memory use\n"
+        "  suite > test 2 3.0 MiB (2 major page faults, 90 ms CPU)\n"
+        "  suite > test 1 2.0 KiB (0 major page faults, 80 ms CPU)\n"
+      ));
+    });
+  });
+
+  _.test("uses_passing_output()", []() {
+    std::ostringstream ss;
+    indenting_ostream is(ss);
+
+    log::summary none(is, nullptr, false, true);
+    expect(none.uses_passing_output(), equal_to(false));
+
+    log::summary brief(is, std::make_unique<log::brief>(is), false, true);
+    expect(brief.uses_passing_output(), equal_to(false));
+
+    log::summary verbose(
+      is, std::make_unique<log::verbose>(is, 1, false, false), false, false
+    );
+    expect(verbose.uses_passing_output(), equal_to(true));
+  });
+
 });
@@ -0,0 +1,86 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <mettle/driver/log/test_list.hpp>
+
+struct list_fixture {
+  std::ostringstream ss;
+  test_name test = {1, {{"suite", "file.cpp", 1}, {"sub", "file.cpp", 2}},
+                    "test", "file.cpp", 10};
+};
+
+suite<list_fixture> test_test_list("test_list logger", [](auto &_) {
+  subsuite<>(_, "text", [](auto &_) {
+    _.test("no tests", [](list_fixture &f) {
+      log::test_list logger(f.ss, list_format::text);
+      logger.started_run();
+      logger.ended_run();
+      expect(f.ss.str(), equal_to(""));
+    });
+
+    _.test("listed_test()", [](list_fixture &f) {
+      log::test_list logger(f.ss, list_format::text);
+      logger.started_run();
+      logger.listed_test(f.test, {});
+      logger.listed_test(f.test, { {"skip", {}}, {"tags", {"a", "b"}} });
+      logger.ended_run();
+      expect(f.ss.str(), equal_to(
+        "1\tsuite > sub > test\tfile.cpp:10\n"
+        "1\tsuite > sub > test\tfile.cpp:10\tskip tags=a,b\n"
+      ));
+    });
+  });
+
+  subsuite<>(_, "json", [](auto &_) {
+    _.test("no tests", [](list_fixture &f) {
+      log::test_list logger(f.ss, list_format::json);
+      logger.started_run();
+      logger.ended_run();
+      expect(f.ss.str(), equal_to("[]\n"));
+    });
+
+    _.test("listed_test()", [](list_fixture &f) {
+      log::test_list logger(f.ss, list_format::json);
+      logger.started_run();
+      logger.listed_test(f.test, {});
+      logger.started_file({2, "test_file"});
+      logger.listed_test(f.test, { {"tags", {"a", "b"}} });
+      logger.ended_file({2, "test_file"});
+      logger.ended_run();
+      expect(f.ss.str(), equal_to(
+        "[\n"
+        "  {\"id\": 1, \"name\": \"test\", "
+        "\"full_name\": \"suite > sub > test\", \"suites\": [\"suite\", "
+        "\"sub\"], \"file_name\": \"file.cpp\", \"line\": 10, "
+        "\"attributes\": {}},\n"
+        "  {\"id\": 1, \"test_file\": \"test_file\", \"name\": \"test\", "
+        "\"full_name\": \"suite > sub > test\", \"suites\": [\"suite\", "
+        "\"sub\"], \"file_name\": \"file.cpp\", \"line\": 10, "
+        "\"attributes\": {\"tags\": [\"a\", \"b\"]}}\n"
+        "]\n"
+      ));
+    });
+
+    _.test("escaped strings", [](list_fixture &f) {
+      log::test_list logger(f.ss, list_format::json);
+      logger.listed_test({1, {}, "\"q\"\\\n\x01", "file.cpp", 10}, {});
+
+      std::string escaped = "\\\"q\\\"\\\\\\n\\u0001";
+      expect(f.ss.str(), equal_to(
+        "\n  {\"id\": 1, \"name\": \"" + escaped + "\", " +
+        "\"full_name\": \"" + escaped + "\", \"suites\": [], " +
+        "\"file_name\": \"file.cpp\", \"line\": 10, \"attributes\": {}}"
+      ));
+    });
+  });
+
+  _.test("failed_file()", [](list_fixture &f) {
+    log::test_list logger(f.ss, list_format::text);
+    expect(logger.good(), equal_to(true));
+    logger.started_file({2, "test_file"});
+    logger.failed_file({2, "test_file"}, "error");
+    expect(logger.good(), equal_to(false));
+    expect(logger.failures().size(), equal_to(1u));
+    expect(logger.failures()[0].second, equal_to("error"));
+  });
+});
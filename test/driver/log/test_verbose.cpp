@@ -292,6 +292,27 @@ suite<> test_verbose("verbose logger", [](auto &_) {
              equal_to("FAILED (100 ms)\n  desc (file.cpp:11)\n  error\n"));
     });
 
+    _.test("passed_test() with CPU time", [](logger_factory &f) {
+      f.logger.passed_test(
+        {1, {{"suite", "file.cpp", 1}}, "test", "file.cpp", 10}, {},
+        {1234567ns, 1100us, 20us}
+      );
+      expect(f.ss.str(),
+             equal_to("PASSED (1.234 ms, 1.1 ms user, 0.02 ms system)\n"));
+    });
+
+    _.test("passed_test() with resource usage", [](logger_factory &f) {
+      f.logger.passed_test(
+        {1, {{"suite", "file.cpp", 1}}, "test", "file.cpp", 10}, {},
+        {100ms, 60ms, 20ms, {3 << 20, 10, 1, 3, 2, 8, 16}}
+      );
+      expect(f.ss.str(), equal_to(
+        "PASSED (100 ms, 60 ms user, 20 ms system)\n"
+        "  3.0 MiB max RSS, 10 minor/1 major page faults, "
+        "3 voluntary/2 involuntary context switches, 8 blocks in/16 out\n"
+      ));
+    });
+
     _.test("passing run", [](logger_factory &f) {
       passing_run(f.logger);
       expect(f.ss.str(), equal_to(
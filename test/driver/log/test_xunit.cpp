@@ -164,6 +164,50 @@ suite<> test_verbose("xunit logger", [](auto &_) {
         "</testsuites>\n"
       ));
     });
+
+    _.test("usage run", [](logger_factory &f) {
+      usage_run(f.logger);
+      expect(f.ss->str(), equal_to(
+        XML
+        "<testsuites failures=\"1\" skipped=\"0\" tests=\"3\" "
+                    "time=\"0.300000\">\n"
+        "  <testsuite failures=\"1\" file=\"file.cpp\" name=\"suite\" "
+                     "skipped=\"0\" tests=\"3\" time=\"0.300000\">\n"
+        "    <testcase file=\"file.cpp\" line=\"10\" name=\"test 1\" "
+                      "time=\"0.100000\">\n"
+        "      <properties>\n"
+        "        <property name=\"user_time\" value=\"0.060000\"/>\n"
+        "        <property name=\"system_time\" value=\"0.020000\"/>\n"
+        "        <property name=\"max_rss\" value=\"2048\"/>\n"
+        "        <property name=\"minor_faults\" value=\"10\"/>\n"
+        "        <property name=\"major_faults\" value=\"0\"/>\n"
+        "        <property name=\"voluntary_switches\" value=\"3\"/>\n"
+        "        <property name=\"involuntary_switches\" value=\"1\"/>\n"
+        "        <property name=\"block_inputs\" value=\"0\"/>\n"
+        "        <property name=\"block_outputs\" value=\"0\"/>\n"
+        "      </properties>\n"
+        "    </testcase>\n"
+        "    <testcase file=\"file.cpp\" line=\"20\" name=\"test 2\" "
+                      "time=\"0.100000\">\n"
+        "      <properties>\n"
+        "        <property name=\"user_time\" value=\"0.080000\"/>\n"
+        "        <property name=\"system_time\" value=\"0.010000\"/>\n"
+        "        <property name=\"max_rss\" value=\"3145728\"/>\n"
+        "        <property name=\"minor_faults\" value=\"20\"/>\n"
+        "        <property name=\"major_faults\" value=\"2\"/>\n"
+        "        <property name=\"voluntary_switches\" value=\"4\"/>\n"
+        "        <property name=\"involuntary_switches\" value=\"2\"/>\n"
+        "        <property name=\"block_inputs\" value=\"8\"/>\n"
+        "        <property name=\"block_outputs\" value=\"16\"/>\n"
+        "      </properties>\n"
+        "      <failure message=\"desc (file.cpp:22)&#10;error\"/>\n"
+        "    </testcase>\n"
+        "    <testcase file=\"file.cpp\" line=\"30\" name=\"test 3\" "
+                      "time=\"0.100000\"/>\n"
+        "  </testsuite>\n"
+        "</testsuites>\n"
+      ));
+    });
   });
 
   _.test("multiple runs", []() {
@@ -218,6 +218,36 @@ suite<> test_program_options("program_options utilities", [](auto &_) {
     });
   });
 
+  subsuite<>(_, "make_driver_options()", [](auto &_) {
+    _.test("resource limits", []() {
+      driver_options args;
+      auto desc = make_driver_options(args);
+      std::vector<std::string> argv = {
+        "--max-memory=64M", "--max-cpu-time=10", "--max-open-files=32"
+      };
+
+      opts::variables_map vm;
+      opts::store(opts::command_line_parser(argv).options(desc).run(), vm);
+      opts::notify(vm);
+
+      expect(args.limits.memory, equal_to(64u * 1024 * 1024));
+      expect(args.limits.cpu_time, equal_to(std::chrono::seconds(10)));
+      expect(args.limits.open_files, equal_to(32u));
+    });
+
+    _.test("no resource limits", []() {
+      driver_options args;
+      auto desc = make_driver_options(args);
+      std::vector<std::string> argv = {};
+
+      opts::variables_map vm;
+      opts::store(opts::command_line_parser(argv).options(desc).run(), vm);
+      opts::notify(vm);
+
+      expect(args.limits.empty(), equal_to(true));
+    });
+  });
+
   subsuite<>(_, "validate()", [](auto &_) {
     _.test("color_option", []() {
       using namespace boost::program_options;
@@ -320,6 +350,131 @@ suite<> test_program_options("program_options utilities", [](auto &_) {
       );
     });
 
+    _.test("std::chrono::seconds", []() {
+      using s = std::chrono::seconds;
+      using namespace boost::program_options;
+
+      boost::any value;
+      std::vector<std::string> input{"10"};
+      validate(value, input, static_cast<s*>(nullptr), 0);
+      expect(value, any_equal(s(10)));
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"invalid"};
+          validate(value, input, static_cast<s*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('invalid') for option is invalid")
+      );
+    });
+
+    _.test("data_size", []() {
+      using namespace boost::program_options;
+
+      boost::any value;
+      std::vector<std::string> input{"512"};
+      validate(value, input, static_cast<data_size*>(nullptr), 0);
+      expect(value, any_equal(data_size{512}));
+
+      value = boost::any();
+      input = {"64K"};
+      validate(value, input, static_cast<data_size*>(nullptr), 0);
+      expect(value, any_equal(data_size{64 * 1024}));
+
+      value = boost::any();
+      input = {"1M"};
+      validate(value, input, static_cast<data_size*>(nullptr), 0);
+      expect(value, any_equal(data_size{1024 * 1024}));
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"1X"};
+          validate(value, input, static_cast<data_size*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('1X') for option is invalid")
+      );
+    });
+
+    _.test("list_format", []() {
+      using namespace boost::program_options;
+
+      boost::any value;
+      std::vector<std::string> input{"text"};
+      validate(value, input, static_cast<list_format*>(nullptr), 0);
+      expect(value, any_equal(list_format::text));
+
+      value = boost::any();
+      input = {"json"};
+      validate(value, input, static_cast<list_format*>(nullptr), 0);
+      expect(value, any_equal(list_format::json));
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"xml"};
+          validate(value, input, static_cast<list_format*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('xml') for option is invalid")
+      );
+    });
+
+    _.test("test_uid_scheme", []() {
+      using namespace boost::program_options;
+
+      boost::any value;
+      std::vector<std::string> input{"sequential"};
+      validate(value, input, static_cast<test_uid_scheme*>(nullptr), 0);
+      expect(value, any_equal(test_uid_scheme::sequential));
+
+      value = boost::any();
+      input = {"name"};
+      validate(value, input, static_cast<test_uid_scheme*>(nullptr), 0);
+      expect(value, any_equal(test_uid_scheme::name));
+
+      value = boost::any();
+      input = {"location"};
+      validate(value, input, static_cast<test_uid_scheme*>(nullptr), 0);
+      expect(value, any_equal(test_uid_scheme::location));
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"random"};
+          validate(value, input, static_cast<test_uid_scheme*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('random') for option is invalid")
+      );
+    });
+
+    _.test("shard_filter", []() {
+      using namespace boost::program_options;
+
+      boost::any value;
+      std::vector<std::string> input{"1/16"};
+      validate(value, input, static_cast<shard_filter*>(nullptr), 0);
+      expect(value, any_equal(shard_filter{1, 16}));
+
+      value = boost::any();
+      input = {"16/16"};
+      validate(value, input, static_cast<shard_filter*>(nullptr), 0);
+      expect(value, any_equal(shard_filter{16, 16}));
+
+      for(std::string bad : {"0/16", "17/16", "1/0", "1", "a/b"}) {
+        expect(
+          [&bad]() {
+            boost::any value;
+            std::vector<std::string> input{bad};
+            validate(value, input, static_cast<shard_filter*>(nullptr), 0);
+          },
+          thrown<std::exception>(
+            "the argument ('" + bad + "') for option is invalid"
+          )
+        );
+      }
+    });
+
     _.test("std::optional and friends", []() {
       using namespace boost::program_options;
 
@@ -696,3 +696,63 @@ suite<> test_combined_filters("combined filters", [](auto &_) {
     );
   });
 });
+
+suite<> test_shard_filters("shard filters", [](auto &_) {
+  _.test("empty", []() {
+    expect(
+      shard_filter{}({1, suites, "test", "file.cpp", 10}, {}),
+      equal_filter_result({test_action::indeterminate, ""})
+    );
+  });
+
+  _.test("each test is in exactly one shard", []() {
+    for(int i = 0; i != 100; i++) {
+      test_name name = {test_uid(i), suites, "test " + std::to_string(i),
+                        "file.cpp", 10};
+      std::size_t shown = 0;
+      for(std::size_t shard = 1; shard <= 4; shard++) {
+        if(shard_filter{shard, 4}(name, {}).action != test_action::hide)
+          shown++;
+      }
+      expect(shown, equal_to(1u));
+    }
+  });
+
+  _.test("shards don't depend on test IDs", []() {
+    for(std::size_t shard = 1; shard <= 4; shard++) {
+      shard_filter f{shard, 4};
+      expect(f({1, suites, "test", "file.cpp", 10}, {}).action,
+             equal_to(f({2, suites, "test", "other.cpp", 20}, {}).action));
+    }
+  });
+
+  _.test("shards are balanced", []() {
+    std::size_t counts[4] = {};
+    for(int i = 0; i != 1000; i++) {
+      test_name name = {test_uid(i), suites, "test " + std::to_string(i),
+                        "file.cpp", 10};
+      for(std::size_t shard = 1; shard <= 4; shard++) {
+        if(shard_filter{shard, 4}(name, {}).action != test_action::hide)
+          counts[shard - 1]++;
+      }
+    }
+    expect(counts, each(in_interval(200u, 300u)));
+  });
+
+  _.test("filter_set", []() {
+    bool_attr attr("attr", test_action::skip);
+    test_name name = {1, suites, "test", "file.cpp", 10};
+    std::size_t shard = 1;
+    while(shard_filter{shard, 2}(name, {}).action == test_action::hide)
+      shard++;
+
+    expect(
+      filter_set{ {}, {}, {shard, 2} }(name, {attr("message")}),
+      equal_filter_result({test_action::indeterminate, ""})
+    );
+    expect(
+      filter_set{ {}, {}, {3 - shard, 2} }(name, {attr("message")}),
+      equal_filter_result({test_action::hide, ""})
+    );
+  });
+});
@@ -0,0 +1,87 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <fstream>
+#include <sstream>
+
+#include <mettle/driver/history.hpp>
+#include "../temp_dir.hpp"
+
+using namespace std::literals::chrono_literals;
+
+std::string read_file(const std::filesystem::path &path) {
+  std::ifstream in(path);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+suite<> test_history("duration_history", [](auto &_) {
+
+  _.test("record()", []() {
+    duration_history h;
+    expect(h.size(), equal_to(0u));
+    expect(h.find("test"), equal_to(std::nullopt));
+
+    h.record("test", 100us);
+    expect(h.size(), equal_to(1u));
+    expect(h.find("test"), equal_to(100us));
+    expect(h.find("other"), equal_to(std::nullopt));
+
+    h.record("test", 300us);
+    expect(h.find("test"), equal_to(200us));
+  });
+
+  _.test("record() with invalid keys", []() {
+    duration_history h;
+    h.record("", 100us);
+    h.record("multi\nline", 100us);
+    expect(h.size(), equal_to(0u));
+  });
+
+  subsuite<temp_dir>(_, "files", [](auto &_) {
+    _.test("missing file", [](temp_dir &dir) {
+      duration_history h((dir.path / "history").string());
+      expect(h.size(), equal_to(0u));
+    });
+
+    _.test("save and load", [](temp_dir &dir) {
+      auto file = (dir.path / "history").string();
+
+      duration_history h;
+      h.record("suite > test 1", 100us);
+      h.record("suite > test 2", 2500us);
+      h.save(file);
+      expect(read_file(file),
+             equal_to("100 suite > test 1\n2500 suite > test 2\n"));
+      expect(count_files(dir.path, ""), equal_to(1u));
+
+      duration_history loaded(file);
+      expect(loaded.size(), equal_to(2u));
+      expect(loaded.find("suite > test 1"), equal_to(100us));
+      expect(loaded.find("suite > test 2"), equal_to(2500us));
+    });
+
+    _.test("malformed lines", [](temp_dir &dir) {
+      auto file = dir.write("history", "100 good\n"
+                                       "bad\n"
+                                       "-5 negative\n"
+                                       "200\n"
+                                       "300 also good\n");
+
+      duration_history h(file);
+      expect(h.size(), equal_to(2u));
+      expect(h.find("good"), equal_to(100us));
+      expect(h.find("also good"), equal_to(300us));
+    });
+
+    _.test("unwritable file", [](temp_dir &dir) {
+      auto file = (dir.path / "missing" / "history").string();
+      duration_history h;
+      expect([&]() { h.save(file); }, thrown<std::runtime_error>(
+        "unable to write history file \"" + file + "\""
+      ));
+    });
+  });
+
+});
@@ -0,0 +1,82 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <mettle/driver/list_tests.hpp>
+#include "../test_event_logger.hpp"
+
+struct list_logger : test_event_logger {
+  void listed_test(const test_name &test,
+                   const log::test_attrs &attrs) override {
+    events.push_back("listed_test");
+    names.push_back(test.full_name());
+    listed_attrs.push_back(attrs);
+  }
+
+  std::vector<std::string> names;
+  std::vector<log::test_attrs> listed_attrs;
+};
+
+suite<list_logger> test_list_tests("list_tests", [](auto &_) {
+
+  _.test("single suite", [](list_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", []() { expect(true, equal_to(false)); });
+      _.test("test 3", {skip("reason")}, []() {});
+    });
+
+    list_tests(s, logger);
+    expect(logger.events, equal_to(std::vector<std::string>{
+      "started_run", "listed_test", "listed_test", "listed_test", "ended_run"
+    }));
+    expect(logger.names, equal_to(std::vector<std::string>{
+      "inner > test 1", "inner > test 2", "inner > test 3"
+    }));
+    expect(logger.listed_attrs, array(
+      equal_to(log::test_attrs{}), equal_to(log::test_attrs{}),
+      equal_to(log::test_attrs{ {"skip", {"reason"}} })
+    ));
+  });
+
+  _.test("suite with subsuites", [](list_logger &logger) {
+    list_attr tag("tag");
+    auto s = make_suites<>("inner", {tag("outer")}, [&tag](auto &_){
+      _.test("test 1", []() {});
+      subsuite<>(_, "subsuite", [&tag](auto &_) {
+        _.test("sub-test 1", {tag("inner")}, []() {});
+      });
+    });
+
+    list_tests(s, logger);
+    expect(logger.names, equal_to(std::vector<std::string>{
+      "inner > test 1", "inner > subsuite > sub-test 1"
+    }));
+    expect(logger.listed_attrs, array(
+      equal_to(log::test_attrs{ {"tag", {"outer"}} }),
+      equal_to(log::test_attrs{ {"tag", {"inner", "outer"}} })
+    ));
+  });
+
+  _.test("hidden tests", [](list_logger &logger) {
+    bool_attr hide("hide");
+    auto s = make_suites<>("inner", [&hide](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", {hide}, []() {});
+      subsuite<>(_, "subsuite", {hide}, [](auto &_) {
+        _.test("sub-test 1", []() {});
+      });
+    });
+
+    auto filter = [](
+      const test_name &, const attributes &attrs
+    ) -> filter_result {
+      return attrs.find("hide") != attrs.end() ? test_action::hide :
+        test_action::run;
+    };
+    list_tests(s, logger, filter);
+    expect(logger.names, equal_to(std::vector<std::string>{
+      "inner > test 1"
+    }));
+  });
+
+});
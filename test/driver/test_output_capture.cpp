@@ -0,0 +1,53 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <mettle/driver/output_capture.hpp>
+
+suite<> test_output_capture("output_capture", [](auto &_) {
+  _.test("no limit", []() {
+    output_capture capture;
+    capture.append("hello ", 6);
+    capture.append("world", 5);
+    expect(capture.str(), equal_to("hello world"));
+    expect(capture.dropped(), equal_to(0u));
+  });
+
+  _.test("under limit", []() {
+    output_capture capture(16);
+    capture.append("hello ", 6);
+    capture.append("world", 5);
+    expect(capture.str(), equal_to("hello world"));
+    expect(capture.dropped(), equal_to(0u));
+  });
+
+  _.test("over limit in one chunk", []() {
+    output_capture capture(4);
+    capture.append("abcdefgh", 8);
+    expect(capture.str(), equal_to("ab\n[... 4 bytes dropped ...]\ngh"));
+    expect(capture.dropped(), equal_to(4u));
+  });
+
+  _.test("over limit in several chunks", []() {
+    output_capture capture(6);
+    for(char c = 'a'; c != 'k'; c++)
+      capture.append(&c, 1);
+    expect(capture.str(), equal_to("abc\n[... 4 bytes dropped ...]\nhij"));
+    expect(capture.dropped(), equal_to(4u));
+  });
+
+  _.test("wrapping the ring buffer", []() {
+    output_capture capture(8);
+    capture.append("abcdef", 6);
+    capture.append("ghi", 3);
+    capture.append("jklmn", 5);
+    expect(capture.str(), equal_to("abcd\n[... 6 bytes dropped ...]\nklmn"));
+    expect(capture.dropped(), equal_to(6u));
+  });
+
+  _.test("zero limit", []() {
+    output_capture capture(0);
+    capture.append("abc", 3);
+    expect(capture.str(), equal_to("\n[... 3 bytes dropped ...]\n"));
+    expect(capture.dropped(), equal_to(3u));
+  });
+});
@@ -0,0 +1,61 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <mettle/driver/resource_limits.hpp>
+
+using namespace std::literals::chrono_literals;
+
+suite<> test_resource_limits("test_limits()", [](auto &_) {
+  _.test("no attributes", []() {
+    resource_limits defaults = {1024, 10s, 32};
+    expect(test_limits(defaults, {}), equal_to(defaults));
+    expect(test_limits({}, {}).empty(), equal_to(true));
+  });
+
+  _.test("memory_limit", []() {
+    resource_limits defaults = {1024, 10s, 32};
+    auto limits = test_limits(defaults, {memory_limit("64M")});
+    expect(limits, equal_to(resource_limits{64 * 1024 * 1024, 10s, 32}));
+  });
+
+  _.test("cpu_limit", []() {
+    resource_limits defaults = {1024, 10s, 32};
+    auto limits = test_limits(defaults, {cpu_limit("2")});
+    expect(limits, equal_to(resource_limits{1024, 2s, 32}));
+  });
+
+  _.test("open_files_limit", []() {
+    resource_limits defaults = {1024, 10s, 32};
+    auto limits = test_limits(defaults, {open_files_limit("64")});
+    expect(limits, equal_to(resource_limits{1024, 10s, 64}));
+  });
+
+  _.test("all attributes", []() {
+    auto limits = test_limits({}, {
+      memory_limit("1K"), cpu_limit("5"), open_files_limit("16")
+    });
+    expect(limits, equal_to(resource_limits{1024, 5s, 16}));
+  });
+
+  _.test("other attributes", []() {
+    string_attr other("memory_limit");
+    resource_limits defaults = {1024, 10s, 32};
+    expect(test_limits(defaults, {other("64M"), skip}),
+           equal_to(defaults));
+  });
+
+  _.test("invalid values", []() {
+    expect([]() { test_limits({}, {memory_limit("lots")}); },
+           thrown<std::invalid_argument>(
+             "invalid value for memory_limit: \"lots\""
+           ));
+    expect([]() { test_limits({}, {cpu_limit("1.5")}); },
+           thrown<std::invalid_argument>(
+             "invalid value for cpu_limit: \"1.5\""
+           ));
+    expect([]() { test_limits({}, {open_files_limit("")}); },
+           thrown<std::invalid_argument>(
+             "invalid value for open_files_limit: \"\""
+           ));
+  });
+});
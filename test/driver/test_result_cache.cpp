@@ -0,0 +1,90 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <chrono>
+#include <filesystem>
+
+#include "../../src/mettle/result_cache.hpp"
+#include "../temp_dir.hpp"
+
+// Make sure a rewritten file doesn't look unchanged just because it has the
+// same size and modification time as before.
+void touch_later(const std::string &file) {
+  auto time = std::filesystem::last_write_time(file);
+  std::filesystem::last_write_time(file, time + std::chrono::seconds(1));
+}
+
+suite<temp_dir> test_result_cache("result_cache", [](auto &_) {
+
+  _.test("missing program", [](temp_dir &dir) {
+    result_cache cache(dir.path / "cache");
+    expect(cache.lookup({(dir.path / "nonexist").string()}).has_value(),
+           equal_to(false));
+  });
+
+  _.test("store and load", [](temp_dir &dir) {
+    result_cache cache(dir.path / "cache");
+    auto program = dir.write("program", "contents");
+
+    auto entry = cache.lookup({program, "--arg"});
+    expect(entry.has_value(), equal_to(true));
+    expect(cache.load(*entry).has_value(), equal_to(false));
+    expect(entry->files.size(), equal_to(1u));
+
+    expect(cache.store(*entry, "events"), equal_to(true));
+    expect(cache.load(*entry), equal_to("events"));
+
+    result_cache reopened(dir.path / "cache");
+    auto again = reopened.lookup({program, "--arg"});
+    expect(again->key, equal_to(entry->key));
+    expect(reopened.load(*again), equal_to("events"));
+  });
+
+  _.test("key depends on arguments", [](temp_dir &dir) {
+    result_cache cache(dir.path / "cache");
+    auto program = dir.write("program", "contents");
+
+    auto key = cache.lookup({program, "--arg"})->key;
+    expect(cache.lookup({program})->key, not_equal_to(key));
+    expect(cache.lookup({program, "--other"})->key, not_equal_to(key));
+  });
+
+  _.test("key depends on file contents", [](temp_dir &dir) {
+    result_cache cache(dir.path / "cache");
+    auto program = dir.write("program", "contents");
+    auto data = dir.write("data", "data");
+
+    auto program_key = cache.lookup({program})->key;
+    auto data_key = cache.lookup({program, data})->key;
+
+    dir.write("data", "new data");
+    touch_later(data);
+    expect(cache.lookup({program})->key, equal_to(program_key));
+    expect(cache.lookup({program, data})->key, not_equal_to(data_key));
+
+    dir.write("program", "new contents");
+    touch_later(program);
+    expect(cache.lookup({program})->key, not_equal_to(program_key));
+  });
+
+  _.test("prune", [](temp_dir &dir) {
+    result_cache cache(dir.path / "cache");
+    auto program = dir.write("program", "contents");
+    auto data = dir.write("data", "data");
+
+    cache.store(*cache.lookup({program}), "events 1");
+    cache.store(*cache.lookup({program, data}), "events 2");
+    expect(cache.prune(), equal_to(0u));
+
+    dir.write("data", "new data");
+    touch_later(data);
+    expect(cache.prune(), equal_to(1u));
+    expect(cache.load(*cache.lookup({program})), equal_to("events 1"));
+
+    std::filesystem::remove(program);
+    expect(cache.prune(), equal_to(1u));
+    expect(count_files(dir.path / "cache", ".info"), equal_to(0u));
+    expect(count_files(dir.path / "cache", ".events"), equal_to(0u));
+  });
+
+});
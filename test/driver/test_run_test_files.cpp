@@ -16,6 +16,7 @@ namespace platform = mettle::windows;
 std::string pathsep = "\\";
 #endif
 
+#include "../temp_dir.hpp"
 #include "../test_event_logger.hpp"
 
 struct logger_factory {
@@ -71,6 +72,12 @@ suite<> test_run_file("run files", [](auto &_) {
       expect(run_test_file({test_data("test_abort")}, f.pipe), passed(false));
       expect(f.logger.events, array());
     });
+
+    _.test("missing file", [](logger_factory &f) {
+      expect(run_test_file({test_data("nonexistent")}, f.pipe),
+             passed(false));
+      expect(f.logger.events, array());
+    });
   });
 
   subsuite<test_event_logger>(_, "run_test_files()", [](auto &_) {
@@ -97,6 +104,13 @@ suite<> test_run_file("run files", [](auto &_) {
       ));
     });
 
+    _.test("missing file", [](test_event_logger &logger) {
+      run_test_files({test_data("nonexistent")}, logger);
+      expect(logger.events, array(
+        "started_run", "started_file", "failed_file", "ended_run"
+      ));
+    });
+
     _.test("multiple files", [](test_event_logger &logger) {
       run_test_files({
         test_data("test_pass"), test_data("test_fail"), test_data("test_abort")
@@ -114,6 +128,29 @@ suite<> test_run_file("run files", [](auto &_) {
       ));
     });
 
+    _.test("multiple files in parallel", [](test_event_logger &logger) {
+      run_test_files({
+        test_data("test_fail"), test_data("test_abort"), test_data("test_pass"),
+        test_data("test_pass")
+      }, logger, {}, 3);
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+        "ended_run"
+      ));
+      expect(logger.files.size(), equal_to(4));
+      expect(logger.tests.size(), equal_to(3));
+    });
+
     _.test("multiple runs", [](test_event_logger &logger) {
       for(int i = 0; i != 2; i++) {
         run_test_files({
@@ -145,5 +182,149 @@ suite<> test_run_file("run files", [](auto &_) {
       expect(logger.files.size(), equal_to(3));
       expect(logger.tests.size(), equal_to(2));
     });
+
+#ifndef _WIN32
+    _.test("unsupported file", [](test_event_logger &logger) {
+      // Act like an older test file that rejects --control-fd, but otherwise
+      // runs normally.
+      run_test_files_repeatedly({
+        "/bin/sh -c 'for a; do test \"$a\" = --control-fd && exit 64; done; "
+        "exec " + test_data("test_pass") + " \"$@\"' sh"
+      }, logger, {}, 2);
+
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+        "ended_run",
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+        "ended_run"
+      ));
+    });
+#endif
+  });
+
+#ifndef _WIN32
+  subsuite<test_event_logger>(_, "persistent_test_file", [](auto &_) {
+    _.test("multiple runs", [](test_event_logger &logger) {
+      persistent_test_file file(logger, 0);
+      expect(file.run({test_data("test_pass")}), passed(true));
+      expect(file.run({test_data("test_pass")}), passed(true));
+      expect(logger.events, array(
+        "started_suite", "started_test", "passed_test", "ended_suite",
+        "started_suite", "started_test", "passed_test", "ended_suite"
+      ));
+    });
+
+    _.test("selected tests", [](test_event_logger &logger) {
+      persistent_test_file file(logger, 0);
+      expect(file.run({test_data("test_pass")}, {12345}), passed(true));
+      expect(logger.events, array());
+      expect(file.run({test_data("test_pass")}), passed(true));
+      expect(logger.events, array(
+        "started_suite", "started_test", "passed_test", "ended_suite"
+      ));
+    });
+
+    _.test("aborting file", [](test_event_logger &logger) {
+      persistent_test_file file(logger, 0);
+      expect(file.run({test_data("test_abort")}), passed(false));
+      expect(file.run({test_data("test_abort")}), passed(false));
+      expect(logger.events, array());
+    });
+
+    _.test("missing file", [](test_event_logger &logger) {
+      persistent_test_file file(logger, 0);
+      expect(file.run({test_data("nonexistent")}), passed(false));
+      expect(file.supported(), equal_to(true));
+      expect(logger.events, array());
+    });
+
+    _.test("unsupported file", [](test_event_logger &logger) {
+      // Act like an older test file that rejects --control-fd.
+      persistent_test_file file(logger, 0);
+      expect(file.run({"/bin/sh", "-c", "exit 64"}), passed(false));
+      expect(file.supported(), equal_to(false));
+      expect(logger.events, array());
+    });
+  });
+#endif
+
+  subsuite<test_event_logger>(_, "run_test_files_repeatedly()", [](auto &_) {
+    _.test("multiple runs", [](test_event_logger &logger) {
+      run_test_files_repeatedly({
+        test_data("test_pass"), test_data("test_fail"), test_data("test_abort")
+      }, logger, {}, 2);
+
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+        "ended_run",
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+        "ended_run"
+      ));
+      expect(logger.files.size(), equal_to(3));
+      expect(logger.tests.size(), equal_to(2));
+    });
+  });
+
+  subsuite<temp_dir>(_, "run_test_files() with a result cache", [](auto &_) {
+    for(std::size_t jobs : {1, 2}) {
+      std::string suffix = jobs == 1 ? "" : " in parallel";
+
+      _.test("passing file" + suffix, [jobs](temp_dir &dir) {
+        result_cache cache(dir.path);
+        std::vector<test_command> files = {test_data("test_pass")};
+        std::vector<std::string> expected = {
+          "started_run", "started_file", "started_suite", "started_test",
+          "passed_test", "ended_suite", "ended_file", "ended_run"
+        };
+
+        test_event_logger first;
+        run_test_files(files, first, {}, jobs, &cache);
+        expect(first.events, equal_to(expected));
+        expect(count_files(dir.path, ".info"), equal_to(1u));
+
+        test_event_logger second;
+        run_test_files(files, second, {}, jobs, &cache);
+        expect(second.events, equal_to(expected));
+
+        // Make sure the second run really came from the cache.
+        for(const auto &i : std::filesystem::directory_iterator(dir.path)) {
+          if(i.path().extension() == ".events")
+            std::ofstream(i.path(), std::ios::binary);
+        }
+        test_event_logger third;
+        run_test_files(files, third, {}, jobs, &cache);
+        expect(third.events, array(
+          "started_run", "started_file", "ended_file", "ended_run"
+        ));
+      });
+
+      _.test("failing files" + suffix, [jobs](temp_dir &dir) {
+        result_cache cache(dir.path);
+        test_event_logger logger;
+        run_test_files({test_data("test_fail"), test_data("test_abort")},
+                       logger, {}, jobs, &cache);
+        expect(count_files(dir.path, ".info"), equal_to(0u));
+      });
+    }
   });
 });
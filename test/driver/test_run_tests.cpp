@@ -4,6 +4,41 @@ using namespace mettle;
 #include <mettle/driver/run_tests.hpp>
 #include "../test_event_logger.hpp"
 
+// Hold onto tests until there are `jobs` of them, then finish them in reverse
+// order.
+struct backwards_runner : concurrent_test_runner {
+  backwards_runner(std::size_t jobs) : jobs(jobs) {}
+
+  void start(const test_info &test, callback_type done) override {
+    if(running.size() == jobs)
+      wait();
+    running.emplace_back(&test, std::move(done));
+  }
+
+  void wait() override {
+    while(!running.empty()) {
+      auto [test, done] = std::move(running.back());
+      running.pop_back();
+      done(test->function(), {}, {});
+    }
+  }
+
+  std::size_t jobs;
+  std::vector<std::pair<const test_info *, callback_type>> running;
+};
+
+// Record the order tests are started in, finishing each one immediately.
+struct recording_runner : concurrent_test_runner {
+  void start(const test_info &test, callback_type done) override {
+    started.push_back(test.name);
+    done(test.function(), {}, {});
+  }
+
+  void wait() override {}
+
+  std::vector<std::string> started;
+};
+
 suite<test_event_logger> test_run_tests("run_tests", [](auto &_) {
 
   _.test("single suite", [](test_event_logger &logger) {
@@ -133,4 +168,87 @@ suite<test_event_logger> test_run_tests("run_tests", [](auto &_) {
     expect(logger.events, equal_to(expected));
   });
 
+  _.test("concurrent runner", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", []() { expect(true, equal_to(false)); });
+      _.test("test 3", {skip}, []() {});
+      _.test("test 4", []() {});
+      subsuite<>(_, "subsuite", [](auto &_) {
+        _.test("sub-test 1", []() { expect(true, equal_to(false)); });
+        _.test("sub-test 2", []() {});
+      });
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "skipped_test",
+        "started_test",
+        "passed_test",
+        "started_suite",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "passed_test",
+        "ended_suite",
+      "ended_suite",
+      "ended_run"
+    };
+
+    backwards_runner runner(2);
+    run_tests(s, logger, runner);
+    expect(logger.events, equal_to(expected));
+  });
+
+  _.test("concurrent runner with estimates", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", []() { expect(true, equal_to(false)); });
+      _.test("test 3", []() {});
+      _.test("test 4", []() {});
+      _.test("test 5", []() {});
+    });
+
+    auto estimate = [](const test_name &name)
+      -> std::optional<std::chrono::microseconds> {
+      if(name.name == "test 1")
+        return std::chrono::microseconds(10);
+      if(name.name == "test 2")
+        return std::chrono::microseconds(30);
+      if(name.name == "test 4")
+        return std::chrono::microseconds(20);
+      return std::nullopt;
+    };
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    recording_runner runner;
+    run_tests(s, logger, runner, default_filter{}, estimate);
+    expect(runner.started, array(
+      "test 3", "test 5", "test 2", "test 4", "test 1"
+    ));
+    expect(logger.events, equal_to(expected));
+  });
+
 });
@@ -0,0 +1,116 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <set>
+
+#include <mettle/driver/test_uids.hpp>
+
+std::vector<test_uid> all_uids(const suites_list &suites) {
+  std::vector<test_uid> result;
+  for(const auto &suite : suites) {
+    for(const auto &test : suite.tests())
+      result.push_back(test.id);
+    auto sub = all_uids(suite.subsuites());
+    result.insert(result.end(), sub.begin(), sub.end());
+  }
+  return result;
+}
+
+suites_list make_first() {
+  return {make_suite<>("first", [](auto &_) {
+    _.test("test 1", []() {});
+    _.test("test 2", []() {});
+    subsuite<>(_, "subsuite", [](auto &_) {
+      _.test("test 1", []() {});
+    });
+  })};
+}
+
+suites_list make_second() {
+  return {make_suite<>("second", [](auto &_) {
+    _.test("test 1", []() {});
+  })};
+}
+
+suite<> test_test_uids("assign_test_uids()", [](auto &_) {
+
+  _.test("sequential", []() {
+    auto s = make_first();
+    auto before = all_uids(s);
+    assign_test_uids(s, test_uid_scheme::sequential);
+    expect(all_uids(s), equal_to(before));
+  });
+
+  for(auto scheme : {test_uid_scheme::name, test_uid_scheme::location}) {
+    std::string scheme_name = scheme == test_uid_scheme::name ? "name"
+                                                              : "location";
+
+    _.test(scheme_name + " gives unique 32-bit IDs", [scheme]() {
+      auto s = make_first();
+      assign_test_uids(s, scheme);
+
+      auto uids = all_uids(s);
+      expect(uids, each(all(
+        greater(0u), less(0xffffffffu)
+      )));
+      expect(std::set<test_uid>(uids.begin(), uids.end()).size(),
+             equal_to(uids.size()));
+    });
+
+    _.test(scheme_name + " doesn't depend on registration order", [scheme]() {
+      auto a = make_first();
+      auto b = make_second();
+      assign_test_uids(a, scheme);
+      assign_test_uids(b, scheme);
+
+      auto both = make_second();
+      auto first = make_first();
+      both.insert(both.end(), first.begin(), first.end());
+      assign_test_uids(both, scheme);
+
+      auto expected = all_uids(b);
+      auto a_uids = all_uids(a);
+      expected.insert(expected.end(), a_uids.begin(), a_uids.end());
+      expect(all_uids(both), equal_to(expected));
+    });
+  }
+
+  _.test("hash collisions", []() {
+    // These two names hash to the same 32-bit ID.
+    auto make_colliding = [](const char *first, const char *second) {
+      return suites_list{make_suite<>("s", [=](auto &_) {
+        _.test(first, []() {});
+        _.test(second, []() {});
+      })};
+    };
+
+    auto s = make_colliding("test 55715", "test 72040");
+    assign_test_uids(s, test_uid_scheme::name);
+    expect(all_uids(s), array(262615141u, 262615142u));
+
+    s = make_colliding("test 72040", "test 55715");
+    assign_test_uids(s, test_uid_scheme::name);
+    expect(all_uids(s), array(262615141u, 262615142u));
+  });
+
+  _.test("name collisions", []() {
+    auto make_dupes = []() {
+      return suites_list{make_suite<>("suite", [](auto &_) {
+        _.test("test", []() {});
+        _.test("test", []() {});
+      })};
+    };
+
+    auto s = make_dupes();
+    expect([&s]() { assign_test_uids(s, test_uid_scheme::name); },
+           thrown<std::runtime_error>(
+             "tests \"suite > test\" and \"suite > test\" have the same ID"
+           ));
+
+    s = make_dupes();
+    assign_test_uids(s, test_uid_scheme::location);
+    auto uids = all_uids(s);
+    expect(uids[0], not_equal_to(uids[1]));
+  });
+
+});
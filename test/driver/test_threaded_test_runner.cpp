@@ -0,0 +1,197 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <mettle/driver/threaded_test_runner.hpp>
+#include "../test_event_logger.hpp"
+
+using namespace std::literals::chrono_literals;
+
+namespace {
+  // Wait (up to a point) for `count` to reach `value`, returning the last
+  // value we saw.
+  int wait_for(const std::atomic<int> &count, int value) {
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while(count < value && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(1ms);
+    return count;
+  }
+}
+
+suite<test_event_logger> test_threaded_runner("threaded_test_runner", [](
+  auto &_
+) {
+  _.test("runs thread-safe tests in parallel", [](test_event_logger &logger) {
+    std::atomic<int> arrived = 0, seen = 0;
+    auto s = make_suites<>("inner", [&](auto &_) {
+      for(auto name : {"test 1", "test 2"}) {
+        _.test(name, {thread_safe}, [&]() {
+          arrived++;
+          seen = std::max(seen.load(), wait_for(arrived, 2));
+        });
+      }
+    });
+
+    threaded_test_runner runner(2);
+    run_tests(s, logger, runner);
+    expect(seen.load(), equal_to(2));
+  });
+
+  _.test("runs other tests by themselves", [](test_event_logger &logger) {
+    std::atomic<int> active = 0, most = 0;
+    auto track = [&]() {
+      most = std::max(most.load(), ++active);
+      std::this_thread::sleep_for(10ms);
+      active--;
+    };
+    std::atomic<int> most_with_other = 0;
+    auto s = make_suites<>("inner", [&](auto &_) {
+      _.test("test 1", {thread_safe}, track);
+      _.test("test 2", {thread_safe}, track);
+      _.test("test 3", [&]() {
+        most_with_other = ++active;
+        std::this_thread::sleep_for(10ms);
+        active--;
+      });
+      _.test("test 4", {thread_safe}, track);
+    });
+
+    threaded_test_runner runner(4);
+    run_tests(s, logger, runner);
+    expect(most_with_other.load(), equal_to(1));
+    expect(most.load(), all(greater_equal(1), less_equal(3)));
+  });
+
+  _.test("all_thread_safe", [](test_event_logger &logger) {
+    std::atomic<int> arrived = 0, seen = 0;
+    auto s = make_suites<>("inner", [&](auto &_) {
+      for(auto name : {"test 1", "test 2"}) {
+        _.test(name, [&]() {
+          arrived++;
+          seen = std::max(seen.load(), wait_for(arrived, 2));
+        });
+      }
+    });
+
+    threaded_test_runner runner(2, true);
+    run_tests(s, logger, runner);
+    expect(seen.load(), equal_to(2));
+  });
+
+  _.test("reports results in order", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", {thread_safe}, [](auto &_) {
+      _.test("test 1", []() { std::this_thread::sleep_for(50ms); });
+      _.test("test 2", []() { expect(true, equal_to(false)); });
+      _.test("test 3", {skip}, []() {});
+      _.test("test 4", []() { throw std::runtime_error("oops"); });
+      subsuite<>(_, "subsuite", [](auto &_) {
+        _.test("sub-test 1", []() { std::this_thread::sleep_for(20ms); });
+        _.test("sub-test 2", []() {});
+      });
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "skipped_test",
+        "started_test",
+        "failed_test",
+        "started_suite",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "passed_test",
+        "ended_suite",
+      "ended_suite",
+      "ended_run"
+    };
+
+    threaded_test_runner runner(3);
+    run_tests(s, logger, runner);
+    expect(logger.events, equal_to(expected));
+  });
+
+  _.test("captures failures", [](test_event_logger &) {
+    auto s = make_suites<>("inner", [](auto &_) {
+      _.test("test 1", []() { throw std::runtime_error("oops"); });
+      _.test("test 2", []() {});
+    });
+    auto &tests = s[0].tests();
+
+    std::vector<std::string> messages(2);
+    std::vector<bool> failed(2);
+    threaded_test_runner runner(2, true);
+    for(std::size_t i = 0; i != tests.size(); i++) {
+      runner.start(tests[i], [&, i](const test_result &result,
+                                    const log::test_output &,
+                                    log::test_duration) {
+        failed[i] = bool(result);
+        if(result)
+          messages[i] = result->message;
+      });
+    }
+    runner.wait();
+
+    expect(failed, array(true, false));
+    expect(messages, array(
+      "Uncaught exception: std::runtime_error(\"oops\")", ""
+    ));
+  });
+
+  _.test("times out tests", [](test_event_logger &) {
+    // The stuck test keeps running after it times out, so make sure it's let
+    // go (and has finished) before we leave.
+    std::atomic<int> stuck = 0;
+    auto s = make_suites<>("inner", {thread_safe}, [&](auto &_) {
+      _.test("test 1", {timeout(20ms)}, [&]() {
+        wait_for(stuck, 1);
+        stuck = 2;
+      });
+      _.test("test 2", []() {});
+      _.test("test 3", []() {});
+    });
+    auto &tests = s[0].tests();
+
+    std::vector<std::string> messages(3);
+    std::vector<bool> failed(3);
+    bool timed_out;
+    {
+      threaded_test_runner runner(1);
+      auto start = [&](std::size_t i) {
+        runner.start(tests[i], [&, i](const test_result &result,
+                                      const log::test_output &,
+                                      log::test_duration) {
+          failed[i] = bool(result);
+          if(result)
+            messages[i] = result->message;
+        });
+      };
+
+      // Test 2 is waiting its turn when test 1 times out, and test 3 is only
+      // started afterwards.
+      start(0);
+      start(1);
+      runner.wait();
+      start(2);
+      runner.wait();
+      timed_out = runner.timed_out();
+    }
+
+    stuck = 1;
+    expect(wait_for(stuck, 2), equal_to(2));
+    expect(timed_out, equal_to(true));
+    expect(failed, array(true, true, true));
+    expect(messages, array(
+      "Timed out after 20 ms", "Not run: an earlier test timed out",
+      "Not run: an earlier test timed out"
+    ));
+  });
+});
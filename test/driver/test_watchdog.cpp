@@ -0,0 +1,162 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <mettle/driver/watchdog.hpp>
+#include "../test_event_logger.hpp"
+
+using namespace std::literals::chrono_literals;
+
+namespace {
+  struct failure_logger : test_event_logger {
+    void failed_test(const test_name &test, const test_failure &failure,
+                     const log::test_output &output,
+                     log::test_duration duration) override {
+      test_event_logger::failed_test(test, failure, output, duration);
+      messages.push_back(failure.message);
+    }
+
+    std::vector<std::string> messages;
+  };
+
+  // Keep a test busy until the watchdog has given up on it (or we have).
+  void wait_for(const std::atomic<bool> &flag) {
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while(!flag && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(1ms);
+  }
+
+  template<typename Suites>
+  void run_watched(const Suites &suites, watchdog &dog) {
+    run_tests(suites, dog, [&dog](const test_info &test, log::test_output &) {
+      return dog.run(test);
+    }, default_filter{});
+  }
+}
+
+suite<failure_logger> test_watchdog("watchdog", [](auto &_) {
+  _.test("passes events through", [](failure_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_) {
+      _.test("test 1", []() {});
+      _.test("test 2", []() { expect(true, equal_to(false)); });
+      _.test("test 3", {skip}, []() {});
+    });
+
+    bool timed_out = false;
+    {
+      watchdog dog(logger, 10s, [&timed_out]() { timed_out = true; });
+      run_watched(s, dog);
+    }
+
+    expect(timed_out, equal_to(false));
+    expect(logger.events, array(
+      "started_run", "started_suite",
+      "started_test", "passed_test",
+      "started_test", "failed_test",
+      "started_test", "skipped_test",
+      "ended_suite", "ended_run"
+    ));
+  });
+
+  _.test("timeout", [](failure_logger &logger) {
+    std::atomic<bool> timed_out = false;
+    auto s = make_suites<>("inner", [&timed_out](auto &_) {
+      _.test("test 1", []() {});
+      _.test("test 2", [&timed_out]() { wait_for(timed_out); });
+      _.test("test 3", []() {});
+    });
+
+    {
+      watchdog dog(logger, 10ms, [&timed_out]() { timed_out = true; });
+      run_watched(s, dog);
+    }
+
+    expect(timed_out.load(), equal_to(true));
+    expect(logger.events, array(
+      "started_run", "started_suite",
+      "started_test", "passed_test",
+      "started_test", "failed_test",
+      "ended_suite", "ended_run",
+      // The test finished after all; we only see this since the handler
+      // above doesn't exit.
+      "passed_test", "started_test", "passed_test", "ended_suite", "ended_run"
+    ));
+    expect(logger.messages, array("Timed out after 10 ms"));
+  });
+
+  _.test("timeout attribute", [](failure_logger &logger) {
+    std::atomic<bool> timed_out = false;
+    auto s = make_suites<>("inner", [&timed_out](auto &_) {
+      subsuite<>(_, "subsuite", {timeout(20ms)}, [&timed_out](auto &_) {
+        _.test("test", [&timed_out]() { wait_for(timed_out); });
+      });
+    });
+
+    {
+      watchdog dog(logger, std::nullopt, [&timed_out]() { timed_out = true; });
+      run_watched(s, dog);
+    }
+
+    expect(timed_out.load(), equal_to(true));
+    expect(logger.events, array(
+      "started_run", "started_suite", "started_suite",
+      "started_test", "failed_test",
+      "ended_suite", "ended_suite", "ended_run",
+      "passed_test", "ended_suite", "ended_suite", "ended_run"
+    ));
+    expect(logger.messages, array("Timed out after 20 ms"));
+  });
+
+  _.test("keeps watching after the handler returns", [](
+    failure_logger &logger
+  ) {
+    std::atomic<int> timeouts = 0;
+    std::atomic<bool> first = false, second = false;
+    auto s = make_suites<>("inner", [&](auto &_) {
+      _.test("test 1", [&first]() { wait_for(first); });
+      _.test("test 2", [&second]() { wait_for(second); });
+    });
+
+    {
+      watchdog dog(logger, 10ms, [&]() {
+        (++timeouts == 1 ? first : second) = true;
+      });
+      run_watched(s, dog);
+    }
+
+    expect(timeouts.load(), equal_to(2));
+    expect(logger.messages, array(
+      "Timed out after 10 ms", "Timed out after 10 ms"
+    ));
+  });
+
+  _.test("handler isn't interleaved with other events", [](
+    failure_logger &logger
+  ) {
+    // The handler logs the summary while the timed-out test finishes; the
+    // test's own events have to wait until the handler is done.
+    std::atomic<bool> in_handler = false;
+    auto s = make_suites<>("inner", [&in_handler](auto &_) {
+      _.test("test", [&in_handler]() { wait_for(in_handler); });
+    });
+
+    {
+      watchdog dog(logger, 10ms, [&]() {
+        logger.events.push_back("started_summary");
+        in_handler = true;
+        std::this_thread::sleep_for(50ms);
+        logger.events.push_back("ended_summary");
+      });
+      run_watched(s, dog);
+    }
+
+    expect(logger.events, array(
+      "started_run", "started_suite", "started_test", "failed_test",
+      "ended_suite", "ended_run", "started_summary", "ended_summary",
+      "passed_test", "ended_suite", "ended_run"
+    ));
+  });
+});
@@ -0,0 +1,320 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <thread>
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mettle/driver/run_tests.hpp>
+#include <mettle/driver/subprocess_test_runner.hpp>
+#include <mettle/driver/posix/scoped_pipe.hpp>
+using namespace mettle::posix;
+
+#include "../test_event_logger.hpp"
+
+using namespace std::literals::chrono_literals;
+
+struct noisy_fixture {
+  noisy_fixture(int fd) {
+    if(write(fd, "x", 1) != 1)
+      throw std::system_error(errno, std::system_category());
+  }
+
+  int data = 0;
+};
+
+struct slow_fixture {
+  slow_fixture() {
+    std::this_thread::sleep_for(2s);
+  }
+};
+
+auto message(const std::string &expected) {
+  return dereferenced(filter(
+    [](auto &&i) { return i.message; }, equal_to(expected)
+  ));
+}
+
+suite<log::test_output>
+test_forkserver("posix::forkserver_test_runner", [](auto &_) {
+
+  subsuite<>(_, "run one test", [](auto &_) {
+
+    _.test("passing test", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {});
+      })};
+
+      forkserver_test_runner runner(s);
+      expect(runner(s[0].tests()[0], output), equal_to(std::nullopt));
+    });
+
+    _.test("CPU time and resource usage", [](log::test_output &) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          auto start = std::clock();
+          while(std::clock() - start < CLOCKS_PER_SEC / 10) {}
+        });
+      })};
+
+      log::test_duration duration;
+      forkserver_test_runner runner(s);
+      runner.start(s[0].tests()[0], [&duration](
+        const test_result &, const log::test_output &, log::test_duration d
+      ) {
+        duration = d;
+      });
+      runner.wait();
+
+      expect(duration.cpu(), greater_equal(100ms));
+      expect(duration.wall, greater_equal(100ms));
+      expect(duration.usage.max_rss, greater(0u));
+    });
+
+    _.test("failing test", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          expect(true, equal_to(false));
+        });
+      })};
+
+      forkserver_test_runner runner(s);
+      expect(runner(s[0].tests()[0], output), is_not(std::nullopt));
+    });
+
+    _.test("aborting test", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          abort();
+        });
+      })};
+
+      forkserver_test_runner runner(s);
+      expect(runner(s[0].tests()[0], output), message(strsignal(SIGABRT)));
+    });
+
+    _.test("timed out test", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::this_thread::sleep_for(2s);
+        });
+      })};
+
+      forkserver_test_runner runner(s, 1, 500ms);
+      auto then = std::chrono::steady_clock::now();
+      auto failed = runner(s[0].tests()[0], output);
+      auto now = std::chrono::steady_clock::now();
+
+      expect(failed, message("Timed out after 500 ms"));
+      expect(now - then, less(1s));
+    });
+
+    _.test("test with timeout attribute", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test 1", {timeout(100ms)}, []() {
+          std::this_thread::sleep_for(2s);
+        });
+        _.test("test 2", {timeout(2s)}, []() {
+          std::this_thread::sleep_for(750ms);
+        });
+      })};
+
+      forkserver_test_runner runner(s, 1, 500ms);
+      expect(runner(s[0].tests()[0], output),
+             message("Timed out after 100 ms"));
+      expect(runner(s[0].tests()[1], output), equal_to(std::nullopt));
+    });
+
+    _.test("test exceeding CPU time limit", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          for(std::atomic<int> i = 0; ; i++) {}
+        });
+      })};
+
+      forkserver_test_runner runner(s, 1, 5s, {}, {.cpu_time = 1s});
+      expect(runner(s[0].tests()[0], output),
+             message("Exceeded CPU time limit of 1 s"));
+    });
+
+    _.test("test exceeding memory limit", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", {memory_limit("512M")}, []() {
+          std::vector<char> big(1024 * 1024 * 1024);
+        });
+      })};
+
+      forkserver_test_runner runner(s, 1, 5s);
+      expect(runner(s[0].tests()[0], output), dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        regex_search("^Exceeded memory limit of 512\\.0 MiB\n")
+      )));
+    });
+
+    _.test("test with stdout/stderr", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::cout << "stdout";
+          std::cerr << "stderr";
+        });
+      })};
+
+      forkserver_test_runner runner(s);
+      runner(s[0].tests()[0], output);
+      expect(output.stdout_log, equal_to("stdout"));
+      expect(output.stderr_log, equal_to("stderr"));
+    });
+
+  });
+
+  subsuite<>(_, "workers", [](auto &_) {
+
+    _.test("worker is reused", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::cout << getppid();
+        });
+      })};
+
+      forkserver_test_runner runner(s);
+      log::test_output second;
+      runner(s[0].tests()[0], output);
+      runner(s[0].tests()[0], second);
+
+      expect(output.stdout_log, is_not(""));
+      expect(second.stdout_log, equal_to(output.stdout_log));
+    });
+
+    _.test("dead worker is replaced", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {
+          kill(getppid(), SIGKILL);
+        });
+        _.test("test 2", []() {});
+      })};
+
+      forkserver_test_runner runner(s);
+      expect(runner(s[0].tests()[0], output), message(
+        std::string("Test worker killed: ") + strsignal(SIGKILL)
+      ));
+
+      expect(runner(s[0].tests()[1], output), equal_to(std::nullopt));
+    });
+
+    _.test("unknown test", [](log::test_output &output) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {});
+      })};
+      forkserver_test_runner runner(s);
+      runner(s[0].tests()[0], output);
+
+      // This test isn't in the suites the runner was given, so the worker
+      // can't find it.
+      suites_list s2 = {make_suite<>("inner", [](auto &_){
+        _.test("test", []() {});
+      })};
+      expect(runner(s2[0].tests()[0], output),
+             message("Unable to find test"));
+    });
+
+  });
+
+  subsuite<>(_, "fork_after_setup", [](auto &_) {
+
+    _.test("fixture is built once per worker", [](log::test_output &output) {
+      scoped_pipe made;
+      made.open();
+
+      suites_list s = {make_suite<noisy_fixture>(
+        "inner", {fork_after_setup}, bind_factory(made.write_fd),
+        [](auto &_){
+          _.test("test 1", [](noisy_fixture &f) {
+            expect(f.data, equal_to(0));
+            f.data = 1;
+          });
+          _.test("test 2", [](noisy_fixture &f) {
+            expect(f.data, equal_to(0));
+          });
+        }
+      )};
+
+      {
+        forkserver_test_runner runner(s);
+        expect(runner(s[0].tests()[0], output), equal_to(std::nullopt));
+        expect(runner(s[0].tests()[1], output), equal_to(std::nullopt));
+        expect(runner(s[0].tests()[0], output), equal_to(std::nullopt));
+      }
+
+      made.close_write();
+      std::string buf(16, '\0');
+      expect(read(made.read_fd, buf.data(), buf.size()), equal_to(1));
+    });
+
+    _.test("slow fixture times out", [](log::test_output &output) {
+      suites_list s = {make_suite<slow_fixture>(
+        "inner", {fork_after_setup}, [](auto &_){
+          _.test("test", [](slow_fixture &) {});
+        }
+      )};
+
+      forkserver_test_runner runner(s, 1, 200ms);
+      auto then = std::chrono::steady_clock::now();
+      auto failed = runner(s[0].tests()[0], output);
+      auto now = std::chrono::steady_clock::now();
+
+      expect(failed, message("Timed out while preparing shared fixtures"));
+      expect(now - then, less(1s));
+    });
+
+  });
+
+  subsuite<test_event_logger>(_, "run_tests()", [](auto &_) {
+
+    _.test("tests run in parallel", [](log::test_output &,
+                                       test_event_logger &logger) {
+      suites_list s = {make_suite<>("inner", [](auto &_){
+        for(int i = 0; i != 4; i++) {
+          _.test("test " + std::to_string(i), []() {
+            std::this_thread::sleep_for(250ms);
+          });
+        }
+        _.test("test 4", []() {
+          abort();
+        });
+      })};
+
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "failed_test",
+        "ended_suite",
+        "ended_run"
+      };
+
+      forkserver_test_runner runner(s, 4);
+      auto then = std::chrono::steady_clock::now();
+      run_tests(s, logger, runner);
+      auto now = std::chrono::steady_clock::now();
+
+      expect(logger.events, equal_to(expected));
+      expect(now - then, less(750ms));
+    });
+
+  });
+
+});
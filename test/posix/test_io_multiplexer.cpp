@@ -0,0 +1,152 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "errno.hpp"
+#include <mettle/driver/posix/io_multiplexer.hpp>
+#include <mettle/driver/posix/pidfd.hpp>
+#include <mettle/driver/posix/scoped_pipe.hpp>
+using namespace mettle::posix;
+
+struct io_multiplexer_fixture {
+  scoped_pipe pipe[2];
+  std::string results[2];
+  io_multiplexer io;
+};
+
+suite<io_multiplexer_fixture>
+test_io_multiplexer("posix::io_multiplexer", [](auto &_) {
+  _.setup([](io_multiplexer_fixture &f) {
+    for(int i = 0; i != 2; i++) {
+      expect("open pipe", f.pipe[i].open(), equal_to(0));
+      expect("add fd", f.io.add(f.pipe[i].read_fd, &f.results[i]),
+             equal_to(0));
+    }
+  });
+
+  _.test("add() twice", [](io_multiplexer_fixture &f) {
+    expect(f.io.add(f.pipe[0].read_fd, &f.results[1]),
+           all( equal_to(-1), equal_errno(EEXIST) ));
+  });
+
+  _.test("wait() for data", [](io_multiplexer_fixture &f) {
+    write(f.pipe[0].write_fd, "pipe 1", 6);
+    write(f.pipe[1].write_fd, "pipe 2", 6);
+
+    expect(f.io.wait(nullptr, nullptr), equal_to(2));
+    expect(f.results[0], equal_to("pipe 1"));
+    expect(f.results[1], equal_to("pipe 2"));
+  });
+
+  _.test("wait() until timeout", [](io_multiplexer_fixture &f) {
+    timespec timeout = {0, 10*1000*1000 /* 10 ms */};
+    expect(f.io.wait(&timeout, nullptr), equal_to(0));
+    expect(f.results[0], equal_to(""));
+    expect(f.results[1], equal_to(""));
+  });
+
+  _.test("wait() removes closed fds", [](io_multiplexer_fixture &f) {
+    write(f.pipe[0].write_fd, "pipe 1", 6);
+    f.pipe[0].close_write();
+
+    expect(f.io.wait(nullptr, nullptr), equal_to(1));
+    expect(f.io.wait(nullptr, nullptr), equal_to(1));
+    expect(f.io.contains(f.pipe[0].read_fd), equal_to(false));
+    expect(f.io.contains(f.pipe[1].read_fd), equal_to(true));
+    expect(f.results[0], equal_to("pipe 1"));
+  });
+
+  _.test("remove()", [](io_multiplexer_fixture &f) {
+    write(f.pipe[0].write_fd, "pipe 1", 6);
+    expect(f.io.remove(f.pipe[0].read_fd), equal_to(0));
+    expect(f.io.contains(f.pipe[0].read_fd), equal_to(false));
+
+    timespec timeout = {0, 0};
+    expect(f.io.wait(&timeout, nullptr), equal_to(0));
+    expect(f.results[0], equal_to(""));
+  });
+
+  _.test("drain()", [](io_multiplexer_fixture &f) {
+    std::string data(256 * 1024, 'x');
+    write(f.pipe[1].write_fd, "pipe 2", 6);
+    expect(fcntl(f.pipe[0].write_fd, F_SETFL, O_NONBLOCK), equal_to(0));
+    ssize_t size = write(f.pipe[0].write_fd, data.data(), data.size());
+    expect(size, greater(0));
+    f.pipe[0].close_write();
+
+    expect(f.io.drain(f.pipe[0].read_fd), equal_to(0));
+    expect(f.results[0], equal_to(data.substr(0, size)));
+    expect(f.io.contains(f.pipe[0].read_fd), equal_to(false));
+    expect(f.results[1], equal_to(""));
+  });
+
+  _.test("watch()", [](io_multiplexer_fixture &f) {
+    scoped_pipe pipe;
+    expect("open pipe", pipe.open(), equal_to(0));
+
+    int events = 0;
+    expect(f.io.watch(pipe.read_fd, [&events]() { events++; }), equal_to(0));
+
+    timespec timeout = {0, 0};
+    expect(f.io.wait(&timeout, nullptr), equal_to(0));
+    expect(events, equal_to(0));
+
+    write(pipe.write_fd, "event", 5);
+    expect(f.io.wait(nullptr, nullptr), equal_to(1));
+    expect(events, equal_to(1));
+    expect(f.io.contains(pipe.read_fd), equal_to(false));
+  });
+
+  _.test("watch() a pidfd", [](io_multiplexer_fixture &f) {
+    if(!has_pidfd())
+      return;
+
+    pid_t pid = fork();
+    expect("fork", pid, greater_equal(0));
+    if(pid == 0)
+      _exit(0);
+
+    int pidfd = open_pidfd(pid);
+    expect("open pidfd", pidfd, greater_equal(0));
+
+    bool exited = false;
+    expect(f.io.watch(pidfd, [&exited]() { exited = true; }), equal_to(0));
+    while(!exited)
+      expect(f.io.wait(nullptr, nullptr), equal_to(1));
+
+    int status;
+    expect(waitpid(pid, &status, WNOHANG), equal_to(pid));
+    expect(WIFEXITED(status) && WEXITSTATUS(status) == 0, equal_to(true));
+    close(pidfd);
+  });
+
+#ifdef __linux__
+  _.test("fd above FD_SETSIZE", [](io_multiplexer_fixture &f) {
+    rlimit limit;
+    expect("get fd limit", getrlimit(RLIMIT_NOFILE, &limit), equal_to(0));
+    if(limit.rlim_cur <= FD_SETSIZE + 1) {
+      limit.rlim_cur = FD_SETSIZE + 2;
+      expect("raise fd limit", setrlimit(RLIMIT_NOFILE, &limit), equal_to(0));
+    }
+
+    int fd = dup2(f.pipe[1].read_fd, FD_SETSIZE + 1);
+    expect("dup fd", fd, equal_to(FD_SETSIZE + 1));
+    expect(f.io.remove(f.pipe[1].read_fd), equal_to(0));
+    expect(f.io.add(fd, &f.results[1]), equal_to(0));
+
+    write(f.pipe[1].write_fd, "pipe 2", 6);
+    expect(f.io.wait(nullptr, nullptr), equal_to(1));
+    expect(f.results[1], equal_to("pipe 2"));
+
+    f.io.remove(fd);
+    close(fd);
+  });
+#endif
+});
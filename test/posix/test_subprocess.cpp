@@ -14,6 +14,7 @@ using namespace mettle::posix;
 #include "errno.hpp"
 
 struct read_into_fixture {
+  io_multiplexer io;
   scoped_pipe pipe[2];
   std::string results[2];
   std::vector<readfd> readfds;
@@ -59,7 +60,7 @@ suite<> test_subprocess("posix subprocess utilities", [](auto &_) {
       });
       t.detach();
 
-      expect(read_into(f.readfds, nullptr, nullptr), equal_to(0));
+      expect(read_into(f.io, f.readfds, nullptr, nullptr), equal_to(0));
 
       expect(f.results[0], equal_to("pipe 1"));
       expect(f.results[1], equal_to("pipe 2"));
@@ -71,13 +72,21 @@ suite<> test_subprocess("posix subprocess utilities", [](auto &_) {
         std::this_thread::sleep_for(std::chrono::milliseconds(250));
         write(f.pipe[1].write_fd, "pipe 2", 6);
       });
-      t.detach();
 
       timespec timeout = {0, 100*1000*1000 /* 10 ms */};
-      expect(read_into(f.readfds, &timeout, nullptr), equal_to(0));
+      expect(read_into(f.io, f.readfds, &timeout, nullptr), equal_to(0));
 
       expect(f.results[0], equal_to("pipe 1"));
       expect(f.results[1], equal_to(""));
+      expect(f.io.empty(), equal_to(true));
+
+      // The multiplexer can be used again to pick up where we left off.
+      t.join();
+      f.pipe[0].close_write();
+      f.pipe[1].close_write();
+      expect(read_into(f.io, f.readfds, nullptr, nullptr), equal_to(0));
+      expect(f.results[0], equal_to("pipe 1"));
+      expect(f.results[1], equal_to("pipe 2"));
     });
 
     attributes sigtest_attrs;
@@ -104,7 +113,7 @@ suite<> test_subprocess("posix subprocess utilities", [](auto &_) {
 
       sigset_t empty;
       sigemptyset(&empty);
-      expect(read_into(f.readfds, nullptr, &empty),
+      expect(read_into(f.io, f.readfds, nullptr, &empty),
              all( equal_to(-1), equal_errno(EINTR) ));
 
       expect(f.results[0], equal_to("pipe 1"));
@@ -1,12 +1,15 @@
 #include <mettle.hpp>
 using namespace mettle;
 
+#include <atomic>
 #include <chrono>
+#include <ctime>
 #include <iostream>
 #include <thread>
 
 #include <signal.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <mettle/driver/run_tests.hpp>
 #include <mettle/driver/subprocess_test_runner.hpp>
@@ -93,6 +96,37 @@ test_fork("posix::subprocess_test_runner", bind_factory(500ms), [](auto &_) {
       expect(now - then, less(1s));
     });
 
+    _.test("test with timeout attribute", [](subprocess_test_runner &runner,
+                                             log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", {timeout(100ms)}, []() {
+          std::this_thread::sleep_for(2s);
+        });
+      });
+
+      auto then = std::chrono::steady_clock::now();
+      auto failed = runner(s.tests()[0], output);
+      auto now = std::chrono::steady_clock::now();
+
+      expect(failed, dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        equal_to("Timed out after 100 ms")
+      )));
+      expect(now - then, less(500ms));
+    });
+
+    _.test("test with longer timeout attribute",
+           [](subprocess_test_runner &runner, log::test_output &output) {
+      auto s = make_suite<>("inner", {timeout(2s)}, [](auto &_){
+        _.test("test", []() {
+          std::this_thread::sleep_for(750ms);
+        });
+      });
+
+      auto failed = runner(s.tests()[0], output);
+      expect(failed, equal_to(std::nullopt));
+    });
+
     _.test("test with timed out child", [](subprocess_test_runner &runner,
                                            log::test_output &output) {
       scoped_pipe block;
@@ -194,6 +228,110 @@ test_fork("posix::subprocess_test_runner", bind_factory(500ms), [](auto &_) {
       expect(output.stderr_log, equal_to("stderr"));
     });
 
+    _.test("test with limited output", [](subprocess_test_runner &,
+                                          log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          for(int i = 0; i != 100000; i++)
+            std::cout << "0123456789";
+          std::cout << "end";
+        });
+      });
+
+      // Keep the first 50 bytes and the last 50 bytes.
+      std::string digits = "0123456789", head, tail = digits.substr(3);
+      for(int i = 0; i != 5; i++)
+        head += digits;
+      for(int i = 0; i != 4; i++)
+        tail += digits;
+      tail += "end";
+
+      subprocess_test_runner runner(500ms, 100);
+      auto failed = runner(s.tests()[0], output);
+      expect(output.stdout_dropped, equal_to(999903u));
+      expect(output.stdout_log, equal_to(
+        head + "\n[... 999903 bytes dropped ...]\n" + tail
+      ));
+    });
+
+    _.test("test exceeding memory limit", [](subprocess_test_runner &,
+                                             log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::vector<char> big(1024 * 1024 * 1024);
+        });
+      });
+
+      subprocess_test_runner runner(5s, {}, {.memory = 512 * 1024 * 1024});
+      auto failed = runner(s.tests()[0], output);
+      expect(failed, dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        regex_search("^Exceeded memory limit of 512\\.0 MiB\n")
+      )));
+    });
+
+    _.test("test exceeding CPU time limit", [](subprocess_test_runner &,
+                                               log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          for(std::atomic<int> i = 0; ; i++) {}
+        });
+      });
+
+      subprocess_test_runner runner(5s, {}, {.cpu_time = 1s});
+      auto failed = runner(s.tests()[0], output);
+      expect(failed, dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        equal_to("Exceeded CPU time limit of 1 s")
+      )));
+    });
+
+    _.test("test exceeding open files limit", [](subprocess_test_runner &,
+                                                 log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          while(dup(STDOUT_FILENO) >= 0) {}
+          expect(errno, equal_to(0));
+        });
+      });
+
+      subprocess_test_runner runner(5s, {}, {.open_files = 32});
+      auto failed = runner(s.tests()[0], output);
+      expect(failed, dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        regex_search("^Exceeded open files limit of 32\n")
+      )));
+    });
+
+    _.test("test with limit attributes", [](subprocess_test_runner &,
+                                            log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", {cpu_limit("1")}, []() {
+          for(std::atomic<int> i = 0; ; i++) {}
+        });
+      });
+
+      subprocess_test_runner runner(5s);
+      auto failed = runner(s.tests()[0], output);
+      expect(failed, dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        equal_to("Exceeded CPU time limit of 1 s")
+      )));
+    });
+
+    _.test("test with invalid limit attributes",
+           [](subprocess_test_runner &runner, log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", {memory_limit("lots")}, []() {});
+      });
+
+      auto failed = runner(s.tests()[0], output);
+      expect(failed, dereferenced(filter(
+        [](auto &&i) { return i.message; },
+        equal_to("invalid value for memory_limit: \"lots\"")
+      )));
+    });
+
   });
 
   subsuite<test_event_logger>(_, "run_tests()", [](auto &_) {
@@ -250,6 +388,125 @@ test_fork("posix::subprocess_test_runner", bind_factory(500ms), [](auto &_) {
 
 });
 
+suite<test_event_logger>
+test_parallel("posix::parallel_subprocess_runner", [](auto &_) {
+
+  _.test("tests run in parallel", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      for(int i = 0; i != 4; i++) {
+        _.test("test " + std::to_string(i), []() {
+          std::this_thread::sleep_for(250ms);
+        });
+      }
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    parallel_subprocess_runner runner(4);
+    auto then = std::chrono::steady_clock::now();
+    run_tests(s, logger, runner);
+    auto now = std::chrono::steady_clock::now();
+
+    expect(logger.events, equal_to(expected));
+    expect(now - then, less(750ms));
+  });
+
+  _.test("CPU time and resource usage", [](test_event_logger &) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test", []() {
+        auto start = std::clock();
+        while(std::clock() - start < CLOCKS_PER_SEC / 10) {}
+      });
+    });
+
+    log::test_duration duration;
+    parallel_subprocess_runner runner(1);
+    runner.start(s[0].tests()[0], [&duration](
+      const test_result &, const log::test_output &, log::test_duration d
+    ) {
+      duration = d;
+    });
+    runner.wait();
+
+    expect(duration.cpu(), greater_equal(100ms));
+    expect(duration.wall, greater_equal(100ms));
+    expect(duration.usage.max_rss, greater(0u));
+  });
+
+  _.test("results are logged in order", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {
+        std::this_thread::sleep_for(250ms);
+      });
+      _.test("test 2", []() {
+        abort();
+      });
+      _.test("test 3", []() {
+        expect(true, equal_to(false));
+      });
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "failed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    parallel_subprocess_runner runner(2);
+    run_tests(s, logger, runner);
+    expect(logger.events, equal_to(expected));
+  });
+
+  _.test("timed out test", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {
+        std::this_thread::sleep_for(2s);
+      });
+      _.test("test 2", []() {});
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "passed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    parallel_subprocess_runner runner(2, 500ms);
+    auto then = std::chrono::steady_clock::now();
+    run_tests(s, logger, runner);
+    auto now = std::chrono::steady_clock::now();
+
+    expect(logger.events, equal_to(expected));
+    expect(now - then, less(1s));
+  });
+
+});
+
 suite<> test_make_fd_private("make_fd_private", [](auto &_) {
 
   _.test("make_fd_private()", []() {
@@ -65,6 +65,33 @@ suite<> test_attr("attributes", [](auto &_) {
     });
   });
 
+  subsuite<>(_, "duration_attr", [](auto &_) {
+    _.test("with duration", []() {
+      using namespace std::literals::chrono_literals;
+      duration_attr attr("attribute");
+      attr_instance a = attr(2s);
+
+      expect(&a.attribute, equal_to(&attr));
+      expect(a.value, array("2000"));
+    });
+
+    _.test("with milliseconds", []() {
+      duration_attr attr("attribute");
+      attr_instance a = attr(250);
+
+      expect(&a.attribute, equal_to(&attr));
+      expect(a.value, array("250"));
+    });
+
+    _.test("unite()", []() {
+      duration_attr attr("attribute");
+      attr_instance a = unite(attr(100), attr(200));
+
+      expect(&a.attribute, equal_to(&attr));
+      expect(a.value, array("100"));
+    });
+  });
+
   subsuite<>(_, "list_attr", [](auto &_) {
     _.test("single value", []() {
       list_attr attr("attribute");
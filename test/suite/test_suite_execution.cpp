@@ -212,3 +212,61 @@ suite<basic_fixture> test_fixtures("suite fixtures", [](auto &_) {
   });
 
 });
+
+struct counting_factory {
+  template<typename T>
+  T make() {
+    (*made)++;
+    return { 0 };
+  }
+
+  std::shared_ptr<std::size_t> made = std::make_shared<std::size_t>(0);
+};
+
+suite<> test_shared_fixtures("shared fixtures", [](auto &_) {
+
+  _.test("no shared fixture by default", []() {
+    auto s = make_suite<basic_fixture>("inner", [](auto &_){
+      _.test("inner test", [](basic_fixture &) {});
+    });
+    expect(s.shared_fixture(), equal_to(nullptr));
+  });
+
+  _.test("unprepared fixture is built for each test", []() {
+    counting_factory factory;
+    auto s = make_suite<basic_fixture>(
+      "inner", {fork_after_setup}, factory, [](auto &_){
+        _.test("inner test", [](basic_fixture &) {});
+      }
+    );
+    expect(s.shared_fixture(), is_not(nullptr));
+
+    s.tests()[0].function();
+    s.tests()[0].function();
+    expect("fixtures made", *factory.made, equal_to(2));
+  });
+
+  _.test("prepared fixture is shared by each test", []() {
+    counting_factory factory;
+    auto s = make_suite<basic_fixture>(
+      "inner", {fork_after_setup}, factory, [](auto &_){
+        _.setup([](basic_fixture &f) {
+          f.data++;
+        });
+        _.test("inner test", [](basic_fixture &) {});
+      }
+    );
+
+    s.shared_fixture()->prepare();
+    expect("fixtures made", *factory.made, equal_to(1));
+    s.tests()[0].function();
+    s.tests()[0].function();
+    expect("fixtures made", *factory.made, equal_to(1));
+
+    s.shared_fixture()->reset();
+    expect(s.shared_fixture()->prepared(), equal_to(false));
+    s.tests()[0].function();
+    expect("fixtures made", *factory.made, equal_to(2));
+  });
+
+});
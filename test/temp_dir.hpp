@@ -0,0 +1,45 @@
+#ifndef INC_METTLE_TEST_TEMP_DIR_HPP
+#define INC_METTLE_TEST_TEMP_DIR_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+// A fixture that creates an empty temporary directory and removes it (and
+// everything in it) afterwards.
+struct temp_dir {
+  temp_dir() {
+    std::random_device rd;
+    path = std::filesystem::temp_directory_path() /
+           ("mettle-test-" + std::to_string(rd()) + std::to_string(rd()));
+    std::filesystem::create_directories(path);
+  }
+  temp_dir(const temp_dir &) = delete;
+  temp_dir & operator =(const temp_dir &) = delete;
+
+  ~temp_dir() {
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+  }
+
+  // Write `contents` to the file `name` in this directory and return its path.
+  std::string write(const std::string &name, const std::string &contents) {
+    auto file = path / name;
+    std::ofstream(file, std::ios::binary) << contents;
+    return file.string();
+  }
+
+  std::filesystem::path path;
+};
+
+// Count the files in `dir` with the given extension.
+inline std::size_t count_files(const std::filesystem::path &dir,
+                               const std::string &extension) {
+  std::size_t n = 0;
+  for(const auto &i : std::filesystem::directory_iterator(dir))
+    n += i.path().extension() == extension;
+  return n;
+}
+
+#endif